@@ -4,7 +4,10 @@
 #define WIN32_LEAN_AND_MEAN // Optimización estándar para una compilación más
                             // rápida en Windows
 
+#include <atomic>
+#include <future>
 #include <iostream>
+#include <optional>
 #include <sstream> // Para construir strings JSON
 #include <string>
 #include <vector>
@@ -13,17 +16,20 @@
 #include "src/httplib.h"
 
 #include "src/DataManager.h"
+#include "src/FoldIn.h"
 #include "src/MatrixFactorization.h"
 #include "src/MetricsCalculator.h"
+#include "src/ModelStore.h"
 #include "src/SRPRModel.h"
+#include "src/ServerMetrics.h"
 #include "src/lsh.h"
 
 // --- Declaraciones de funciones que usaremos ---
 // (Estas funciones ya existen en tu main, las movemos aquí para claridad)
-double calculate_cosine_similarity(const Vec &vec1, const Vec &vec2);
+double calculate_cosine_similarity(ConstVecView vec1, ConstVecView vec2);
 template <typename T>
 std::vector<std::pair<int, double>>
-get_brute_force_vec(const Vec &user_vec, const T &model, const DataManager &dm,
+get_brute_force_vec(ConstVecView user_vec, const T &model, const DataManager &dm,
                     int top_k);
 
 // --- NUEVAS FUNCIONES HELPER PARA CONVERTIR DATOS A JSON ---
@@ -98,84 +104,192 @@ std::string single_metric_to_json(const QueryResultMetrics &metrics) {
   ss << "}";
   return ss.str();
 }
+// Progreso del arranque por etapas, consultado por /api/ready.
+struct StartupProgress {
+  std::atomic<bool> data_ready{false};
+  std::atomic<bool> bpr_ready{false};
+  std::atomic<bool> srpr_ready{false};
+  std::atomic<bool> metrics_ready{false};
+  std::atomic<bool> failed{false};
+  std::atomic<int> metrics_done{0};
+  std::atomic<int> metrics_total{0};
+};
+
+std::string startup_to_json(const StartupProgress &startup) {
+  auto flag = [](const std::atomic<bool> &value) {
+    return value.load() ? "true" : "false";
+  };
+  std::stringstream ss;
+  ss << "{";
+  ss << "\"ready\": " << flag(startup.srpr_ready) << ", ";
+  ss << "\"failed\": " << flag(startup.failed) << ", ";
+  ss << "\"data_manager\": " << flag(startup.data_ready) << ", ";
+  ss << "\"srpr_index\": " << flag(startup.srpr_ready) << ", ";
+  ss << "\"bpr_index\": " << flag(startup.bpr_ready) << ", ";
+  ss << "\"metrics\": {\"ready\": " << flag(startup.metrics_ready)
+     << ", \"done\": " << startup.metrics_done.load()
+     << ", \"total\": " << startup.metrics_total.load() << "}";
+  ss << "}";
+  return ss.str();
+}
+
 int main(int argc, char *argv[]) {
-  // === 0. Configuración y Carga/Entrenamiento de Modelos ===
-  // Esta parte es idéntica a la anterior: carga datos, entrena o carga
-  // vectores.
+  // === 0. Configuración ===
   const int D = 32;
   const int TOP_K = 10;
   const int LSH_TABLES = 12;
   const int LSH_HASH_SIZE = 8;
-  const int MAX_RATINGS = 22000000;
   const int MAX_TRIPLETS_PER_USER = 300;
   const double MAX_RATING_VALUE = 5.0; // ¡IMPORTANTE! Define el valor de calificación máxima
   int num_test_users = 1000;
-  DataManager data_manager("../data/ratings.csv", MAX_RATINGS,
-                           MAX_TRIPLETS_PER_USER);
-  data_manager.init();
-  if (data_manager.get_training_triplets().empty())
-    return 1;
-
-  MatrixFactorization bpr_model(data_manager.get_num_users(),
-                                data_manager.get_num_items(), D);
-  if (!bpr_model.load_vectors("../data/bpr_vectors.txt")) {
-    bpr_model.train(data_manager.get_training_triplets(), 20, 0.02, 0.01);
-    bpr_model.save_vectors("../data/bpr_vectors.txt");
-  }
-
-  SRPRModel srpr_model(data_manager.get_num_users(),
-                       data_manager.get_num_items(), D);
-  if (!srpr_model.load_vectors("../data/srpr_vectors.txt")) {
-    srpr_model.train(data_manager.get_training_triplets(), LSH_HASH_SIZE, 0.05,
-                     0.001, 20);
-    srpr_model.save_vectors("../data/srpr_vectors.txt");
+  // --ratings=<archivo.csv> sirve otro conjunto (p. ej. uno de generateSynthetic).
+  const DatasetOptions DATASET =
+      parse_dataset_options(argc, argv, {"../data/ratings.csv", 22000000});
+  const std::string DATASET_PREFIX = dataset_prefix(DATASET.ratings_path);
+  const std::string BPR_VECTORS_FILE =
+      "../data/" + DATASET_PREFIX + "bpr_vectors.txt";
+  const std::string SRPR_VECTORS_FILE =
+      "../data/" + DATASET_PREFIX + "srpr_vectors.txt";
+  // Puntos de control si hay que entrenar: --checkpoint_every,
+  // --checkpoint_triplets, --resume (ver Checkpoint.h).
+  const CheckpointOptions BPR_CHECKPOINT =
+      parse_checkpoint_options(argc, argv, DATASET_PREFIX, "bpr");
+  const CheckpointOptions SRPR_CHECKPOINT =
+      parse_checkpoint_options(argc, argv, DATASET_PREFIX, "srpr");
+  // --holdout: las épocas de entrenamiento pasan a ser un máximo (ver Holdout.h).
+  const HoldoutOptions HOLDOUT = parse_holdout_options(argc, argv);
+  bool watch_vector_files = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--watch")
+      watch_vector_files = true;
   }
 
-  // === 1. Pre-cálculo de Métricas y Construcción de Índices ===
-  std::cout << "\n--- Pre-calculando metricas y construyendo indices LSH ---"
-            << std::endl;
+  // Las consultas usan el DataManager de la versión publicada (las recargas
+  // lo releen); este es el del arranque.
+  auto startup_data = std::make_shared<DataManager>(
+      DATASET.ratings_path, DATASET.max_ratings, MAX_TRIPLETS_PER_USER);
+  ModelStore model_store(DATASET, MAX_TRIPLETS_PER_USER, D, LSH_TABLES,
+                         LSH_HASH_SIZE, BPR_VECTORS_FILE, SRPR_VECTORS_FILE,
+                         DATASET_PREFIX);
   MetricsCalculator bpr_metrics_calculator, srpr_metrics_calculator;
-
-  SignedRandomProjectionLSH lsh_bpr(LSH_TABLES, LSH_HASH_SIZE, D);
-  LSHIndex lsh_index_bpr(lsh_bpr);
-  for (int i = 0; i < data_manager.get_num_items(); ++i)
-    lsh_index_bpr.add(i, bpr_model.get_item_vector(i));
-
-  SignedRandomProjectionLSH lsh_srpr(LSH_TABLES, LSH_HASH_SIZE, D);
-  LSHIndex lsh_index_srpr(lsh_srpr);
-  for (int i = 0; i < data_manager.get_num_items(); ++i)
-    lsh_index_srpr.add(i, srpr_model.get_item_vector(i));
-
-
-  for (int i = 0; i < std::min(num_test_users, data_manager.get_num_users()); ++i) {
-    int user_idx = rand() % data_manager.get_num_users();
-    
-    // BPR
-    auto bpr_gt = get_brute_force_vec(bpr_model.get_user_vector(user_idx),
-                                      bpr_model, data_manager, TOP_K);
-    auto bpr_lsh = lsh_index_bpr.find_neighbors(
-        bpr_model.get_user_vector(user_idx), TOP_K);
-    bpr_metrics_calculator.add_query_result(user_idx, data_manager, bpr_lsh,
-                                            bpr_gt, 0, 0);
-    // Añadimos métricas para nRecall
-    bpr_metrics_calculator.add_query_result_for_nrecall(
-        user_idx, data_manager, bpr_lsh, MAX_RATING_VALUE, 0);
-
-    // SRPR
-    auto srpr_gt = get_brute_force_vec(srpr_model.get_user_vector(user_idx),
-                                       srpr_model, data_manager, TOP_K);
-    auto srpr_lsh = lsh_index_srpr.find_neighbors(
-        srpr_model.get_user_vector(user_idx), TOP_K);
-    srpr_metrics_calculator.add_query_result(user_idx, data_manager, srpr_lsh,
-                                             srpr_gt, 0, 0);
-    // Añadimos métricas para nRecall
-    srpr_metrics_calculator.add_query_result_for_nrecall(
-        user_idx, data_manager, srpr_lsh, MAX_RATING_VALUE, 0);
-  }
-  std::cout << "--- Pre-calculo completado ---" << std::endl;
+  StartupProgress startup;
+  // Fold-in con los mismos hiperparámetros de pérdida que el entrenamiento.
+  FoldInOptions SRPR_FOLD_IN;
+  SRPR_FOLD_IN.srp_bits = LSH_HASH_SIZE;
+  SRPR_FOLD_IN.max_triplets = MAX_TRIPLETS_PER_USER;
+  FoldInOptions BPR_FOLD_IN = SRPR_FOLD_IN;
+  BPR_FOLD_IN.lambda = 0.01;
+  FoldInCache fold_in_cache;
+
+  // === 1. Arranque por etapas en segundo plano ===
+  // El servidor escucha desde el principio; /api/recommend responde en cuanto
+  // el índice SRPR está publicado y /api/ready informa el progreso.
+  std::thread startup_thread([&] {
+    DataManager &data_manager = *startup_data;
+    data_manager.init();
+    if (data_manager.get_training_triplets().empty()) {
+      startup.failed = true;
+      return;
+    }
+    const uint64_t catalog_fingerprint = data_manager.catalog_fingerprint();
+    model_store.set_data(startup_data);
+    startup.data_ready = true;
+
+    // Con --holdout, si hay que entrenar, ambos modelos lo hacen sin los
+    // ratings apartados y con corte temprano.
+    std::vector<Triplet> holdout_triplets;
+    HoldoutSet holdout_set;
+    if (HOLDOUT.enabled)
+      holdout_set = HoldoutSet::split(data_manager, HOLDOUT, holdout_triplets);
+    const std::vector<Triplet> &train_triplets =
+        HOLDOUT.enabled ? holdout_triplets
+                        : data_manager.get_training_triplets();
+    auto make_holdout = [&](const std::string &name) {
+      return HOLDOUT.enabled ? std::make_unique<HoldoutEvaluator>(
+                                   holdout_set, HOLDOUT, name)
+                             : nullptr;
+    };
+
+    // Ambos modelos se cargan (o entrenan) e indexan en paralelo; cada uno se
+    // publica apenas está listo.
+    auto srpr_task = std::async(std::launch::async, [&] {
+      auto srpr = model_store.make_srpr();
+      if (!srpr->model.load_vectors(SRPR_VECTORS_FILE, catalog_fingerprint)) {
+        auto holdout = make_holdout("SRPR");
+        srpr->model.train(train_triplets, LSH_HASH_SIZE, 0.05, 0.001, 20,
+                          &SRPR_CHECKPOINT, holdout.get());
+        srpr->model.save_vectors(SRPR_VECTORS_FILE, catalog_fingerprint);
+      }
+      srpr->build_index();
+      model_store.publish_srpr(srpr);
+      startup.srpr_ready = true;
+      std::cout << "--- Indice SRPR listo, sirviendo /api/recommend ---"
+                << std::endl;
+    });
+    auto bpr_task = std::async(std::launch::async, [&] {
+      auto bpr = model_store.make_bpr();
+      if (!bpr->model.load_vectors(BPR_VECTORS_FILE, catalog_fingerprint)) {
+        auto holdout = make_holdout("BPR");
+        bpr->model.train(train_triplets, 20, 0.02, 0.01, &BPR_CHECKPOINT,
+                         holdout.get());
+        bpr->model.save_vectors(BPR_VECTORS_FILE, catalog_fingerprint);
+      }
+      bpr->build_index();
+      model_store.publish_bpr(bpr);
+      startup.bpr_ready = true;
+      std::cout << "--- Indice BPR listo ---" << std::endl;
+    });
+    srpr_task.get();
+    bpr_task.get();
+
+    // Recarga automática cuando se reemplazan los archivos de vectores.
+    if (watch_vector_files)
+      model_store.watch_files(std::chrono::seconds(10));
+
+    // Las métricas agregadas de /api/metrics se calculan al final, sin
+    // bloquear las recomendaciones.
+    std::cout << "\n--- Pre-calculando metricas en segundo plano ---"
+              << std::endl;
+    auto models = model_store.current();
+    const DataManager &serving_data = *models->data;
+    auto &bpr_model = models->bpr->model;
+    auto &srpr_model = models->srpr->model;
+    int total_users = std::min(num_test_users, serving_data.get_num_users());
+    startup.metrics_total = total_users;
+    for (int i = 0; i < total_users; ++i) {
+      int user_idx = rand() % serving_data.get_num_users();
+
+      // BPR
+      auto bpr_gt = get_brute_force_vec(bpr_model.get_user_vector(user_idx),
+                                        bpr_model, serving_data, TOP_K);
+      auto bpr_lsh = models->bpr->index.find_neighbors(
+          bpr_model.get_user_vector(user_idx), TOP_K);
+      bpr_metrics_calculator.add_query_result(user_idx, serving_data, bpr_lsh,
+                                              bpr_gt, 0, 0);
+      // Añadimos métricas para nRecall
+      bpr_metrics_calculator.add_query_result_for_nrecall(
+          user_idx, serving_data, bpr_lsh, MAX_RATING_VALUE, 0);
+
+      // SRPR
+      auto srpr_gt = get_brute_force_vec(srpr_model.get_user_vector(user_idx),
+                                         srpr_model, serving_data, TOP_K);
+      auto srpr_lsh = models->srpr->index.find_neighbors(
+          srpr_model.get_user_vector(user_idx), TOP_K);
+      srpr_metrics_calculator.add_query_result(user_idx, serving_data,
+                                               srpr_lsh, srpr_gt, 0, 0);
+      // Añadimos métricas para nRecall
+      srpr_metrics_calculator.add_query_result_for_nrecall(
+          user_idx, serving_data, srpr_lsh, MAX_RATING_VALUE, 0);
+      startup.metrics_done = i + 1;
+    }
+    startup.metrics_ready = true;
+    std::cout << "--- Pre-calculo completado ---" << std::endl;
+  });
 
   // === 2. Configuración del Servidor Web ===
   httplib::Server svr;
+  enum { BPR_MODEL = 0, SRPR_MODEL = 1 };
+  ServerMetrics server_metrics({"bpr", "srpr"});
 
   // --- Endpoint Raíz: Sirve la página web principal ---
   svr.Get("/", [](const httplib::Request &, httplib::Response &res) {
@@ -189,9 +303,20 @@ int main(int argc, char *argv[]) {
     }
   });
 
+  // --- Endpoint de disponibilidad: progreso del arranque ---
+  svr.Get("/api/ready", [&](const httplib::Request &, httplib::Response &res) {
+    res.status = startup.srpr_ready ? 200 : 503;
+    res.set_content(startup_to_json(startup), "application/json");
+  });
+
   // --- Endpoint API: Devuelve las métricas pre-calculadas ---
   svr.Get(
       "/api/metrics", [&](const httplib::Request &, httplib::Response &res) {
+        if (!startup.metrics_ready) {
+          res.status = 503;
+          res.set_content(startup_to_json(startup), "application/json");
+          return;
+        }
         std::string bpr_json =
             metrics_to_json(bpr_metrics_calculator, "LSH + BPR (No Robusto)");
         std::string srpr_json =
@@ -201,36 +326,106 @@ int main(int argc, char *argv[]) {
         res.set_content(final_json, "application/json");
       });
 
+  // --- Endpoint de observabilidad: histogramas por etapa (Prometheus) ---
+  svr.Get("/metrics", [&](const httplib::Request &, httplib::Response &res) {
+    std::stringstream ss;
+    server_metrics.write_prometheus(ss);
+    res.set_content(ss.str(), "text/plain; version=0.0.4");
+  });
+
+  // --- Endpoint de administración: recarga vectores e índices sin reiniciar ---
+  svr.Post("/admin/reload",
+           [&](const httplib::Request &, httplib::Response &res) {
+             if (!startup.bpr_ready || !startup.srpr_ready) {
+               res.status = 503;
+               res.set_content(startup_to_json(startup), "application/json");
+               return;
+             }
+             bool started = model_store.reload_async();
+             std::stringstream ss;
+             ss << "{\"started\": " << (started ? "true" : "false") << ", ";
+             ss << "\"serving_version\": " << model_store.current()->version
+                << ", ";
+             ss << "\"last_reload\": \"" << model_store.last_reload_status()
+                << "\"}";
+             res.status = started ? 202 : 409;
+             res.set_content(ss.str(), "application/json");
+           });
+
   // --- Endpoint API: Genera recomendaciones para un usuario específico ---
   svr.Get("/api/recommend", [&](const httplib::Request &req,
                                 httplib::Response &res) {
-    if (!req.has_param("user_id")) { /* ... manejo de error ... */
+    // La consulta completa usa la versión vigente al empezar, aunque se
+    // publique otra mientras tanto. Mientras el arranque no publique SRPR
+    // (y con él el DataManager) no hay nada que servir.
+    auto models = model_store.current();
+    if (!models->srpr) {
+      res.status = 503;
+      res.set_content(startup_to_json(startup), "application/json");
       return;
     }
+    const DataManager &data_manager = *models->data;
+    if (!req.has_param("user_id")) {
+      res.status = 400;
+      res.set_content("{\"error\": \"falta el parametro user_id\"}",
+                      "application/json");
+      return;
+    }
+    auto lookup_start = std::chrono::steady_clock::now();
     int user_id = std::stoi(req.get_param_value("user_id"));
     int user_idx = data_manager.get_user_idx(user_id);
-    if (user_idx == -1) { /* ... manejo de error ... */
+    // Si /api/foldin dejó un vector para esta versión de los modelos, se usa
+    // ese: es el único para un usuario nuevo y el más fresco para uno conocido.
+    std::optional<FoldInCache::Entry> folded =
+        fold_in_cache.get(user_id, models->version);
+    server_metrics.record_stage(
+        ServerMetrics::IdLookup,
+        elapsed_ns(lookup_start, std::chrono::steady_clock::now()));
+    if (user_idx == -1 && !folded) {
+      res.status = 404;
+      res.set_content("{\"error\": \"usuario desconocido; se puede plegar "
+                      "con POST /api/foldin\"}",
+                      "application/json");
       return;
     }
     int top_k = req.has_param("k") ? std::stoi(req.get_param_value("k")) : 10;
     if (top_k <= 0)
       top_k = 10;
+    auto &srpr_model = models->srpr->model;
+    ConstVecView srpr_user_vec =
+        folded ? ConstVecView(folded->srpr) : srpr_model.get_user_vector(user_idx);
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    // Generar las 4 listas de recomendaciones y medir el tiempo de cada una
+    // Generar las 4 listas de recomendaciones y medir el tiempo de cada una.
+    // BPR puede no estar listo todavía; en ese caso sus listas van vacías.
+    std::vector<std::pair<int, double>> bpr_gt, bpr_lsh;
     auto t0 = std::chrono::high_resolution_clock::now();
-    auto bpr_gt = get_brute_force_vec(bpr_model.get_user_vector(user_idx),
-                                      bpr_model, data_manager, top_k);
-    auto t1 = std::chrono::high_resolution_clock::now();
-    auto bpr_lsh = lsh_index_bpr.find_neighbors(
-        bpr_model.get_user_vector(user_idx), top_k);
+    auto t1 = t0;
+    if (models->bpr && (!folded || folded->bpr.getDimension() > 0)) {
+      auto &bpr_model = models->bpr->model;
+      ConstVecView bpr_user_vec =
+          folded ? ConstVecView(folded->bpr) : bpr_model.get_user_vector(user_idx);
+      bpr_gt = get_brute_force_vec(bpr_user_vec, bpr_model, data_manager,
+                                   top_k);
+      t1 = std::chrono::high_resolution_clock::now();
+      LSHQueryStats bpr_stats;
+      bpr_lsh = models->bpr->index.find_neighbors(bpr_user_vec, top_k,
+                                                  &bpr_stats);
+      server_metrics.record_stage(BPR_MODEL, ServerMetrics::BruteForce,
+                                  std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+      server_metrics.record_lsh_query(BPR_MODEL, bpr_stats);
+    }
     auto t2 = std::chrono::high_resolution_clock::now();
-    auto srpr_gt = get_brute_force_vec(srpr_model.get_user_vector(user_idx),
-                                       srpr_model, data_manager, top_k);
+    auto srpr_gt = get_brute_force_vec(srpr_user_vec, srpr_model, data_manager,
+                                       top_k);
     auto t3 = std::chrono::high_resolution_clock::now();
-    auto srpr_lsh = lsh_index_srpr.find_neighbors(
-        srpr_model.get_user_vector(user_idx), top_k);
+    LSHQueryStats srpr_stats;
+    auto srpr_lsh = models->srpr->index.find_neighbors(srpr_user_vec, top_k,
+                                                       &srpr_stats);
     auto t4 = std::chrono::high_resolution_clock::now();
+    server_metrics.record_stage(SRPR_MODEL, ServerMetrics::BruteForce,
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count());
+    server_metrics.record_lsh_query(SRPR_MODEL, srpr_stats);
     // Calcular métricas para esta consulta específica
     QueryResultMetrics bpr_query_metrics =
         calculate_single_query_metrics(user_idx, data_manager, bpr_lsh, bpr_gt);
@@ -244,6 +439,7 @@ int main(int argc, char *argv[]) {
     std::chrono::duration<double, std::milli> srpr_lsh_time = t4 - t3;
 
     // Convertir a JSON
+    auto serialization_start = std::chrono::steady_clock::now();
     std::string bpr_gt_json = results_to_json(bpr_gt, data_manager);
     std::string bpr_lsh_json = results_to_json(bpr_lsh, data_manager);
     std::string srpr_gt_json = results_to_json(srpr_gt, data_manager);
@@ -262,6 +458,7 @@ int main(int argc, char *argv[]) {
     final_json_ss << "\"srpr_brute_force_ms\": " << srpr_gt_time.count() << ",";
     final_json_ss << "\"srpr_lsh_ms\": " << srpr_lsh_time.count();
     final_json_ss << "},";
+    final_json_ss << "\"model_version\": " << models->version << ",";
     final_json_ss << "\"query_metrics\": {"; // <-- NUEVO OBJETO DE MÉTRICAS
     final_json_ss << "\"bpr\": " << single_metric_to_json(bpr_query_metrics)
                   << ",";
@@ -269,6 +466,93 @@ int main(int argc, char *argv[]) {
     final_json_ss << "}}";
 
     res.set_content(final_json_ss.str(), "application/json");
+    server_metrics.record_stage(
+        ServerMetrics::Serialization,
+        elapsed_ns(serialization_start, std::chrono::steady_clock::now()));
+  });
+
+  // --- Endpoint API: fold-in de un usuario nuevo o con ratings nuevos ---
+  // Cuerpo: líneas "item_id,rating" (ids originales, como en ratings.csv).
+  // Pliega el usuario en ambos modelos sin reentrenar y devuelve sus
+  // recomendaciones LSH; con cache=1 /api/recommend usa después ese vector.
+  svr.Post("/api/foldin", [&](const httplib::Request &req,
+                              httplib::Response &res) {
+    auto models = model_store.current();
+    if (!models->srpr) {
+      res.status = 503;
+      res.set_content(startup_to_json(startup), "application/json");
+      return;
+    }
+    const DataManager &data_manager = *models->data;
+    if (!req.has_param("user_id")) {
+      res.status = 400;
+      res.set_content("{\"error\": \"falta el parametro user_id\"}",
+                      "application/json");
+      return;
+    }
+    int user_id = std::stoi(req.get_param_value("user_id"));
+    int top_k = req.has_param("k") ? std::stoi(req.get_param_value("k")) : 10;
+    if (top_k <= 0)
+      top_k = 10;
+    bool cache = req.has_param("cache") && req.get_param_value("cache") == "1";
+
+    std::vector<std::pair<int, double>> ratings;
+    std::stringstream body(req.body);
+    std::string line;
+    while (std::getline(body, line)) {
+      int item_id;
+      double rating;
+      if (std::sscanf(line.c_str(), "%d,%lf", &item_id, &rating) == 2)
+        ratings.push_back({item_id, rating});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto triplets = fold_in_triplets(data_manager, ratings, SRPR_FOLD_IN);
+    if (triplets.empty()) {
+      res.status = 422;
+      res.set_content("{\"error\": \"los ratings no forman ninguna "
+                      "preferencia entre items conocidos\"}",
+                      "application/json");
+      return;
+    }
+    // Un usuario conocido parte de su vector actual; uno nuevo, de cero.
+    int user_idx = data_manager.get_user_idx(user_id);
+    FoldInCache::Entry folded;
+    folded.model_version = models->version;
+    folded.srpr = fold_in_user(
+        models->srpr->model, triplets,
+        user_idx != -1 ? Vec(models->srpr->model.get_user_vector(user_idx))
+                       : fold_in_initial_vector(D, SRPR_FOLD_IN.seed),
+        SRPR_FOLD_IN);
+    if (models->bpr)
+      folded.bpr = fold_in_user(
+          models->bpr->model, triplets,
+          user_idx != -1 ? Vec(models->bpr->model.get_user_vector(user_idx))
+                         : fold_in_initial_vector(D, BPR_FOLD_IN.seed),
+          BPR_FOLD_IN);
+    std::chrono::duration<double, std::milli> fold_in_time =
+        std::chrono::steady_clock::now() - start;
+
+    auto srpr_lsh = models->srpr->index.find_neighbors(folded.srpr, top_k);
+    std::vector<std::pair<int, double>> bpr_lsh;
+    if (models->bpr)
+      bpr_lsh = models->bpr->index.find_neighbors(folded.bpr, top_k);
+    if (cache)
+      fold_in_cache.put(user_id, std::move(folded));
+
+    std::stringstream ss;
+    ss << "{";
+    ss << "\"user_id\": " << user_id << ", ";
+    ss << "\"known_user\": " << (user_idx != -1 ? "true" : "false") << ", ";
+    ss << "\"num_ratings\": " << ratings.size() << ", ";
+    ss << "\"num_triplets\": " << triplets.size() << ", ";
+    ss << "\"fold_in_ms\": " << fold_in_time.count() << ", ";
+    ss << "\"cached\": " << (cache ? "true" : "false") << ", ";
+    ss << "\"model_version\": " << models->version << ", ";
+    ss << "\"bpr_lsh\": " << results_to_json(bpr_lsh, data_manager) << ", ";
+    ss << "\"srpr_lsh\": " << results_to_json(srpr_lsh, data_manager);
+    ss << "}";
+    res.set_content(ss.str(), "application/json");
   });
 
   // === 3. Iniciar el Servidor ===
@@ -278,13 +562,14 @@ int main(int argc, char *argv[]) {
   std::cout << ">> http://" << host << ":" << port << " <<" << std::endl;
   svr.listen(host.c_str(), port);
 
+  startup_thread.join();
   return 0;
 }
 
 // --- Implementaciones de funciones helper ---
 // (Estas funciones deben estar aquí o en un utils.cpp si prefieres)
 
-double calculate_cosine_similarity(const Vec &vec1, const Vec &vec2) {
+double calculate_cosine_similarity(ConstVecView vec1, ConstVecView vec2) {
   if (vec1.getDimension() == 0 || vec2.getDimension() == 0)
     return 0.0;
   double dot_product = dot(vec1, vec2);
@@ -296,7 +581,7 @@ double calculate_cosine_similarity(const Vec &vec1, const Vec &vec2) {
 
 template <typename T>
 std::vector<std::pair<int, double>>
-get_brute_force_vec(const Vec &user_vec, const T &model, const DataManager &dm,
+get_brute_force_vec(ConstVecView user_vec, const T &model, const DataManager &dm,
                     int top_k) {
   std::vector<std::pair<double, int>> all_scores;
   for (int i = 0; i < dm.get_num_items(); ++i) {
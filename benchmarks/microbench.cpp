@@ -0,0 +1,434 @@
+// Microbenchmarks de los kernels de Vec, FixedVec, simd.h, Plane, LSH e int8, del índice
+// mutable y de las aproximaciones de fastmath.h frente a libm.
+//
+// Uso: ./Microbench [--benchmark_filter=<regex>] [--benchmark_out=<archivo.json>]
+//                   [--benchmark_min_time=<segundos>] [--max_items=<n>]
+//
+// La salida JSON sigue el formato de Google Benchmark ("context" + "benchmarks"),
+// así que dos corridas pueden compararse con tools/compare.py de esa librería
+// o con cualquier diff de JSON.
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/vec.h"
+#include "../src/fixedvec.h"
+#include "../src/matrix.h"
+#include "../src/simd.h"
+#include "../src/plane.h"
+#include "../src/lsh.h"
+#include "../src/quantize.h"
+#include "../src/fastmath.h"
+#include "../src/MutableIndex.h"
+
+using namespace std;
+
+template <typename T>
+inline void do_not_optimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchmarkResult {
+    string name;
+    long long iterations;
+    double real_time_ns;
+    double cpu_time_ns;
+    double items_per_second;
+};
+
+class BenchmarkRunner {
+public:
+    BenchmarkRunner(string filter, double min_time_s) : filter_(move(filter)), min_time_s_(min_time_s) {}
+
+    // body(iterations) ejecuta la operación iterations veces; items_per_iteration
+    // alimenta el contador items_per_second (p. ej. items puntuados por consulta).
+    void run(const string& name, const function<void(long long)>& body, double items_per_iteration = 1.0) {
+        if (!regex_search(name, filter_)) return;
+        long long iterations = 1;
+        double real_ns = 0.0, cpu_ns = 0.0;
+        while (true) {
+            auto real_start = chrono::steady_clock::now();
+            clock_t cpu_start = clock();
+            body(iterations);
+            cpu_ns = 1e9 * static_cast<double>(clock() - cpu_start) / CLOCKS_PER_SEC;
+            real_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - real_start).count();
+            if (real_ns >= min_time_s_ * 1e9 || iterations >= (1LL << 40)) break;
+            // Igual que Google Benchmark: extrapolar hacia el tiempo mínimo con margen.
+            double multiplier = real_ns > 0 ? min(10.0, max(1.4 * min_time_s_ * 1e9 / real_ns, 2.0)) : 10.0;
+            iterations = static_cast<long long>(iterations * multiplier) + 1;
+        }
+        BenchmarkResult result{name, iterations, real_ns / iterations, cpu_ns / iterations,
+                               items_per_iteration * iterations / (real_ns * 1e-9)};
+        cout << left << setw(48) << name << right << setw(14) << fixed << setprecision(1) << result.real_time_ns
+             << " ns" << setw(14) << result.cpu_time_ns << " ns" << setw(12) << iterations << endl;
+        results_.push_back(result);
+    }
+
+    void write_json(const string& filepath) const {
+        ofstream out(filepath);
+        if (!out.is_open()) {
+            cerr << "Error: No se pudo abrir " << filepath << endl;
+            return;
+        }
+        time_t now = time(nullptr);
+        char date[64];
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+        out << "{\n  \"context\": {\n";
+        out << "    \"date\": \"" << date << "\",\n";
+        out << "    \"num_cpus\": " << thread::hardware_concurrency() << ",\n";
+        out << "    \"simd_level\": \"" << simd_level_name(simd_kernels().level) << "\",\n";
+#ifdef NDEBUG
+        out << "    \"library_build_type\": \"release\"\n";
+#else
+        out << "    \"library_build_type\": \"debug\"\n";
+#endif
+        out << "  },\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const auto& r = results_[i];
+            out << "    {\"name\": \"" << r.name << "\", \"run_name\": \"" << r.name
+                << "\", \"run_type\": \"iteration\", \"iterations\": " << r.iterations
+                << ", \"real_time\": " << fixed << setprecision(3) << r.real_time_ns
+                << ", \"cpu_time\": " << r.cpu_time_ns
+                << ", \"time_unit\": \"ns\", \"items_per_second\": " << r.items_per_second << "}"
+                << (i + 1 < results_.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        cout << "Resultados JSON guardados en: " << filepath << endl;
+    }
+
+private:
+    regex filter_;
+    double min_time_s_;
+    vector<BenchmarkResult> results_;
+};
+
+vector<Vec> random_vectors(size_t count, size_t dimension, unsigned seed) {
+    mt19937 gen(seed);
+    normal_distribution<double> dist(0.0, 1.0);
+    vector<Vec> vectors;
+    vectors.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        Vec v(dimension);
+        for (size_t j = 0; j < dimension; ++j) v[j] = dist(gen);
+        vectors.push_back(move(v));
+    }
+    return vectors;
+}
+
+// Fuerza bruta equivalente a get_brute_force_vec de los ejecutables.
+vector<pair<int, double>> brute_force_top_k(const Vec& query, const vector<Vec>& items, int top_k) {
+    vector<pair<double, int>> all_scores;
+    all_scores.reserve(items.size());
+    double query_norm = query.magnitude();
+    for (size_t i = 0; i < items.size(); ++i) {
+        all_scores.push_back({dot(query, items[i]) / (query_norm * items[i].magnitude()), static_cast<int>(i)});
+    }
+    partial_sort(all_scores.begin(), all_scores.begin() + min<size_t>(top_k, all_scores.size()), all_scores.end(),
+                 greater<>());
+    vector<pair<int, double>> top_results;
+    for (int i = 0; i < min(top_k, static_cast<int>(all_scores.size())); ++i) {
+        top_results.push_back({all_scores[i].second, all_scores[i].first});
+    }
+    return top_results;
+}
+
+int main(int argc, char* argv[]) {
+    string filter = ".*";
+    string out_path;
+    double min_time = 0.2;
+    size_t max_items = 1000000;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--benchmark_filter=", 0) == 0) filter = arg.substr(19);
+        else if (arg.rfind("--benchmark_out=", 0) == 0) out_path = arg.substr(16);
+        else if (arg.rfind("--benchmark_min_time=", 0) == 0) min_time = stod(arg.substr(21));
+        else if (arg.rfind("--max_items=", 0) == 0) max_items = stoul(arg.substr(12));
+        else {
+            cerr << "Argumento desconocido: " << arg << endl;
+            return 1;
+        }
+    }
+
+    const vector<size_t> dimensions = {16, 32, 64, 128};
+    const vector<size_t> item_counts = {1000, 10000, 100000, 1000000};
+    const int num_tables = 12, hash_size = 8, top_k = 10, num_queries = 64;
+
+    BenchmarkRunner runner(filter, min_time);
+    cout << left << setw(48) << "Benchmark" << right << setw(17) << "Time" << setw(17) << "CPU" << setw(12)
+         << "Iterations" << endl;
+
+    // --- fastmath.h frente a libm, sobre los rangos que usa SRPR ---
+    {
+        const size_t n = 4096;
+        vector<double> cosines(n), exponents(n), zs(n), probabilities(n), out(n);
+        mt19937 gen(3);
+        uniform_real_distribution<double> cosine_dist(-1.0, 1.0), z_dist(-8.0, 8.0), p_dist(1e-12, 1.0);
+        for (size_t i = 0; i < n; ++i) {
+            cosines[i] = cosine_dist(gen);
+            zs[i] = z_dist(gen);
+            exponents[i] = -0.5 * zs[i] * zs[i];
+            probabilities[i] = p_dist(gen);
+        }
+        auto bench = [&](const string& name, const vector<double>& in, auto function) {
+            runner.run(name, [&](long long iters) {
+                for (long long it = 0; it < iters; ++it) {
+                    // Las de fastmath.h se vectorizan acá (declare simd); las de libm no.
+                    #pragma omp simd
+                    for (size_t i = 0; i < n; ++i) out[i] = function(in[i]);
+                    do_not_optimize(out.data());
+                }
+            }, static_cast<double>(n));
+        };
+        bench("BM_libm_acos", cosines, [](double x) { return acos(x); });
+        bench("BM_fast_acos", cosines, [](double x) { return fast_acos(x); });
+        bench("BM_libm_erf", zs, [](double x) { return erf(x); });
+        bench("BM_fast_erf", zs, [](double x) { return fast_erf(x); });
+        bench("BM_libm_exp", exponents, [](double x) { return exp(x); });
+        bench("BM_fast_exp", exponents, [](double x) { return fast_exp(x); });
+        bench("BM_libm_log", probabilities, [](double x) { return log(x); });
+        bench("BM_fast_log", probabilities, [](double x) { return fast_log(x); });
+    }
+
+    // --- Kernels por vector ---
+    for (size_t d : dimensions) {
+        auto vectors = random_vectors(num_queries, d, 1);
+        string suffix = "/" + to_string(d);
+
+        runner.run("BM_dot" + suffix, [&](long long iters) {
+            for (long long i = 0; i < iters; ++i) do_not_optimize(dot(vectors[i % num_queries], vectors[(i + 1) % num_queries]));
+        });
+        // El bucle secuencial de antes frente a la especialización de fixedvec.h.
+        runner.run("BM_dynamic_dot" + suffix, [&](long long iters) {
+            for (long long i = 0; i < iters; ++i) {
+                do_not_optimize(dynamic_dot(vectors[i % num_queries].data(), vectors[(i + 1) % num_queries].data(), d));
+            }
+        });
+        // Cada nivel de simd.h que soporta esta CPU (todos dan el mismo resultado).
+        for (SimdLevel level : {SimdLevel::Portable, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            if (level > simd_detect_level()) continue;
+            const SimdKernels kernels = simd_kernels_for(level);
+            const string level_suffix = string("_") + simd_level_name(level) + suffix;
+            runner.run("BM_simd_dot" + level_suffix, [&](long long iters) {
+                for (long long i = 0; i < iters; ++i) {
+                    do_not_optimize(kernels.dot(vectors[i % num_queries].data(), vectors[(i + 1) % num_queries].data(), d));
+                }
+            });
+            runner.run("BM_simd_axpy" + level_suffix, [&](long long iters) {
+                Vec y = vectors[0];
+                for (long long i = 0; i < iters; ++i) kernels.axpy(1e-3, vectors[i % num_queries].data(), y.data(), d);
+                do_not_optimize(y.data());
+            });
+        }
+        // Una consulta contra num_queries filas contiguas: dot() por fila frente
+        // a una sola llamada a simd_batch_dot.
+        {
+            const EmbeddingMatrix rows(vectors);
+            vector<double> scores(rows.size());
+            runner.run("BM_dot_rows" + suffix, [&](long long iters) {
+                for (long long i = 0; i < iters; ++i) {
+                    for (size_t r = 0; r < rows.size(); ++r) scores[r] = dot(vectors[i % num_queries].data(), rows.row(r), d);
+                    do_not_optimize(scores.data());
+                }
+            }, static_cast<double>(rows.size()));
+            runner.run("BM_simd_batch_dot" + suffix, [&](long long iters) {
+                for (long long i = 0; i < iters; ++i) {
+                    simd_batch_dot(vectors[i % num_queries].data(), rows.data(), rows.size(), d, scores.data());
+                    do_not_optimize(scores.data());
+                }
+            }, static_cast<double>(rows.size()));
+        }
+        dispatch_dimension(d, [&](auto fixed) {
+            constexpr size_t D = decltype(fixed)::value;
+            if constexpr (D != 0) {
+                runner.run("BM_fixed_dot" + suffix, [&](long long iters) {
+                    for (long long i = 0; i < iters; ++i) {
+                        do_not_optimize(fixed_dot<D>(vectors[i % num_queries].data(), vectors[(i + 1) % num_queries].data()));
+                    }
+                });
+                // Actualización de SGD como la de MatrixFactorization::train, con
+                // una expresión de Vec (un solo bucle, sin temporales) o FixedVec.
+                runner.run("BM_Vec_sgd_update" + suffix, [&](long long iters) {
+                    Vec x = vectors[0];
+                    for (long long i = 0; i < iters; ++i) {
+                        const Vec& y = vectors[i % num_queries];
+                        x += (y * 0.5 - (x * 0.01)) * 0.05;
+                    }
+                    do_not_optimize(x.data());
+                });
+                runner.run("BM_FixedVec_sgd_update" + suffix, [&](long long iters) {
+                    FixedVec<double, D> x(vectors[0].data());
+                    for (long long i = 0; i < iters; ++i) {
+                        FixedVec<double, D> y(vectors[i % num_queries].data());
+                        x += (y * 0.5 - (x * 0.01)) * 0.05;
+                    }
+                    do_not_optimize(x.data());
+                });
+            }
+        });
+        vector<int8_t> codes(num_queries * int8_padded_dim(d));
+        for (int i = 0; i < num_queries; ++i) {
+            quantize_int8(vectors[i].data(), d, codes.data() + i * int8_padded_dim(d));
+        }
+        const Int8DotKernel int8_dot = int8_dot_kernel();
+        runner.run("BM_int8_dot" + suffix, [&](long long iters) {
+            const size_t stride = int8_padded_dim(d);
+            for (long long i = 0; i < iters; ++i) {
+                do_not_optimize(int8_dot(codes.data() + (i % num_queries) * stride,
+                                         codes.data() + ((i + 1) % num_queries) * stride, stride));
+            }
+        });
+        runner.run("BM_Vec_magnitude" + suffix, [&](long long iters) {
+            for (long long i = 0; i < iters; ++i) do_not_optimize(vectors[i % num_queries].magnitude());
+        });
+        Plane plane(vectors[0]);
+        runner.run("BM_Plane_getBit" + suffix, [&](long long iters) {
+            for (long long i = 0; i < iters; ++i) do_not_optimize(plane.getBit(vectors[i % num_queries]));
+        });
+        SignedRandomProjectionLSH lsh(num_tables, hash_size, d);
+        runner.run("BM_SRP_hash_vector" + suffix, [&](long long iters) {
+            for (long long i = 0; i < iters; ++i) {
+                string code = lsh.hash_vector(vectors[i % num_queries], i % num_tables);
+                do_not_optimize(code);
+            }
+        });
+        runner.run("BM_SRP_hash_code" + suffix, [&](long long iters) {
+            for (long long i = 0; i < iters; ++i) do_not_optimize(lsh.hash_code(vectors[i % num_queries].data(), i % num_tables));
+        });
+    }
+
+    // --- Consultas sobre catálogos de distintos tamaños ---
+    for (size_t d : dimensions) {
+        auto queries = random_vectors(num_queries, d, 2);
+        for (size_t n : item_counts) {
+            if (n > max_items) continue;
+            string suffix = "/" + to_string(d) + "/" + to_string(n);
+            // Solo se generan los datos si algún benchmark de este tamaño pasa el filtro.
+            regex re(filter);
+            if (!regex_search("BM_LSH_query" + suffix, re) && !regex_search("BM_LSHIndex_build" + suffix, re) &&
+                !regex_search("BM_LSHIndex_find_neighbors" + suffix, re) && !regex_search("BM_brute_force" + suffix, re) &&
+                !regex_search("BM_MutableLSHIndex" + suffix, re))
+                continue;
+            auto items = random_vectors(n, d, 3);
+            const EmbeddingMatrix item_matrix(items);
+
+            if (regex_search("BM_LSH_query" + suffix, re)) {
+                SignedRandomProjectionLSH lsh(num_tables, hash_size, d);
+                for (size_t i = 0; i < n; ++i) lsh.insert(items[i], static_cast<int>(i));
+                runner.run("BM_LSH_query" + suffix, [&](long long iters) {
+                    for (long long i = 0; i < iters; ++i) do_not_optimize(lsh.query(queries[i % num_queries]).size());
+                });
+            }
+
+            runner.run("BM_LSHIndex_build" + suffix, [&](long long iters) {
+                for (long long i = 0; i < iters; ++i) {
+                    SignedRandomProjectionLSH lsh(num_tables, hash_size, d);
+                    LSHIndex index(lsh);
+                    index.set_verbose(false);
+                    index.build(item_matrix);
+                    do_not_optimize(index.size());
+                }
+            }, static_cast<double>(n));
+
+            SignedRandomProjectionLSH lsh(num_tables, hash_size, d);
+            LSHIndex index(lsh);
+            index.set_verbose(false);
+            if (regex_search("BM_LSHIndex_find_neighbors" + suffix, re)) index.build(item_matrix);
+            runner.run("BM_LSHIndex_find_neighbors" + suffix, [&](long long iters) {
+                for (long long i = 0; i < iters; ++i) do_not_optimize(index.find_neighbors(queries[i % num_queries], top_k).size());
+            });
+
+            if (regex_search("BM_MutableLSHIndex" + suffix, re)) {
+                MutableLSHIndex mutable_index(num_tables, hash_size, static_cast<int>(d));
+                mutable_index.set_verbose(false);
+                mutable_index.build(item_matrix);
+                // Con compactación en segundo plano desde el principio, como en
+                // uso normal: sin ella el delta crece una entrada por iteración y
+                // se mide la copia de grow() en vez de un alta.
+                mutable_index.start_background_compaction(chrono::milliseconds(50));
+                runner.run("BM_MutableLSHIndex_upsert" + suffix, [&](long long iters) {
+                    for (long long i = 0; i < iters; ++i) {
+                        mutable_index.upsert(static_cast<int>(n + i % 1024), queries[i % num_queries]);
+                    }
+                });
+                // Las consultas arrancan con el delta vacío, no con lo que dejó
+                // la calibración del benchmark anterior.
+                mutable_index.compact();
+                // Consultas con un escritor concurrente que alterna altas y bajas
+                // (y con ello compactaciones en segundo plano). El escritor va a
+                // ritmo fijo (~64 escrituras por ms): a toda velocidad le gana a
+                // la compactación y el delta crece sin límite.
+                atomic<bool> writing{true};
+                thread writer([&] {
+                    for (long long i = 0; writing.load(); ++i) {
+                        int item_id = static_cast<int>(i % n);
+                        if (i % 2 == 0) mutable_index.remove(item_id);
+                        else mutable_index.upsert(item_id, items[item_id]);
+                        if (i % 64 == 63) this_thread::sleep_for(chrono::milliseconds(1));
+                    }
+                });
+                runner.run("BM_MutableLSHIndex_find_neighbors" + suffix, [&](long long iters) {
+                    for (long long i = 0; i < iters; ++i) {
+                        do_not_optimize(mutable_index.find_neighbors(queries[i % num_queries], top_k).size());
+                    }
+                });
+                writing.store(false);
+                writer.join();
+            }
+
+            runner.run("BM_brute_force" + suffix, [&](long long iters) {
+                for (long long i = 0; i < iters; ++i) do_not_optimize(brute_force_top_k(queries[i % num_queries], items, top_k).size());
+            }, static_cast<double>(n));
+        }
+    }
+
+    // --- Consistencia de MutableLSHIndex con un escritor concurrente ---
+    // Cada id alterna entre dos versiones con la misma dirección (mismos
+    // buckets, coseno 1 con la consulta), así que consultar con su vector debe
+    // devolverlo primero, ya sea en la versión vieja o en la nueva.
+    size_t consistency_failures = 0;
+    {
+        const size_t d = 32, n = 1000;
+        const string name = "BM_MutableLSHIndex_consistency/" + to_string(d) + "/" + to_string(n);
+        if (regex_search(name, regex(filter))) {
+            auto items = random_vectors(n, d, 4);
+            vector<Vec> scaled;
+            for (const Vec& item : items) scaled.push_back(item * 2.0);
+            MutableLSHIndex mutable_index(num_tables, hash_size, static_cast<int>(d), 42, 64);
+            mutable_index.set_verbose(false);
+            mutable_index.build(EmbeddingMatrix(items));
+            mutable_index.start_background_compaction(chrono::milliseconds(5), 256);
+            atomic<bool> writing{true};
+            thread writer([&] {
+                for (long long i = 0; writing.load(); ++i) {
+                    int item_id = static_cast<int>(i % n);
+                    mutable_index.upsert(item_id, (i / n) % 2 == 0 ? scaled[item_id] : items[item_id]);
+                }
+            });
+            runner.run(name, [&](long long iters) {
+                for (long long i = 0; i < iters; ++i) {
+                    int item_id = static_cast<int>((i * 7) % n);
+                    auto results = mutable_index.find_neighbors(items[item_id], 1);
+                    if (results.empty() || results[0].first != item_id) consistency_failures++;
+                }
+            });
+            writing.store(false);
+            writer.join();
+            if (consistency_failures > 0) {
+                cerr << "Error: " << consistency_failures << " consultas no vieron ni la version vieja ni la nueva del item." << endl;
+            }
+        }
+    }
+
+    if (!out_path.empty()) runner.write_json(out_path);
+    return consistency_failures > 0 ? 1 : 0;
+}
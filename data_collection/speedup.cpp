@@ -12,10 +12,11 @@
 #include "../src/SRPRModel.h"
 #include "../src/lsh.h"
 #include "../src/MetricsCalculator.h"
+#include "../src/GroundTruth.h"
 
 using Clock = std::chrono::high_resolution_clock;
 
-double calculate_cosine_similarity(const Vec& vec1, const Vec& vec2) {
+double calculate_cosine_similarity(ConstVecView vec1, ConstVecView vec2) {
     if (vec1.getDimension() == 0 || vec2.getDimension() == 0) return 0.0;
     double dot_product = dot(vec1, vec2);
     double magnitude_product = vec1.magnitude() * vec2.magnitude();
@@ -24,7 +25,7 @@ double calculate_cosine_similarity(const Vec& vec1, const Vec& vec2) {
 }
 
 template<typename T>
-std::vector<std::pair<int, double>> get_brute_force_vec(const Vec& user_vec, const T& model, const DataManager& dm, int top_k) {
+std::vector<std::pair<int, double>> get_brute_force_vec(ConstVecView user_vec, const T& model, const DataManager& dm, int top_k) {
     std::vector<std::pair<double, int>> all_scores;
     all_scores.reserve(dm.get_num_items());
     for (int i = 0; i < dm.get_num_items(); ++i) {
@@ -57,7 +58,7 @@ std::string generate_speedup_recall_data(
 
     std::vector<int> bits_to_test = {4, 8, 12, 16};
 
-    std::string output_filename = base_filename + ".txt";
+    std::string output_filename = dm.get_dataset_prefix() + base_filename + ".txt";
     std::ofstream results_file(output_filename);
 
     if (!results_file.is_open()) {
@@ -69,35 +70,52 @@ std::string generate_speedup_recall_data(
     std::cout << "\n--- Iniciando Experimento: " << base_filename << " ---" << std::endl;
     std::cout << "Configuracion: " << num_tables << " tablas LSH, " << D << " dimensiones, " << num_test_users << " usuarios de prueba." << std::endl;
 
+    // Los modelos se llaman "bpr_speedup_recall" -> "bpr": índice y verdad de referencia son del modelo.
+    const std::string model_name = dm.get_dataset_prefix() + base_filename.substr(0, base_filename.find('_'));
+    const int num_users = std::min(num_test_users, dm.get_num_users());
+    GroundTruth ground_truth = GroundTruth::load_or_compute(model, num_users, top_k, ground_truth_path(model_name));
+
+    // El tiempo de fuerza bruta no depende de los bits: se mide una vez sobre una
+    // muestra de usuarios y se usa su promedio como referencia del speedup.
+    const int num_timed_users = std::min(num_users, 50);
+    double bf_time_ms = 0.0;
+    for (int user_idx = 0; user_idx < num_timed_users; ++user_idx) {
+        auto bf_start = Clock::now();
+        auto results = get_brute_force_vec(model.get_user_vector(user_idx), model, dm, top_k);
+        std::chrono::duration<double, std::milli> bf_time = Clock::now() - bf_start;
+        bf_time_ms += bf_time.count() / num_timed_users;
+    }
+    std::cout << "Fuerza bruta: " << bf_time_ms << " ms por consulta (promedio de " << num_timed_users << " usuarios)." << std::endl;
+
     for (int bits : bits_to_test) {
         std::cout << "\n[Evaluando con b = " << bits << " bits...]" << std::endl;
 
-        auto build_start = Clock::now();
+        // Si ya hay un índice persistido se mapea en vez de construirlo: son
+        // tiempos distintos y se informan por separado.
         SignedRandomProjectionLSH lsh(num_tables, bits, D);
         LSHIndex lsh_index(lsh);
-        for (int i = 0; i < num_items; ++i) {
-            lsh_index.add(i, model.get_item_vector(i));
+        const std::string index_path = lsh_index_path(model_name, num_tables, bits);
+        auto load_start = Clock::now();
+        if (lsh_index.load(index_path, model.get_item_vectors())) {
+            std::chrono::duration<double, std::milli> load_time_ms = Clock::now() - load_start;
+            std::cout << "  Indice LSH cargado desde " << index_path << " en " << load_time_ms.count() << " ms." << std::endl;
+        } else {
+            lsh_index.build(model.get_item_vectors());
+            std::cout << "  Indice LSH construido en " << lsh_index.last_build_ms() << " ms." << std::endl;
+            lsh_index.save(index_path);
         }
-        auto build_end = Clock::now();
-        std::chrono::duration<double, std::milli> build_time_ms = build_end - build_start;
-        std::cout << "  Indice LSH construido en " << build_time_ms.count() << " ms." << std::endl;
 
         MetricsCalculator metrics_calculator;
 
-        for (int user_idx = 0; user_idx < std::min(num_test_users, dm.get_num_users()); ++user_idx) {
-            const Vec& user_vec = model.get_user_vector(user_idx);
-
-            auto bf_start = Clock::now();
-            auto ground_truth = get_brute_force_vec(user_vec, model, dm, top_k);
-            auto bf_end = Clock::now();
-            std::chrono::duration<double, std::milli> bf_time = bf_end - bf_start;
+        for (int user_idx = 0; user_idx < num_users; ++user_idx) {
+            ConstVecView user_vec = model.get_user_vector(user_idx);
 
             auto lsh_start = Clock::now();
             auto lsh_results = lsh_index.find_neighbors(user_vec, top_k);
             auto lsh_end = Clock::now();
             std::chrono::duration<double, std::milli> lsh_time = lsh_end - lsh_start;
 
-            metrics_calculator.add_query_result(user_idx, dm, lsh_results, ground_truth, bf_time.count(), lsh_time.count());
+            metrics_calculator.add_query_result(user_idx, dm, lsh_results, ground_truth.top_k(user_idx, top_k), bf_time_ms, lsh_time.count());
         }
 
         double avg_recall = metrics_calculator.get_average_recall();
@@ -118,33 +136,33 @@ std::string generate_speedup_recall_data(
     return output_filename;
 }
 
-int main() {
-    const std::string RATING_FILE = "../data/ratings.csv";
-    const int MAX_RATINGS = 20000000;
+int main(int argc, char *argv[]) {
+    const DatasetOptions DATASET = parse_dataset_options(argc, argv, {"../data/ratings.csv", 20000000});
     const int D = 32;
     const int TOP_K = 10;
     const int NUM_TEST_USERS = 500;
-    const std::string BPR_VECTORS_FILE = "../data/bpr_vectors.txt";
-    const std::string SRPR_VECTORS_FILE = "../data/srpr_vectors.txt";
+    const std::string BPR_VECTORS_FILE = "../data/" + dataset_prefix(DATASET.ratings_path) + "bpr_vectors.txt";
+    const std::string SRPR_VECTORS_FILE = "../data/" + dataset_prefix(DATASET.ratings_path) + "srpr_vectors.txt";
 
-    DataManager data_manager(RATING_FILE, MAX_RATINGS, 300);
+    DataManager data_manager(DATASET.ratings_path, DATASET.max_ratings, 300);
     data_manager.init();
     if (data_manager.get_training_triplets().empty()) return 1;
+    const uint64_t CATALOG_FINGERPRINT = data_manager.catalog_fingerprint();
 
     MatrixFactorization bpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
-    if (!bpr_model.load_vectors(BPR_VECTORS_FILE)) {
+    if (!bpr_model.load_vectors(BPR_VECTORS_FILE, CATALOG_FINGERPRINT)) {
         std::cout << "\n--- ENTRENANDO MODELO BASE (BPR) ---" << std::endl;
         bpr_model.train(data_manager.get_training_triplets(), 20, 0.02, 0.01);
-        bpr_model.save_vectors(BPR_VECTORS_FILE);
+        bpr_model.save_vectors(BPR_VECTORS_FILE, CATALOG_FINGERPRINT);
     } else {
         std::cout << "\n--- Vectores BPR cargados desde " << BPR_VECTORS_FILE << " ---" << std::endl;
     }
 
     SRPRModel srpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
-    if(!srpr_model.load_vectors(SRPR_VECTORS_FILE)) {
+    if(!srpr_model.load_vectors(SRPR_VECTORS_FILE, CATALOG_FINGERPRINT)) {
         std::cout << "\n--- ENTRENANDO MODELO AVANZADO (SRPR) ---" << std::endl;
         srpr_model.train(data_manager.get_training_triplets(), 8, 0.05, 0.001, 20);
-        srpr_model.save_vectors(SRPR_VECTORS_FILE);
+        srpr_model.save_vectors(SRPR_VECTORS_FILE, CATALOG_FINGERPRINT);
     } else {
          std::cout << "\n--- Vectores SRPR cargados desde " << SRPR_VECTORS_FILE << " ---" << std::endl;
     }
@@ -0,0 +1,339 @@
+// Barrido de parámetros LSH: recall@k contra throughput.
+//
+// Uso: ./Sweep [--tables=4,8,12,16] [--bits=4,6,8,10,12,16] [--probes=1,2,4,8]
+//              [--k=10,20] [--models=bpr,srpr] [--users=<n>]
+//              [--sketch_bits=0,128,256] [--rerank=<candidatos>]
+//              [--bucket_cap=0,256,1024] [--int8=0,1] [--rescore=<candidatos>]
+//              [--pq=0,8,16] [--pq_rescore=<candidatos>]
+//              [--out=<pareto.csv>] [--all_out=<todos.csv>]
+//              [--ratings=<archivo.csv>] [--max_ratings=<n>]
+//
+// Para cada modelo y cada (tablas, bits) construye el índice congelado una vez
+// (tiempo de build y memoria), y para cada (probes, k) lanza todas las
+// consultas de prueba en paralelo: queries/s del lote completo, latencia por
+// consulta (p50/p99) y recall@k contra el top-k exacto. Con --sketch_bits > 0
+// se añade el re-ranking por Hamming (solo --rerank candidatos llegan al coseno);
+// con --bucket_cap > 0 cada bucket recorre como mucho ese número de items. Por
+// cada índice se imprime el histograma de ocupación de los buckets. Con
+// --int8=1 los candidatos se puntúan con los items cuantizados y solo --rescore
+// pasan al coseno exacto; con --pq=<subespacios> antes se filtran por
+// cuantización producto hasta --pq_rescore. recall_loss es la caída de recall
+// frente a la misma configuración sin int8 ni PQ (si también se midió). La verdad de referencia
+// (top-k_max exacto por usuario) sale del cache de GroundTruth.
+// El CSV de salida tiene solo las configuraciones Pareto-óptimas en
+// (queries/s, recall@k) para cada modelo y k; --all_out guarda todas.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../src/DataManager.h"
+#include "../src/MatrixFactorization.h"
+#include "../src/SRPRModel.h"
+#include "../src/lsh.h"
+#include "../src/GroundTruth.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct SweepConfig {
+    std::vector<int> tables = {4, 8, 12, 16};
+    std::vector<int> bits = {4, 6, 8, 10, 12, 16};
+    std::vector<int> probes = {1, 2, 4, 8};
+    std::vector<int> ks = {10, 20};
+    std::vector<int> sketch_bits = {0};
+    std::vector<int> bucket_caps = {0};
+    std::vector<int> int8 = {0};
+    int rescore = 50;
+    std::vector<int> pq = {0};
+    int pq_rescore = 100;
+    int rerank = 256;
+    std::vector<std::string> models = {"bpr", "srpr"};
+    int num_test_users = 1000;
+    std::string pareto_out = "sweep_pareto.csv";
+    std::string all_out = "sweep_all.csv";
+    std::string dataset_prefix;
+};
+
+struct SweepResult {
+    std::string model;
+    int k, num_tables, hash_size, probes, sketch_bits, rerank, bucket_cap, int8, rescore, pq, pq_rescore;
+    size_t max_bucket;
+    double qps, p50_us, p99_us, recall, avg_candidates, avg_rescored, index_mb, build_ms;
+    bool pareto = false;
+    double recall_loss = std::nan("");
+};
+
+std::vector<int> parse_int_list(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string cell;
+    while (std::getline(ss, cell, ',')) values.push_back(std::stoi(cell));
+    return values;
+}
+
+// Marca los puntos no dominados en (qps, recall) dentro de cada (modelo, k).
+void mark_pareto(std::vector<SweepResult>& results) {
+    for (auto& a : results) {
+        a.pareto = true;
+        for (const auto& b : results) {
+            if (&a == &b || a.model != b.model || a.k != b.k) continue;
+            bool dominates = b.qps >= a.qps && b.recall >= a.recall && (b.qps > a.qps || b.recall > a.recall);
+            if (dominates) {
+                a.pareto = false;
+                break;
+            }
+        }
+    }
+}
+
+// recall_loss de cada punto con int8 o PQ: recall de la misma configuración en double menos el suyo.
+void compute_recall_loss(std::vector<SweepResult>& results) {
+    for (auto& a : results) {
+        if (!a.int8 && !a.pq) continue;
+        for (const auto& b : results) {
+            if (!b.int8 && !b.pq && a.model == b.model && a.k == b.k && a.num_tables == b.num_tables &&
+                a.hash_size == b.hash_size && a.probes == b.probes && a.sketch_bits == b.sketch_bits &&
+                a.bucket_cap == b.bucket_cap) {
+                a.recall_loss = b.recall - a.recall;
+                break;
+            }
+        }
+    }
+}
+
+void write_results(const std::string& filepath, const std::vector<SweepResult>& results, bool only_pareto) {
+    std::ofstream out(filepath);
+    if (!out.is_open()) {
+        std::cerr << "Error: No se pudo abrir el archivo de salida " << filepath << std::endl;
+        return;
+    }
+    out << "model,k,num_tables,hash_size,probes,sketch_bits,rerank,bucket_cap,max_bucket,int8,rescore,pq,pq_rescore,qps,p50_us,p99_us,recall_at_k,avg_candidates,"
+           "avg_rescored,index_mb,build_ms,pareto,recall_loss\n";
+    for (const auto& r : results) {
+        if (only_pareto && !r.pareto) continue;
+        out << r.model << "," << r.k << "," << r.num_tables << "," << r.hash_size << "," << r.probes << ","
+            << r.sketch_bits << "," << r.rerank << "," << r.bucket_cap << "," << r.max_bucket << ","
+            << r.int8 << "," << r.rescore << "," << r.pq << "," << r.pq_rescore << "," << std::fixed << std::setprecision(1) << r.qps << "," << r.p50_us << "," << r.p99_us << ","
+            << std::setprecision(6) << r.recall << "," << std::setprecision(1) << r.avg_candidates << "," << r.avg_rescored << ","
+            << std::setprecision(3) << r.index_mb << "," << r.build_ms << "," << (r.pareto ? 1 : 0) << ",";
+        if (!std::isnan(r.recall_loss)) out << std::setprecision(6) << r.recall_loss;
+        out << "\n";
+    }
+    std::cout << "Resultados guardados en: " << filepath << std::endl;
+}
+
+template<typename ModelType>
+void sweep_model(const ModelType& model, const std::string& model_name, const SweepConfig& config,
+                 std::vector<SweepResult>& results) {
+    const auto& items = model.get_item_vectors();
+    const int D = items.empty() ? 0 : static_cast<int>(items[0].getDimension());
+    const int num_users = std::min(config.num_test_users, model.get_num_users());
+    const int k_max = *std::max_element(config.ks.begin(), config.ks.end());
+
+    std::cout << "\n--- Barrido para " << model_name << ": " << items.size() << " items, " << num_users
+              << " consultas ---" << std::endl;
+    GroundTruth ground_truth = GroundTruth::load_or_compute(model, num_users, k_max,
+                                                           ground_truth_path(config.dataset_prefix + model_name));
+
+    std::vector<std::vector<std::pair<int, double>>> answers(num_users);
+    std::vector<double> latencies_us(num_users);
+    std::vector<size_t> candidates(num_users), rescored(num_users);
+
+    for (int num_tables : config.tables) {
+        for (int bits : config.bits) {
+            SignedRandomProjectionLSH lsh(num_tables, bits, D);
+            LSHIndex index(lsh);
+            index.set_verbose(false);
+            index.build(items);
+            index.print_bucket_report(std::cout);
+            const size_t max_bucket = index.bucket_stats().max_size;
+
+            // (sketch_bits, pq, int8, bucket_cap, probes): sketches, códigos PQ e
+            // items int8 se recalculan solo cuando cambia su parámetro.
+            std::vector<std::tuple<int, int, int, int, int>> query_configs;
+            for (int sketch_bits : config.sketch_bits) {
+                for (int pq : config.pq) {
+                    for (int int8 : config.int8) {
+                        for (int bucket_cap : config.bucket_caps) {
+                            for (int probes : config.probes) {
+                                query_configs.push_back({sketch_bits, pq, int8, bucket_cap, probes});
+                            }
+                        }
+                    }
+                }
+            }
+            for (size_t c = 0; c < query_configs.size(); ++c) {
+                const auto [sketch_bits, pq, int8, bucket_cap, probes] = query_configs[c];
+                if (c == 0 || sketch_bits != std::get<0>(query_configs[c - 1])) {
+                    index.set_sketch_rerank(sketch_bits, config.rerank);
+                }
+                if (c == 0 || pq != std::get<1>(query_configs[c - 1])) index.set_pq_scoring(pq, config.pq_rescore);
+                if (c == 0 || int8 != std::get<2>(query_configs[c - 1])) index.set_int8_scoring(int8 != 0, config.rescore);
+                const int rerank = sketch_bits > 0 ? config.rerank : 0;
+                const int rescore = int8 ? config.rescore : 0;
+                const int pq_rescore = pq ? config.pq_rescore : 0;
+                const double index_mb = index.memory_bytes() / (1024.0 * 1024.0);
+                index.set_bucket_cap(bucket_cap);
+                index.set_num_probes(probes);
+                for (int k : config.ks) {
+                    // Calentamiento fuera de la medición.
+                    for (int u = 0; u < std::min(num_users, 32); ++u) index.find_neighbors(model.get_user_vector(u), k);
+
+                    auto batch_start = Clock::now();
+                    #pragma omp parallel for schedule(dynamic, 8)
+                    for (int u = 0; u < num_users; ++u) {
+                        LSHQueryStats stats;
+                        auto query_start = Clock::now();
+                        answers[u] = index.find_neighbors(model.get_user_vector(u), k, &stats);
+                        latencies_us[u] = std::chrono::duration<double, std::micro>(Clock::now() - query_start).count();
+                        candidates[u] = stats.num_candidates;
+                        rescored[u] = stats.num_rescored;
+                    }
+                    std::chrono::duration<double> batch_s = Clock::now() - batch_start;
+
+                    double recall_sum = 0.0, candidate_sum = 0.0, rescored_sum = 0.0;
+                    for (int u = 0; u < num_users; ++u) {
+                        auto truth_list = ground_truth.top_k(u, k);
+                        if (truth_list.empty()) continue;
+                        std::unordered_set<int> truth;
+                        for (const auto& entry : truth_list) truth.insert(entry.first);
+                        int hits = 0;
+                        for (const auto& answer : answers[u]) hits += truth.count(answer.first);
+                        recall_sum += static_cast<double>(hits) / truth_list.size();
+                        candidate_sum += candidates[u];
+                        rescored_sum += rescored[u];
+                    }
+                    std::vector<double> sorted_latencies = latencies_us;
+                    std::sort(sorted_latencies.begin(), sorted_latencies.end());
+                    auto percentile = [&sorted_latencies](double q) {
+                        if (sorted_latencies.empty()) return 0.0;
+                        return sorted_latencies[std::min(sorted_latencies.size() - 1, static_cast<size_t>(q * sorted_latencies.size()))];
+                    };
+
+                    SweepResult result{model_name, k, num_tables, bits, probes, sketch_bits, rerank, bucket_cap,
+                                       int8, rescore, pq, pq_rescore, max_bucket,
+                                       num_users / batch_s.count(), percentile(0.5), percentile(0.99),
+                                       recall_sum / std::max(1, num_users), candidate_sum / std::max(1, num_users),
+                                       rescored_sum / std::max(1, num_users), index_mb, index.last_build_ms()};
+                    std::cout << "  L=" << std::setw(2) << num_tables << " b=" << std::setw(2) << bits
+                              << " probes=" << std::setw(2) << probes << " sketch=" << std::setw(3) << sketch_bits
+                              << " cap=" << std::setw(4) << bucket_cap << " pq=" << std::setw(2) << pq << " int8=" << int8
+                              << " k=" << std::setw(2) << k
+                              << std::fixed << std::setprecision(1) << "  qps=" << std::setw(10) << result.qps
+                              << "  p99=" << std::setw(8) << result.p99_us << "us"
+                              << std::setprecision(4) << "  recall=" << result.recall
+                              << std::setprecision(1) << "  candidatos=" << result.avg_candidates
+                              << "  coseno=" << result.avg_rescored << std::endl;
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const DatasetOptions DATASET = parse_dataset_options(argc, argv, {"../data/ratings.csv", 22000000});
+    const int D = 32;
+    const std::string BPR_VECTORS_FILE = "../data/" + dataset_prefix(DATASET.ratings_path) + "bpr_vectors.txt";
+    const std::string SRPR_VECTORS_FILE = "../data/" + dataset_prefix(DATASET.ratings_path) + "srpr_vectors.txt";
+
+    SweepConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--tables=", 0) == 0) config.tables = parse_int_list(arg.substr(9));
+        else if (arg.rfind("--bits=", 0) == 0) config.bits = parse_int_list(arg.substr(7));
+        else if (arg.rfind("--probes=", 0) == 0) config.probes = parse_int_list(arg.substr(9));
+        else if (arg.rfind("--k=", 0) == 0) config.ks = parse_int_list(arg.substr(4));
+        else if (arg.rfind("--sketch_bits=", 0) == 0) config.sketch_bits = parse_int_list(arg.substr(14));
+        else if (arg.rfind("--rerank=", 0) == 0) config.rerank = std::stoi(arg.substr(9));
+        else if (arg.rfind("--bucket_cap=", 0) == 0) config.bucket_caps = parse_int_list(arg.substr(13));
+        else if (arg.rfind("--int8=", 0) == 0) config.int8 = parse_int_list(arg.substr(7));
+        else if (arg.rfind("--rescore=", 0) == 0) config.rescore = std::stoi(arg.substr(10));
+        else if (arg.rfind("--pq=", 0) == 0) config.pq = parse_int_list(arg.substr(5));
+        else if (arg.rfind("--pq_rescore=", 0) == 0) config.pq_rescore = std::stoi(arg.substr(13));
+        else if (arg.rfind("--users=", 0) == 0) config.num_test_users = std::stoi(arg.substr(8));
+        else if (arg.rfind("--out=", 0) == 0) config.pareto_out = arg.substr(6);
+        else if (arg.rfind("--all_out=", 0) == 0) config.all_out = arg.substr(10);
+        else if (arg.rfind("--models=", 0) == 0) {
+            config.models.clear();
+            std::stringstream ss(arg.substr(9));
+            std::string cell;
+            while (std::getline(ss, cell, ',')) config.models.push_back(cell);
+        } else if (arg.rfind("--ratings=", 0) != 0 && arg.rfind("--max_ratings=", 0) != 0) {
+            std::cerr << "Argumento desconocido: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (config.tables.empty() || config.bits.empty() || config.probes.empty() || config.ks.empty() ||
+        config.sketch_bits.empty() || config.bucket_caps.empty() ||
+        config.int8.empty() || config.pq.empty()) {
+        std::cerr << "Error: las listas de parametros no pueden estar vacias." << std::endl;
+        return 1;
+    }
+    for (int sketch_bits : config.sketch_bits) {
+        if (sketch_bits < 0 || sketch_bits > SRPSketcher::kMaxBits || sketch_bits % 64 != 0) {
+            std::cerr << "Error: --sketch_bits admite 0, 64, 128, 192 o 256." << std::endl;
+            return 1;
+        }
+    }
+    for (int pq : config.pq) {
+        if (pq < 0 || pq > ProductQuantizer::kMaxSubspaces || pq % 2 != 0 || (pq > 0 && D % pq != 0)) {
+            std::cerr << "Error: --pq debe ser 0 o un numero par de subespacios que divida " << D << "." << std::endl;
+            return 1;
+        }
+    }
+    config.dataset_prefix = dataset_prefix(DATASET.ratings_path);
+    config.pareto_out = config.dataset_prefix + config.pareto_out;
+    config.all_out = config.dataset_prefix + config.all_out;
+
+    DataManager data_manager(DATASET.ratings_path, DATASET.max_ratings, 300);
+    data_manager.init();
+    if (data_manager.get_training_triplets().empty()) return 1;
+    const uint64_t CATALOG_FINGERPRINT = data_manager.catalog_fingerprint();
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    std::cout << "Consultas en lotes paralelos con " << threads << " hilos." << std::endl;
+
+    std::vector<SweepResult> results;
+    for (const auto& model_name : config.models) {
+        if (model_name == "bpr") {
+            MatrixFactorization bpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
+            if (!bpr_model.load_vectors(BPR_VECTORS_FILE, CATALOG_FINGERPRINT)) {
+                bpr_model.train(data_manager.get_training_triplets(), 20, 0.02, 0.01);
+                bpr_model.save_vectors(BPR_VECTORS_FILE, CATALOG_FINGERPRINT);
+            }
+            sweep_model(bpr_model, model_name, config, results);
+        } else if (model_name == "srpr") {
+            SRPRModel srpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
+            if (!srpr_model.load_vectors(SRPR_VECTORS_FILE, CATALOG_FINGERPRINT)) {
+                srpr_model.train(data_manager.get_training_triplets(), 8, 0.05, 0.001, 20);
+                srpr_model.save_vectors(SRPR_VECTORS_FILE, CATALOG_FINGERPRINT);
+            }
+            sweep_model(srpr_model, model_name, config, results);
+        } else {
+            std::cerr << "Modelo desconocido: " << model_name << " (se esperaba bpr o srpr)" << std::endl;
+            return 1;
+        }
+    }
+
+    mark_pareto(results);
+    compute_recall_loss(results);
+    write_results(config.all_out, results, false);
+    write_results(config.pareto_out, results, true);
+    std::cout << "\n--- Barrido finalizado: " << results.size() << " configuraciones, "
+              << std::count_if(results.begin(), results.end(), [](const SweepResult& r) { return r.pareto; })
+              << " Pareto-optimas ---" << std::endl;
+    return 0;
+}
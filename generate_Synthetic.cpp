@@ -0,0 +1,290 @@
+// Generador de conjuntos de ratings sintéticos con el formato de MovieLens.
+//
+// Uso: ./generateSynthetic [--num_users=<n>] [--num_items=<n>] [--num_ratings=<n>]
+//                          [--clusters=<k>] [--alpha=<a>] [--user_alpha=<a>]
+//                          [--cluster_affinity=<p>] [--min_user_ratings=<n>]
+//                          [--latent_dim=<d>] [--seed=<s>] [--out=<archivo.csv>]
+//                          [--max_ratings=<n>] [--max_triplets_per_user=<n>[,<n>...]] [--no_cache]
+//
+// La popularidad de los items sigue una ley de potencias (Zipf con exponente
+// alpha) y la actividad de los usuarios otra (user_alpha). Items y usuarios
+// pertenecen a clusters latentes: cada usuario elige la mayoría de sus items
+// dentro de su cluster y el rating depende del coseno entre ambos vectores
+// latentes, así que los modelos tienen estructura que aprender.
+//
+// Además del CSV escribe directamente los caches binarios del DataManager
+// (uno por cada max_triplets_per_user), con el mismo contenido que se obtendría
+// preprocesando el CSV. Después basta con correr los ejecutables con
+// --ratings=<archivo.csv>, que lee el archivo completo (max_ratings = -1).
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "src/DataManager.h"
+
+using namespace std;
+
+struct SyntheticConfig {
+    int num_users = 100000;
+    int num_items = 20000;
+    long long num_ratings = 10000000;
+    int clusters = 50;
+    double alpha = 1.0;
+    double user_alpha = 0.8;
+    double cluster_affinity = 0.8;
+    int min_user_ratings = 20;
+    int latent_dim = 16;
+    uint64_t seed = 42;
+    string out = "../data/synthetic.csv";
+    int max_ratings = -1; // igual que los ejecutables con --ratings
+    vector<int> max_triplets_per_user = {200, 300};
+    bool write_cache = true;
+};
+
+// Muestreo proporcional a pesos con una suma acumulada y búsqueda binaria.
+class WeightedSampler {
+public:
+    WeightedSampler() = default;
+    void add(int value, double weight) {
+        values_.push_back(value);
+        cumulative_.push_back((cumulative_.empty() ? 0.0 : cumulative_.back()) + weight);
+    }
+    bool empty() const { return values_.empty(); }
+    template <typename Rng>
+    int sample(Rng& rng) const {
+        double target = uniform_real_distribution<double>(0.0, cumulative_.back())(rng);
+        size_t idx = upper_bound(cumulative_.begin(), cumulative_.end(), target) - cumulative_.begin();
+        return values_[min(idx, values_.size() - 1)];
+    }
+
+private:
+    vector<int> values_;
+    vector<double> cumulative_;
+};
+
+class SyntheticDataset {
+public:
+    explicit SyntheticDataset(const SyntheticConfig& config);
+
+    // Ratings del usuario user_idx (id original user_idx + 1). Solo depende de
+    // la semilla y del usuario, así que los bloques pueden generarse en paralelo.
+    vector<Rating> user_ratings(int user_idx) const;
+    long long expected_ratings() const { return expected_ratings_; }
+
+private:
+    const SyntheticConfig& config_;
+    vector<float> centers_;      // clusters x latent_dim
+    vector<float> item_latent_;  // items x latent_dim, normalizados
+    vector<int> user_counts_;
+    WeightedSampler global_sampler_;
+    vector<WeightedSampler> cluster_samplers_;
+    long long expected_ratings_ = 0;
+
+    void random_unit(mt19937_64& rng, const float* center, float spread, float* out) const;
+};
+
+SyntheticDataset::SyntheticDataset(const SyntheticConfig& config) : config_(config) {
+    const int L = config.latent_dim;
+    mt19937_64 rng(config.seed);
+
+    centers_.resize(static_cast<size_t>(config.clusters) * L);
+    for (int c = 0; c < config.clusters; ++c) random_unit(rng, nullptr, 1.0f, &centers_[static_cast<size_t>(c) * L]);
+
+    // Popularidad: rango aleatorio por item, independiente de su cluster.
+    vector<int> item_rank(config.num_items);
+    for (int i = 0; i < config.num_items; ++i) item_rank[i] = i;
+    shuffle(item_rank.begin(), item_rank.end(), rng);
+
+    item_latent_.resize(static_cast<size_t>(config.num_items) * L);
+    cluster_samplers_.resize(config.clusters);
+    uniform_int_distribution<int> cluster_dist(0, config.clusters - 1);
+    for (int i = 0; i < config.num_items; ++i) {
+        int cluster = cluster_dist(rng);
+        random_unit(rng, &centers_[static_cast<size_t>(cluster) * L], 0.6f, &item_latent_[static_cast<size_t>(i) * L]);
+        double weight = 1.0 / pow(item_rank[i] + 1.0, config.alpha);
+        global_sampler_.add(i, weight);
+        cluster_samplers_[cluster].add(i, weight);
+    }
+
+    // Actividad: también Zipf sobre un rango aleatorio, con un mínimo por usuario
+    // (MovieLens garantiza 20) y sin pasar de la mitad del catálogo.
+    vector<int> user_rank(config.num_users);
+    for (int u = 0; u < config.num_users; ++u) user_rank[u] = u;
+    shuffle(user_rank.begin(), user_rank.end(), rng);
+    double total_weight = 0.0;
+    for (int r = 0; r < config.num_users; ++r) total_weight += 1.0 / pow(r + 1.0, config.user_alpha);
+    double spare = max(0.0, static_cast<double>(config.num_ratings) - static_cast<double>(config.min_user_ratings) * config.num_users);
+    int max_per_user = max(1, config.num_items / 2);
+    user_counts_.resize(config.num_users);
+    for (int u = 0; u < config.num_users; ++u) {
+        double share = spare * (1.0 / pow(user_rank[u] + 1.0, config.user_alpha)) / total_weight;
+        user_counts_[u] = static_cast<int>(min<double>(max_per_user, config.min_user_ratings + share));
+        expected_ratings_ += user_counts_[u];
+    }
+}
+
+void SyntheticDataset::random_unit(mt19937_64& rng, const float* center, float spread, float* out) const {
+    normal_distribution<float> normal(0.0f, 1.0f);
+    const int L = config_.latent_dim;
+    float norm = 0.0f;
+    for (int k = 0; k < L; ++k) {
+        out[k] = (center ? center[k] : 0.0f) + spread * normal(rng);
+        norm += out[k] * out[k];
+    }
+    norm = sqrt(norm);
+    for (int k = 0; k < L; ++k) out[k] /= (norm > 0.0f ? norm : 1.0f);
+}
+
+vector<Rating> SyntheticDataset::user_ratings(int user_idx) const {
+    const int L = config_.latent_dim;
+    mt19937_64 rng(config_.seed ^ (0x9E3779B97F4A7C15ULL * (static_cast<uint64_t>(user_idx) + 1)));
+    int cluster = uniform_int_distribution<int>(0, config_.clusters - 1)(rng);
+    while (cluster_samplers_[cluster].empty()) cluster = (cluster + 1) % config_.clusters;
+    vector<float> latent(L);
+    random_unit(rng, &centers_[static_cast<size_t>(cluster) * L], 0.6f, latent.data());
+
+    const int count = user_counts_[user_idx];
+    bernoulli_distribution in_cluster(config_.cluster_affinity);
+    normal_distribution<double> noise(0.0, 0.75);
+    long timestamp = uniform_int_distribution<long>(1000000000L, 1400000000L)(rng);
+
+    unordered_set<int> seen;
+    seen.reserve(count * 2);
+    vector<Rating> ratings;
+    ratings.reserve(count);
+    for (long long attempts = 0; static_cast<int>(ratings.size()) < count && attempts < 20LL * count; ++attempts) {
+        int item = in_cluster(rng) ? cluster_samplers_[cluster].sample(rng) : global_sampler_.sample(rng);
+        if (!seen.insert(item).second) continue;
+        const float* item_vec = &item_latent_[static_cast<size_t>(item) * L];
+        double cosine = 0.0;
+        for (int k = 0; k < L; ++k) cosine += latent[k] * item_vec[k];
+        // Escala de MovieLens: 0.5 a 5 en pasos de 0.5.
+        double value = round(2.0 * (3.0 + 2.0 * cosine + noise(rng))) / 2.0;
+        value = clamp(value, 0.5, 5.0);
+        timestamp += uniform_int_distribution<long>(1, 3600)(rng);
+        ratings.push_back({user_idx + 1, item + 1, value, timestamp});
+    }
+    return ratings;
+}
+
+// Formatea los ratings de un usuario como líneas "userId,movieId,rating,timestamp".
+void append_csv(const vector<Rating>& ratings, string& out) {
+    auto append_int = [&out](long long value, char separator) {
+        char buffer[24];
+        out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+        out.push_back(separator);
+    };
+    for (const auto& r : ratings) {
+        append_int(r.user_id, ',');
+        append_int(r.movie_id, ',');
+        int halves = static_cast<int>(r.rating * 2.0);
+        append_int(halves / 2, '.');
+        out.push_back((halves % 2) ? '5' : '0');
+        out.push_back(',');
+        append_int(r.timestamp, '\n');
+    }
+}
+
+int main(int argc, char* argv[]) {
+    SyntheticConfig config;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        auto value = [&](const string& flag) { return arg.substr(flag.size()); };
+        if (arg.rfind("--num_users=", 0) == 0) config.num_users = stoi(value("--num_users="));
+        else if (arg.rfind("--num_items=", 0) == 0) config.num_items = stoi(value("--num_items="));
+        else if (arg.rfind("--num_ratings=", 0) == 0) config.num_ratings = stoll(value("--num_ratings="));
+        else if (arg.rfind("--clusters=", 0) == 0) config.clusters = stoi(value("--clusters="));
+        else if (arg.rfind("--alpha=", 0) == 0) config.alpha = stod(value("--alpha="));
+        else if (arg.rfind("--user_alpha=", 0) == 0) config.user_alpha = stod(value("--user_alpha="));
+        else if (arg.rfind("--cluster_affinity=", 0) == 0) config.cluster_affinity = stod(value("--cluster_affinity="));
+        else if (arg.rfind("--min_user_ratings=", 0) == 0) config.min_user_ratings = stoi(value("--min_user_ratings="));
+        else if (arg.rfind("--latent_dim=", 0) == 0) config.latent_dim = stoi(value("--latent_dim="));
+        else if (arg.rfind("--seed=", 0) == 0) config.seed = stoull(value("--seed="));
+        else if (arg.rfind("--out=", 0) == 0) config.out = value("--out=");
+        else if (arg.rfind("--max_ratings=", 0) == 0) config.max_ratings = stoi(value("--max_ratings="));
+        else if (arg.rfind("--max_triplets_per_user=", 0) == 0) {
+            config.max_triplets_per_user.clear();
+            stringstream ss(value("--max_triplets_per_user="));
+            string cell;
+            while (getline(ss, cell, ',')) config.max_triplets_per_user.push_back(stoi(cell));
+        } else if (arg == "--no_cache") config.write_cache = false;
+        else {
+            cerr << "Argumento desconocido: " << arg << endl;
+            return 1;
+        }
+    }
+    if (config.num_users <= 0 || config.num_items <= 1 || config.clusters <= 0 || config.latent_dim <= 0) {
+        cerr << "Error: num_users, num_items, clusters y latent_dim deben ser positivos." << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    cout << "--- Generando conjunto sintetico ---" << endl;
+    SyntheticDataset dataset(config);
+    cout << config.num_users << " usuarios, " << config.num_items << " items, " << config.clusters
+         << " clusters, ~" << dataset.expected_ratings() << " ratings." << endl;
+
+    ofstream csv(config.out, ios::binary);
+    if (!csv.is_open()) {
+        cerr << "Error: No se pudo crear " << config.out << endl;
+        return 1;
+    }
+    csv << "userId,movieId,rating,timestamp\n";
+    // Un orden de items de una versión anterior de este archivo ya no aplica.
+    error_code ignored;
+    filesystem::remove(item_order_path(config.out), ignored);
+
+    vector<unique_ptr<DataCacheWriter>> writers;
+    if (config.write_cache) {
+        for (int max_triplets : config.max_triplets_per_user) {
+            writers.push_back(make_unique<DataCacheWriter>(
+                preprocessed_cache_path(config.out, config.max_ratings, max_triplets), config.max_ratings, max_triplets));
+        }
+    }
+
+    // Bloques de usuarios: se generan en paralelo y se escriben en orden, que es
+    // el orden que necesitan el CSV y los caches.
+    const int block_size = 4096;
+    long long total_ratings = 0;
+    vector<vector<Rating>> block_ratings(block_size);
+    vector<string> block_text(block_size);
+    for (int block_start = 0; block_start < config.num_users; block_start += block_size) {
+        int block_end = min(config.num_users, block_start + block_size);
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (int u = block_start; u < block_end; ++u) {
+            block_ratings[u - block_start] = dataset.user_ratings(u);
+            block_text[u - block_start].clear();
+            append_csv(block_ratings[u - block_start], block_text[u - block_start]);
+        }
+        for (int u = block_start; u < block_end; ++u) {
+            const auto& ratings = block_ratings[u - block_start];
+            csv.write(block_text[u - block_start].data(), block_text[u - block_start].size());
+            total_ratings += ratings.size();
+            for (auto& writer : writers) writer->add_user(u + 1, ratings);
+        }
+        if ((block_end / block_size) % 25 == 0 || block_end == config.num_users) {
+            cout << "Usuarios generados: " << block_end << "/" << config.num_users << endl;
+        }
+    }
+    csv.close();
+    cout << "Se escribieron " << total_ratings << " ratings en " << config.out << endl;
+
+    for (auto& writer : writers) {
+        if (!writer->finish()) return 1;
+    }
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout << "--- Conjunto sintetico listo en " << elapsed.count() << " s ---" << endl;
+    cout << "Uso: ./SRPR_LSH --ratings=" << config.out;
+    if (config.max_ratings != -1) cout << " --max_ratings=" << config.max_ratings;
+    cout << endl;
+    return 0;
+}
@@ -13,16 +13,14 @@
 #include "src/lsh.h"
 #include "src/MetricsCalculator.h"
 
-int main() {
+int main(int argc, char* argv[]) {
     // === 0. Configuración ===
-    const string RATING_FILE = "../data/ratings.csv"; // Ruta al archivo de ratings
+    // Ruta al archivo de ratings; se puede cambiar con --ratings=<archivo.csv>
+    const DatasetOptions DATASET = parse_dataset_options(argc, argv, {"../data/ratings.csv", 20000000});
 
-    const int MAX_RATINGS = 20000000;
 
-    const std::string BPR_VECTORS_FILE = "../data/bpr_vectors.txt";
-    const std::string SRPR_VECTORS_FILE = "../data/srpr_vectors.txt";
     // === 1. Carga de Datos ===
-    DataManager data_manager(RATING_FILE, MAX_RATINGS, 200);
+    DataManager data_manager(DATASET.ratings_path, DATASET.max_ratings, 200);
     data_manager.init(); // Esta función maneja la lógica de caché automáticamente
     if (data_manager.get_training_triplets().empty()) return 1;
 
@@ -0,0 +1,160 @@
+// Entrenamiento incremental a partir de un log de ratings de solo-agregar.
+//
+// Uso: ./incrementalTrain [--log=<archivo.csv>] [--epochs=<n>] [--replay=<x>]
+//                         [--max_triplets_per_user=<n>]
+//                         [--ratings=<archivo.csv>] [--max_ratings=<n>]
+//
+// Lee solo los ratings agregados al log (por defecto el mismo archivo de
+// ratings) desde el último punto de control, regenera las tripletas de los
+// usuarios tocados (DataManager::add_ratings) y corre --epochs pasadas de SGD
+// sobre ellas, partiendo de los vectores guardados de BPR y SRPR. Cada pasada
+// mezcla además --replay tripletas viejas por cada nueva para que los items
+// no se desplacen solo hacia los usuarios recientes. El costo es proporcional
+// al lote, no al conjunto completo.
+//
+// Al terminar prepara los vectores nuevos y el cache del DataManager junto a
+// los actuales, confirma la versión guardando el punto de control y recién
+// entonces los renombra a su lugar. El App con --watch recarga el cache junto
+// con los vectores, así que sirve también los usuarios e items nuevos. Si algo
+// falla antes de confirmar, la próxima corrida repite el mismo lote sobre los
+// archivos viejos; si falla después, la próxima termina los renombres.
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/DataManager.h"
+#include "src/MatrixFactorization.h"
+#include "src/RatingsLog.h"
+#include "src/SRPRModel.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    const DatasetOptions DATASET = parse_dataset_options(argc, argv, {"../data/ratings.csv", 22000000});
+    const int D = 32;
+    const int LSH_HASH_SIZE = 8;
+    const string PREFIX = dataset_prefix(DATASET.ratings_path);
+    const string BPR_VECTORS_FILE = "../data/" + PREFIX + "bpr_vectors.txt";
+    const string SRPR_VECTORS_FILE = "../data/" + PREFIX + "srpr_vectors.txt";
+    const string STATE_FILE = incremental_state_path(DATASET.ratings_path);
+
+    string log_path = DATASET.ratings_path;
+    int epochs = 2;
+    double replay = 1.0;
+    int max_triplets_per_user = 300;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--log=", 0) == 0) log_path = arg.substr(6);
+        else if (arg.rfind("--epochs=", 0) == 0) epochs = stoi(arg.substr(9));
+        else if (arg.rfind("--replay=", 0) == 0) replay = stod(arg.substr(9));
+        else if (arg.rfind("--max_triplets_per_user=", 0) == 0) max_triplets_per_user = stoi(arg.substr(24));
+        else if (arg.rfind("--ratings=", 0) != 0 && arg.rfind("--max_ratings=", 0) != 0) {
+            cerr << "Argumento desconocido: " << arg << endl;
+            return 1;
+        }
+    }
+    if (epochs < 1 || replay < 0.0) {
+        cerr << "Error: --epochs debe ser >= 1 y --replay >= 0." << endl;
+        return 1;
+    }
+    const string CACHE_FILE = preprocessed_cache_path(DATASET.ratings_path, DATASET.max_ratings, max_triplets_per_user);
+    // El cache se publica antes que los vectores: cuando el App (--watch) ve
+    // ambos vectores nuevos, el cache que relee ya es el de esa versión.
+    const vector<string> VERSION_FILES = {CACHE_FILE, BPR_VECTORS_FILE, SRPR_VECTORS_FILE};
+
+    // === 1. Punto de control ===
+    // Sin estado previo, el log empieza donde terminó lo que leyó el
+    // preprocesamiento (todo el archivo si el log es otro).
+    IncrementalState state;
+    if (!load_incremental_state(STATE_FILE, state)) {
+        state.log_offset = log_path == DATASET.ratings_path ? csv_offset_after_rows(log_path, DATASET.max_ratings) : 0;
+        cout << "Sin estado incremental previo; el log " << log_path << " se lee desde el byte " << state.log_offset
+             << "." << endl;
+        // Se fija ya: si se calculara de nuevo en la próxima corrida, lo que se
+        // agregue mientras tanto quedaría antes del punto de partida.
+        if (!save_incremental_state(STATE_FILE, state)) return 1;
+    }
+    // Una corrida anterior pudo cortarse entre confirmar y renombrar.
+    if (!publish_incremental_version(VERSION_FILES, state.version)) return 1;
+
+    auto start = chrono::steady_clock::now();
+    vector<Rating> new_ratings;
+    uint64_t next_offset = read_appended_ratings(log_path, state.log_offset, new_ratings);
+    if (new_ratings.empty()) {
+        cout << "No hay ratings nuevos en " << log_path << " (version " << state.version << ")." << endl;
+        return 0;
+    }
+    cout << "Ratings nuevos: " << new_ratings.size() << " (bytes " << state.log_offset << " - " << next_offset << ")."
+         << endl;
+
+    // === 2. Datos y modelos actuales ===
+    DataManager data_manager(DATASET.ratings_path, DATASET.max_ratings, max_triplets_per_user);
+    data_manager.init();
+    if (data_manager.get_training_triplets().empty()) return 1;
+    MatrixFactorization bpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
+    SRPRModel srpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
+    const uint64_t old_catalog = data_manager.catalog_fingerprint();
+    if (!bpr_model.load_vectors(BPR_VECTORS_FILE, old_catalog) || !srpr_model.load_vectors(SRPR_VECTORS_FILE, old_catalog)) {
+        cerr << "Error: faltan los vectores de BPR o SRPR para " << DATASET.ratings_path
+             << ". Entrena los modelos completos primero (p. ej. con SRPR_LSH)." << endl;
+        return 1;
+    }
+    const int old_users = data_manager.get_num_users();
+    const int old_items = data_manager.get_num_items();
+
+    // === 3. Tripletas de los usuarios tocados más repaso ===
+    vector<int> touched = data_manager.add_ratings(new_ratings);
+    bpr_model.grow(data_manager.get_num_users(), data_manager.get_num_items());
+    srpr_model.grow(data_manager.get_num_users(), data_manager.get_num_items());
+
+    const auto& all_triplets = data_manager.get_training_triplets();
+    vector<char> is_touched(data_manager.get_num_users(), 0);
+    for (int user_idx : touched) is_touched[user_idx] = 1;
+    vector<Triplet> batch, old_triplets;
+    for (const auto& triplet : all_triplets) {
+        (is_touched[triplet.user_id] ? batch : old_triplets).push_back(triplet);
+    }
+    const size_t new_count = batch.size();
+    mt19937 rng(42 + state.version);
+    size_t replay_count = min(old_triplets.size(), static_cast<size_t>(replay * new_count));
+    for (size_t i = 0; i < replay_count; ++i) {
+        // Muestreo sin reemplazo parcial (Fisher-Yates hasta replay_count).
+        uniform_int_distribution<size_t> pick(i, old_triplets.size() - 1);
+        swap(old_triplets[i], old_triplets[pick(rng)]);
+        batch.push_back(old_triplets[i]);
+    }
+    shuffle(batch.begin(), batch.end(), rng);
+    cout << "Usuarios tocados: " << touched.size() << " (" << data_manager.get_num_users() - old_users
+         << " nuevos), items nuevos: " << data_manager.get_num_items() - old_items << ", tripletas: " << new_count
+         << " nuevas + " << replay_count << " de repaso." << endl;
+
+    // === 4. SGD acotado desde los vectores actuales ===
+    // Mismos hiperparámetros que el entrenamiento del App.
+    cout << "\n--- BPR incremental ---" << endl;
+    bpr_model.train(batch, epochs, 0.02, 0.01);
+    cout << "\n--- SRPR incremental ---" << endl;
+    srpr_model.train(batch, LSH_HASH_SIZE, 0.05, 0.001, epochs);
+
+    // === 5. Nueva versión: preparar, confirmar y publicar ===
+    const uint64_t version = state.version + 1;
+    const uint64_t catalog = data_manager.catalog_fingerprint();
+    if (!bpr_model.save_vectors(incremental_staged_path(BPR_VECTORS_FILE, version), catalog) ||
+        !srpr_model.save_vectors(incremental_staged_path(SRPR_VECTORS_FILE, version), catalog) ||
+        !data_manager.save_cache(incremental_staged_path(CACHE_FILE, version))) {
+        return 1;
+    }
+    state.log_offset = next_offset;
+    state.version = version;
+    state.ratings_seen += new_ratings.size();
+    if (!save_incremental_state(STATE_FILE, state)) return 1;
+    if (!publish_incremental_version(VERSION_FILES, state.version)) return 1;
+
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    cout << "\n--- Version incremental " << state.version << " emitida en " << fixed << setprecision(1)
+         << elapsed.count() << " ms ---" << endl;
+    return 0;
+}
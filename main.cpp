@@ -17,7 +17,7 @@ using Secs = std::chrono::seconds;
 using namespace std;
 
 // similitud del coseno
-double calculate_cosine_similarity(const Vec& vec1, const Vec& vec2) {
+double calculate_cosine_similarity(ConstVecView vec1, ConstVecView vec2) {
     if (vec1.getDimension() == 0 || vec2.getDimension() == 0) return 0.0;
     double dot_product = dot(vec1, vec2);
     double magnitude_product = vec1.magnitude() * vec2.magnitude();
@@ -27,7 +27,7 @@ double calculate_cosine_similarity(const Vec& vec1, const Vec& vec2) {
 
 // Vector de resultados de fuerza bruta
 template<typename T>
-vector<pair<int, double>> get_brute_force_vec(const Vec& user_vec, const T& model, const DataManager& dm, int top_k) {
+vector<pair<int, double>> get_brute_force_vec(ConstVecView user_vec, const T& model, const DataManager& dm, int top_k) {
     vector<pair<double, int>> all_scores;
     for (int i = 0; i < dm.get_num_items(); ++i) {
         double score = calculate_cosine_similarity(user_vec, model.get_item_vector(i));
@@ -53,50 +53,71 @@ void print_recommendation_list(const string& title, const vector<pair<int, doubl
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
 
     // === 0. Configuración ===
-    const string RATING_FILE = "../data/ratings.csv"; // Ruta al archivo de ratings
+    // Ruta al archivo de ratings; se puede cambiar con --ratings=<archivo.csv>
+    const DatasetOptions DATASET = parse_dataset_options(argc, argv, {"../data/ratings.csv", 22000000});
 
-    const int MAX_RATINGS = 22000000;
     const int D = 32;
     const int TOP_K = 10;
     const int LSH_TABLES = 12;
     const int LSH_HASH_SIZE = 6;
-    const string BPR_VECTORS_FILE = "../data/bpr_vectors.txt";
-    const string SRPR_VECTORS_FILE = "../data/srpr_vectors.txt";
+    const string DATASET_PREFIX = dataset_prefix(DATASET.ratings_path);
+    const string BPR_VECTORS_FILE = "../data/" + DATASET_PREFIX + "bpr_vectors.txt";
+    const string SRPR_VECTORS_FILE = "../data/" + DATASET_PREFIX + "srpr_vectors.txt";
     const double MAX_RATING_VALUE = 5.0;
+    // Puntos de control del entrenamiento: --checkpoint_every, --checkpoint_triplets, --resume
+    const CheckpointOptions BPR_CHECKPOINT = parse_checkpoint_options(argc, argv, DATASET_PREFIX, "bpr");
+    const CheckpointOptions SRPR_CHECKPOINT = parse_checkpoint_options(argc, argv, DATASET_PREFIX, "srpr");
+    // Con --holdout las épocas son un máximo: se corta cuando nDCG@k deja de mejorar
+    const HoldoutOptions HOLDOUT = parse_holdout_options(argc, argv);
+    // SRPR usa las aproximaciones de fastmath.h; --exact_math entrena con libm y
+    // --check_fast_math solo imprime su error contra libm
+    bool exact_math = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--exact_math") exact_math = true;
+        else if (arg == "--check_fast_math") return print_fast_math_accuracy() ? 0 : 1;
+    }
 
     // === 1. Carga de Datos ===
-    DataManager data_manager(RATING_FILE, MAX_RATINGS, 300);
+    DataManager data_manager(DATASET.ratings_path, DATASET.max_ratings, 300);
     data_manager.init(); 
 
     if (data_manager.get_training_triplets().empty()) {
         return 1;
     }
+    const uint64_t CATALOG_FINGERPRINT = data_manager.catalog_fingerprint();
     
     // === 2. Entrenar Modelo Base (BPR) ===
     auto triplets = data_manager.get_training_triplets();
+    HoldoutSet holdout_set;
+    if (HOLDOUT.enabled) holdout_set = HoldoutSet::split(data_manager, HOLDOUT, triplets);
     cout << "first tripet: " << triplets[0].user_id << " " << triplets[0].preferred_item_id << " " << triplets[0].less_preferred_item_id << endl;
 
     cout << "\n--- ENTRENANDO MODELO BASE (BPR) ---" << endl;
     MatrixFactorization bpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
 
-    if (!bpr_model.load_vectors(BPR_VECTORS_FILE)) {
+    if (!bpr_model.load_vectors(BPR_VECTORS_FILE, CATALOG_FINGERPRINT)) {
         cout << "\n--- ENTRENANDO MODELO BASE (BPR) ---" << endl;
-        bpr_model.train(triplets, 30, 0.03, 0.01);
-        bpr_model.save_vectors(BPR_VECTORS_FILE);
+        unique_ptr<HoldoutEvaluator> holdout;
+        if (HOLDOUT.enabled) holdout = make_unique<HoldoutEvaluator>(holdout_set, HOLDOUT, "BPR");
+        bpr_model.train(triplets, 30, 0.03, 0.01, &BPR_CHECKPOINT, holdout.get());
+        bpr_model.save_vectors(BPR_VECTORS_FILE, CATALOG_FINGERPRINT);
     }
 
     // === 3. Entrenar Modelo Avanzado (SRPR) ===
-    triplets = data_manager.get_training_triplets();
 
     cout << "\n--- ENTRENANDO MODELO AVANZADO (SRPR) ---" << endl;
     SRPRModel srpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
-    if(!srpr_model.load_vectors(SRPR_VECTORS_FILE)) {
+    srpr_model.set_exact_math(exact_math);
+    if(!srpr_model.load_vectors(SRPR_VECTORS_FILE, CATALOG_FINGERPRINT)) {
         cout << "\n--- ENTRENANDO MODELO AVANZADO (SRPR) ---" << endl;
-        srpr_model.train(triplets, 8, 0.03, 0.001, 30);
-        srpr_model.save_vectors(SRPR_VECTORS_FILE);
+        unique_ptr<HoldoutEvaluator> holdout;
+        if (HOLDOUT.enabled) holdout = make_unique<HoldoutEvaluator>(holdout_set, HOLDOUT, "SRPR");
+        srpr_model.train(triplets, 8, 0.03, 0.001, 30, &SRPR_CHECKPOINT, holdout.get());
+        srpr_model.save_vectors(SRPR_VECTORS_FILE, CATALOG_FINGERPRINT);
     }
 
     // === 4. Evaluación Cuantitativa y Demostración ===
@@ -112,16 +133,16 @@ int main() {
     // Pre-construimos los índices LSH una sola vez para eficiencia
     SignedRandomProjectionLSH lsh_bpr(LSH_TABLES, LSH_HASH_SIZE, D);
     LSHIndex lsh_index_bpr(lsh_bpr);
-    for (int i = 0; i < bpr_model.get_num_items(); ++i) lsh_index_bpr.add(i, bpr_model.get_item_vector(i));
+    lsh_index_bpr.build_or_load(bpr_model.get_item_vectors(), lsh_index_path(DATASET_PREFIX + "bpr", LSH_TABLES, LSH_HASH_SIZE));
 
     SignedRandomProjectionLSH lsh_srpr(LSH_TABLES, LSH_HASH_SIZE, D);
     LSHIndex lsh_index_srpr(lsh_srpr);
-    for (int i = 0; i < srpr_model.get_num_items(); ++i) lsh_index_srpr.add(i, srpr_model.get_item_vector(i));
+    lsh_index_srpr.build_or_load(srpr_model.get_item_vectors(), lsh_index_path(DATASET_PREFIX + "srpr", LSH_TABLES, LSH_HASH_SIZE));
 
     // Iteramos sobre los usuarios de prueba para acumular métricas
     for (int user_idx = 0; user_idx < min(num_test_users, srpr_model.get_num_users()); ++user_idx) {
         // --- Sistema BPR ---
-        const Vec& bpr_user_vec = bpr_model.get_user_vector(user_idx);
+        ConstVecView bpr_user_vec = bpr_model.get_user_vector(user_idx);
         auto time_start_brute = chrono::high_resolution_clock::now();
         auto bpr_ground_truth = get_brute_force_vec(bpr_user_vec, bpr_model, data_manager, TOP_K);
         auto time_end_brute = chrono::high_resolution_clock::now();
@@ -137,7 +158,7 @@ int main() {
         bpr_metrics_calculator.add_query_result_for_nrecall(user_idx, data_manager, bpr_lsh_results, MAX_RATING_VALUE, lsh_time_bpr.count());
 
         // --- Sistema SRPR ---
-        const Vec& srpr_user_vec = srpr_model.get_user_vector(user_idx);
+        ConstVecView srpr_user_vec = srpr_model.get_user_vector(user_idx);
 
         auto time_start_brute_srpr = chrono::high_resolution_clock::now();
         auto srpr_ground_truth = get_brute_force_vec(srpr_user_vec, srpr_model, data_manager, TOP_K);
@@ -0,0 +1,133 @@
+// Reordena los items de un conjunto de datos para mejorar la localidad de las
+// consultas LSH.
+//
+// Uso: ./reorderItems [--by=srpr|bpr] [--bits=<n>] [--max_triplets_per_user=<n>]
+//                     [--ratings=<archivo.csv>] [--max_ratings=<n>]
+//
+// Los índices internos de los items salen del orden en que aparecen en las
+// tripletas, que no tiene relación con sus embeddings: los candidatos de un
+// bucket quedan repartidos por toda la matriz de items. Este programa calcula
+// un orden por el código SRP de la primera tabla (ver srp_item_order) sobre
+// los vectores del modelo --by y lo aplica de forma consistente a:
+//   - el cache del DataManager (mapeos, tripletas y ratings) y el archivo
+//     item_order.bin, que se aplica también a los caches de otros parámetros
+//     la próxima vez que se carguen;
+//   - los vectores guardados de BPR y SRPR (los que existan), con la huella
+//     del catálogo reordenado. Si la corrida se corta entre el cache y los
+//     vectores, la huella deja de coincidir y la próxima carga los rechaza.
+// Los índices LSH y las verdades de referencia persistidos se reconstruyen
+// solos porque su huella de embeddings deja de coincidir.
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "src/DataManager.h"
+#include "src/MatrixFactorization.h"
+#include "src/SRPRModel.h"
+#include "src/lsh.h"
+
+using namespace std;
+
+// Dispersión media de los buckets de un índice (tablas x bits) sobre estos
+// items: (id máximo - id mínimo + 1) / tamaño, promediado por item. 1 significa
+// que cada bucket ocupa un rango contiguo de la matriz.
+pair<double, double> bucket_spread(const EmbeddingMatrix& items, int num_tables, int hash_size) {
+    const int D = static_cast<int>(items.dimension());
+    SignedRandomProjectionLSH lsh(num_tables, hash_size, D);
+    vector<uint64_t> codes;
+    lsh.hash_codes(items.data(), items.size(), codes);
+
+    double first_table = 0.0, all_tables = 0.0;
+    for (int t = 0; t < num_tables; ++t) {
+        map<uint64_t, pair<int, int>> ranges; // código -> (mínimo, máximo)
+        for (size_t i = 0; i < items.size(); ++i) {
+            uint64_t code = codes[static_cast<size_t>(t) * items.size() + i];
+            auto it = ranges.find(code);
+            if (it == ranges.end()) ranges[code] = {static_cast<int>(i), static_cast<int>(i)};
+            else it->second.second = static_cast<int>(i);
+        }
+        double spread = 0.0;
+        for (const auto& [code, range] : ranges) spread += static_cast<double>(range.second - range.first + 1);
+        spread /= items.size();
+        if (t == 0) first_table = spread;
+        all_tables += spread / num_tables;
+    }
+    return {first_table, all_tables};
+}
+
+int main(int argc, char* argv[]) {
+    const DatasetOptions DATASET = parse_dataset_options(argc, argv, {"../data/ratings.csv", 22000000});
+    const int D = 32;
+    const int LSH_TABLES = 12;
+    const int LSH_HASH_SIZE = 8;
+    const string PREFIX = dataset_prefix(DATASET.ratings_path);
+    const string BPR_VECTORS_FILE = "../data/" + PREFIX + "bpr_vectors.txt";
+    const string SRPR_VECTORS_FILE = "../data/" + PREFIX + "srpr_vectors.txt";
+
+    string by = "srpr";
+    int bits = 32;
+    int max_triplets_per_user = 300;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--by=", 0) == 0) by = arg.substr(5);
+        else if (arg.rfind("--bits=", 0) == 0) bits = stoi(arg.substr(7));
+        else if (arg.rfind("--max_triplets_per_user=", 0) == 0) max_triplets_per_user = stoi(arg.substr(24));
+        else if (arg.rfind("--ratings=", 0) != 0 && arg.rfind("--max_ratings=", 0) != 0) {
+            cerr << "Argumento desconocido: " << arg << endl;
+            return 1;
+        }
+    }
+    if (by != "srpr" && by != "bpr") {
+        cerr << "Error: --by debe ser srpr o bpr." << endl;
+        return 1;
+    }
+    if (bits < 1 || bits > 64) {
+        cerr << "Error: --bits debe estar entre 1 y 64." << endl;
+        return 1;
+    }
+
+    DataManager data_manager(DATASET.ratings_path, DATASET.max_ratings, max_triplets_per_user);
+    data_manager.init();
+    if (data_manager.get_training_triplets().empty()) return 1;
+
+    MatrixFactorization bpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
+    SRPRModel srpr_model(data_manager.get_num_users(), data_manager.get_num_items(), D);
+    // La huella del catálogo en los vectores detecta una corrida anterior
+    // cortada entre el cache y los vectores: no se reordena sobre vectores de
+    // otro orden.
+    const uint64_t catalog = data_manager.catalog_fingerprint();
+    bool has_bpr = bpr_model.load_vectors(BPR_VECTORS_FILE, catalog);
+    bool has_srpr = srpr_model.load_vectors(SRPR_VECTORS_FILE, catalog);
+    if ((by == "srpr" && !has_srpr) || (by == "bpr" && !has_bpr)) {
+        cerr << "Error: no hay vectores " << by << " para " << DATASET.ratings_path
+             << ". Entrena el modelo primero (p. ej. con SRPR_LSH)." << endl;
+        return 1;
+    }
+    const EmbeddingMatrix& reference_items = by == "srpr" ? srpr_model.get_item_vectors() : bpr_model.get_item_vectors();
+
+    auto before = bucket_spread(reference_items, LSH_TABLES, LSH_HASH_SIZE);
+    vector<int> order = srp_item_order(reference_items, bits);
+    data_manager.reorder_items(order);
+    const uint64_t reordered_catalog = data_manager.catalog_fingerprint();
+    if (has_bpr) {
+        bpr_model.permute_items(order);
+        bpr_model.save_vectors(BPR_VECTORS_FILE, reordered_catalog);
+    }
+    if (has_srpr) {
+        srpr_model.permute_items(order);
+        srpr_model.save_vectors(SRPR_VECTORS_FILE, reordered_catalog);
+    }
+    auto after = bucket_spread(reference_items, LSH_TABLES, LSH_HASH_SIZE);
+
+    cout << "\n--- Items reordenados por SRP (" << by << ", " << bits << " bits) ---" << endl;
+    cout << "Orden guardado en: " << item_order_path(DATASET.ratings_path) << endl;
+    cout << fixed << setprecision(2);
+    cout << "Dispersion de los buckets (" << LSH_TABLES << "x" << LSH_HASH_SIZE
+         << ", rango de ids / tamano; 1 = contiguo):" << endl;
+    cout << "  Tabla 0:          " << before.first << " -> " << after.first << endl;
+    cout << "  Media de tablas:  " << before.second << " -> " << after.second << endl;
+    return 0;
+}
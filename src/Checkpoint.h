@@ -0,0 +1,301 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Triplet.h"
+#include "matrix.h"
+#include "vec.h"
+
+using namespace std;
+
+// Puntos de control del entrenamiento (BPR y SRPR): cada N épocas o cada M
+// tripletas se copia el estado completo del SGD y un hilo en segundo plano lo
+// escribe en binario, así el entrenamiento no se detiene a escribir. Con
+// resume, train() retoma desde la tripleta siguiente y termina con los mismos
+// vectores, bit a bit, que una corrida sin cortes.
+//
+// El SGD de ambos modelos recorre las tripletas en orden fijo y sin momento,
+// así que el estado es: vectores, época, posición dentro de la época y el
+// acumulado de la pérdida de la época (solo para el reporte). No hay estado de
+// RNG ni del optimizador que guardar; si se agregan, van en una versión nueva
+// del formato.
+struct CheckpointOptions {
+    string path;                 // vacío: sin puntos de control
+    int every_epochs = 1;        // 0: no por épocas
+    uint64_t every_triplets = 0; // 0: no por tripletas
+    bool resume = false;
+};
+
+// --checkpoint_every=<épocas> --checkpoint_triplets=<n> --resume. El archivo
+// es ../data/<prefijo><model_name>.ckpt; --checkpoint_every=0 sin
+// --checkpoint_triplets los desactiva.
+inline CheckpointOptions parse_checkpoint_options(int argc, char* argv[], const string& prefix,
+                                                  const string& model_name) {
+    CheckpointOptions options;
+    options.path = "../data/" + prefix + model_name + ".ckpt";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--checkpoint_every=", 0) == 0) options.every_epochs = stoi(arg.substr(19));
+        else if (arg.rfind("--checkpoint_triplets=", 0) == 0) options.every_triplets = stoull(arg.substr(22));
+        else if (arg == "--resume") options.resume = true;
+    }
+    if (options.every_epochs <= 0 && options.every_triplets == 0 && !options.resume) options.path.clear();
+    return options;
+}
+
+// Lo que identifica un entrenamiento: un punto de control solo se retoma con
+// los mismos datos e hiperparámetros. epochs no entra, así que se puede
+// retomar pidiendo más épocas que las originales.
+struct TrainingSetup {
+    uint32_t model = 0;  // 0 BPR, 1 SRPR
+    uint32_t dimensions = 0;
+    uint64_t num_users = 0;
+    uint64_t num_items = 0;
+    uint64_t num_triplets = 0;
+    uint64_t triplets_fingerprint = 0;
+    double learning_rate = 0.0;
+    double lambda = 0.0;
+    int64_t b = 0;  // bits de SRPR; 0 en BPR
+    int64_t exact_math = 0;  // SRPR con libm en vez de fastmath.h
+
+    bool operator==(const TrainingSetup&) const = default;
+};
+
+// FNV-1a sobre las tripletas en orden: el orden también determina el resultado.
+inline uint64_t triplets_fingerprint(const vector<Triplet>& triplets) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const auto& triplet : triplets) {
+        const int values[3] = {triplet.user_id, triplet.preferred_item_id, triplet.less_preferred_item_id};
+        for (int value : values) {
+            hash ^= static_cast<uint32_t>(value);
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+// Dónde va el SGD: la próxima tripleta a procesar es triplets[position] de la
+// época epoch (base 1); epoch_loss es lo acumulado de esa época hasta ahí.
+struct TrainingCursor {
+    int64_t epoch = 1;
+    uint64_t position = 0;
+    double epoch_loss = 0.0;
+};
+
+struct TrainingCheckpoint {
+    TrainingSetup setup;
+    TrainingCursor cursor;
+    vector<double> user_values;  // num_users * dimensions, fila por usuario
+    vector<double> item_values;
+};
+
+constexpr char CHECKPOINT_MAGIC[8] = {'S', 'R', 'P', 'R', 'C', 'K', 'P', 'T'};
+constexpr uint32_t CHECKPOINT_FORMAT_VERSION = 2;
+
+// La matriz ya está en el orden del archivo: una sola copia en cada sentido.
+inline vector<double> flatten_vectors(const EmbeddingMatrix& vectors) {
+    return vector<double>(vectors.data(), vectors.data() + vectors.size() * vectors.dimension());
+}
+
+inline void unflatten_vectors(const vector<double>& values, EmbeddingMatrix& vectors) {
+    memcpy(vectors.data(), values.data(), vectors.size() * vectors.dimension() * sizeof(double));
+}
+
+// Se escribe a un temporal y se renombra: un corte a mitad de escritura deja
+// el punto de control anterior.
+inline bool save_checkpoint(const string& filepath, const TrainingCheckpoint& checkpoint) {
+    const string tmp_path = filepath + ".tmp";
+    {
+        ofstream out_file(tmp_path, ios::binary);
+        if (!out_file.is_open()) {
+            cerr << "Error: No se pudo abrir el archivo para guardar el punto de control: " << tmp_path << endl;
+            return false;
+        }
+        out_file.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        out_file.write(reinterpret_cast<const char*>(&CHECKPOINT_FORMAT_VERSION), sizeof(uint32_t));
+        out_file.write(reinterpret_cast<const char*>(&checkpoint.setup), sizeof(TrainingSetup));
+        out_file.write(reinterpret_cast<const char*>(&checkpoint.cursor), sizeof(TrainingCursor));
+        out_file.write(reinterpret_cast<const char*>(checkpoint.user_values.data()),
+                       checkpoint.user_values.size() * sizeof(double));
+        out_file.write(reinterpret_cast<const char*>(checkpoint.item_values.data()),
+                       checkpoint.item_values.size() * sizeof(double));
+        if (!out_file) {
+            cerr << "Error: fallo la escritura del punto de control en " << tmp_path << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmp_path, filepath, ec);
+    if (ec) {
+        cerr << "Error: no se pudo reemplazar " << filepath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool load_checkpoint(const string& filepath, TrainingCheckpoint& checkpoint) {
+    ifstream in_file(filepath, ios::binary);
+    if (!in_file.is_open()) return false;
+    char magic[8];
+    uint32_t version = 0;
+    TrainingCheckpoint loaded;
+    if (!in_file.read(magic, sizeof(magic)) || !equal(begin(magic), end(magic), CHECKPOINT_MAGIC) ||
+        !in_file.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != CHECKPOINT_FORMAT_VERSION ||
+        !in_file.read(reinterpret_cast<char*>(&loaded.setup), sizeof(TrainingSetup)) ||
+        !in_file.read(reinterpret_cast<char*>(&loaded.cursor), sizeof(TrainingCursor))) {
+        cerr << "Error: " << filepath << " no es un punto de control valido." << endl;
+        return false;
+    }
+    loaded.user_values.resize(loaded.setup.num_users * loaded.setup.dimensions);
+    loaded.item_values.resize(loaded.setup.num_items * loaded.setup.dimensions);
+    if (!in_file.read(reinterpret_cast<char*>(loaded.user_values.data()),
+                      loaded.user_values.size() * sizeof(double)) ||
+        !in_file.read(reinterpret_cast<char*>(loaded.item_values.data()),
+                      loaded.item_values.size() * sizeof(double))) {
+        cerr << "Error: punto de control truncado: " << filepath << endl;
+        return false;
+    }
+    checkpoint = move(loaded);
+    return true;
+}
+
+// Escritor en segundo plano con una sola ranura: si llega un punto de control
+// mientras se escribe el anterior, el pendiente se reemplaza (solo importa el
+// último). flush() espera a que no quede nada por escribir.
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(string path) : path_(move(path)) {
+        thread_ = jthread([this](stop_token stop) { run(stop); });
+    }
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+    ~CheckpointWriter() {
+        flush();
+        thread_.request_stop();
+    }
+
+    void submit(unique_ptr<TrainingCheckpoint> checkpoint) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            pending_ = move(checkpoint);
+        }
+        wake_.notify_all();
+    }
+
+    void flush() {
+        unique_lock<mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return !pending_ && !writing_; });
+    }
+
+    uint64_t written() const {
+        lock_guard<mutex> lock(mutex_);
+        return written_;
+    }
+
+private:
+    void run(stop_token stop) {
+        while (true) {
+            unique_ptr<TrainingCheckpoint> checkpoint;
+            {
+                unique_lock<mutex> lock(mutex_);
+                wake_.wait(lock, stop, [this] { return pending_ != nullptr; });
+                if (!pending_) break;  // stop pedido sin nada pendiente
+                checkpoint = move(pending_);
+                writing_ = true;
+            }
+            bool ok = save_checkpoint(path_, *checkpoint);
+            {
+                lock_guard<mutex> lock(mutex_);
+                writing_ = false;
+                if (ok) ++written_;
+            }
+            idle_.notify_all();
+        }
+    }
+
+    string path_;
+    mutable mutex mutex_;
+    condition_variable_any wake_;
+    condition_variable idle_;
+    unique_ptr<TrainingCheckpoint> pending_;
+    bool writing_ = false;
+    uint64_t written_ = 0;
+    jthread thread_;
+};
+
+// Lo que usa train(): retoma si corresponde, decide cuándo toca un punto de
+// control y copia los vectores para el escritor. Con options nulo o sin ruta
+// no hace nada.
+class TrainingCheckpointer {
+public:
+    TrainingCheckpointer(const CheckpointOptions* options, const TrainingSetup& setup)
+        : options_(options && !options->path.empty() ? options : nullptr), setup_(setup) {
+        if (options_) writer_ = make_unique<CheckpointWriter>(options_->path);
+    }
+
+    // Con resume, restaura los vectores y devuelve en cursor dónde seguir si
+    // el archivo corresponde a este entrenamiento; si no, se empieza de cero.
+    bool resume(EmbeddingMatrix& user_vectors, EmbeddingMatrix& item_vectors, TrainingCursor& cursor) const {
+        if (!options_ || !options_->resume) return false;
+        TrainingCheckpoint checkpoint;
+        if (!load_checkpoint(options_->path, checkpoint)) {
+            cout << "Sin punto de control en " << options_->path << "; se entrena desde el inicio." << endl;
+            return false;
+        }
+        if (!(checkpoint.setup == setup_)) {
+            cerr << "Error: el punto de control " << options_->path
+                 << " es de otros datos o hiperparametros. Se entrenara desde el inicio." << endl;
+            return false;
+        }
+        unflatten_vectors(checkpoint.user_values, user_vectors);
+        unflatten_vectors(checkpoint.item_values, item_vectors);
+        cursor = checkpoint.cursor;
+        cout << "Retomando desde " << options_->path << ": epoch " << cursor.epoch << ", tripleta "
+             << cursor.position << "." << endl;
+        return true;
+    }
+
+    // Después de procesar una tripleta; cursor ya apunta a la siguiente.
+    void after_triplet(const EmbeddingMatrix& user_vectors, const EmbeddingMatrix& item_vectors,
+                       const TrainingCursor& cursor) {
+        if (!options_ || options_->every_triplets == 0) return;
+        if (++triplets_since_checkpoint_ >= options_->every_triplets) submit(user_vectors, item_vectors, cursor);
+    }
+
+    // Al terminar una época; cursor ya apunta al inicio de la siguiente.
+    void after_epoch(const EmbeddingMatrix& user_vectors, const EmbeddingMatrix& item_vectors,
+                     const TrainingCursor& cursor, bool last_epoch) {
+        if (!options_) return;
+        bool due = options_->every_epochs > 0 && (cursor.epoch - 1) % options_->every_epochs == 0;
+        if (due || last_epoch) submit(user_vectors, item_vectors, cursor);
+        if (last_epoch) writer_->flush();
+    }
+
+private:
+    // La copia se hace en el hilo de entrenamiento (unos milisegundos); la
+    // escritura, que es lo lento, en el del escritor.
+    void submit(const EmbeddingMatrix& user_vectors, const EmbeddingMatrix& item_vectors,
+                const TrainingCursor& cursor) {
+        auto checkpoint = make_unique<TrainingCheckpoint>();
+        checkpoint->setup = setup_;
+        checkpoint->cursor = cursor;
+        checkpoint->user_values = flatten_vectors(user_vectors);
+        checkpoint->item_values = flatten_vectors(item_vectors);
+        writer_->submit(move(checkpoint));
+        triplets_since_checkpoint_ = 0;
+    }
+
+    const CheckpointOptions* options_;
+    TrainingSetup setup_;
+    unique_ptr<CheckpointWriter> writer_;
+    uint64_t triplets_since_checkpoint_ = 0;
+};
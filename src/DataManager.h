@@ -4,10 +4,114 @@
 #include <vector>
 #include <unordered_map>
 #include <fstream>
+#include <filesystem>
+#include <climits>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
 #include "Triplet.h"
 
 using namespace std;
 
+// Prefijo de los archivos derivados de un conjunto de ratings. MovieLens
+// (ratings.csv) conserva los nombres de siempre; cualquier otro archivo antepone
+// su nombre base ("synthetic.csv" -> "synthetic.") para que caches, vectores e
+// índices de distintos conjuntos no se pisen en ../data.
+inline string dataset_prefix(const string& ratings_path) {
+    filesystem::path path(ratings_path);
+    if (path.filename() == "ratings.csv") return "";
+    return path.stem().string() + ".";
+}
+
+inline string preprocessed_cache_path(const string& ratings_path, int max_ratings, int max_triplets_per_user) {
+    return "../data/" + dataset_prefix(ratings_path) + "preprocessed_data." + to_string(max_ratings) + "." +
+           to_string(max_triplets_per_user) + ".cache";
+}
+
+// Orden persistido de los items (lo escribe reorderItems): los ids originales
+// en el orden de sus índices internos. Si existe, DataManager::init lo aplica
+// también a un cache recién generado, así los índices siguen coincidiendo con
+// los vectores guardados.
+inline string item_order_path(const string& ratings_path) {
+    return "../data/" + dataset_prefix(ratings_path) + "item_order.bin";
+}
+
+constexpr char ITEM_ORDER_MAGIC[8] = {'S', 'R', 'P', 'R', 'O', 'R', 'D', 'R'};
+
+// Se escribe a un temporal y se renombra: un corte deja el orden anterior,
+// que DataManager::init vuelve a aplicar al cache.
+inline bool save_item_order(const string& filepath, const vector<int>& original_ids) {
+    const string tmp_path = filepath + ".tmp";
+    {
+        ofstream out_file(tmp_path, ios::binary);
+        if (!out_file.is_open()) {
+            cerr << "Error: No se pudo abrir el archivo para guardar el orden de items: " << tmp_path << endl;
+            return false;
+        }
+        uint64_t count = original_ids.size();
+        out_file.write(ITEM_ORDER_MAGIC, sizeof(ITEM_ORDER_MAGIC));
+        out_file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out_file.write(reinterpret_cast<const char*>(original_ids.data()), count * sizeof(int));
+        if (!out_file) {
+            cerr << "Error: fallo la escritura del orden de items en " << tmp_path << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmp_path, filepath, ec);
+    if (ec) {
+        cerr << "Error: no se pudo reemplazar " << filepath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool load_item_order(const string& filepath, vector<int>& original_ids) {
+    ifstream in_file(filepath, ios::binary);
+    if (!in_file.is_open()) return false;
+    char magic[8];
+    uint64_t count = 0;
+    if (!in_file.read(magic, sizeof(magic)) || !equal(begin(magic), end(magic), ITEM_ORDER_MAGIC) ||
+        !in_file.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+        cerr << "Error: " << filepath << " no es un orden de items valido." << endl;
+        return false;
+    }
+    original_ids.resize(count);
+    if (!in_file.read(reinterpret_cast<char*>(original_ids.data()), count * sizeof(int))) {
+        cerr << "Error: orden de items truncado en " << filepath << endl;
+        return false;
+    }
+    return true;
+}
+
+// Conjunto de ratings con el que corre un ejecutable. Se puede cambiar con
+// --ratings=<archivo.csv> y --max_ratings=<n>; los demás argumentos se ignoran.
+// Un archivo elegido con --ratings se lee completo (max_ratings = -1) salvo que
+// también se indique --max_ratings.
+struct DatasetOptions {
+    string ratings_path;
+    int max_ratings;
+};
+
+inline DatasetOptions parse_dataset_options(int argc, char* argv[], DatasetOptions options) {
+    bool ratings_given = false, max_ratings_given = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--ratings=", 0) == 0) {
+            options.ratings_path = arg.substr(10);
+            ratings_given = true;
+        } else if (arg.rfind("--max_ratings=", 0) == 0) {
+            options.max_ratings = stoi(arg.substr(14));
+            max_ratings_given = true;
+        }
+    }
+    if (ratings_given && !max_ratings_given) options.max_ratings = -1;
+    return options;
+}
+
 class DataManager {
 public:
     DataManager(string ratings_path, int max_ratings, int max_triplets_per_user);
@@ -18,12 +122,45 @@ public:
     int get_num_items() const { return item_to_idx.size(); }
 
     int get_user_idx(int original_user_id) const;
+    int get_item_idx(int original_item_id) const;
     int get_original_item_id(int item_idx) const;
     int get_original_user_id(int user_idx) const;
     double get_rating(int user_idx, int item_idx) const;
 
+    // Huella del orden de usuarios e items (índice interno -> id original). Se
+    // guarda con los vectores de los modelos para detectar al cargarlos que
+    // son de otro catálogo, p. ej. si reorderItems se cortó a mitad de camino.
+    uint64_t catalog_fingerprint() const;
+
+    // Ruta en ../data de un archivo derivado de este conjunto (vectores, índices...).
+    string data_file(const string& name) const { return "../data/" + prefix + name; }
+    const string& get_dataset_prefix() const { return prefix; }
+
+    // Renumera los items (order[nuevo] = viejo) en mapeos, tripletas y ratings,
+    // y reescribe el cache y el orden persistido. Los vectores de los modelos
+    // se permutan aparte con el mismo order (permute_items).
+    void reorder_items(const vector<int>& order);
+
+    // Ratings de un usuario como (item interno, rating), ordenados por item.
+    vector<pair<int, double>> get_user_ratings(int user_idx) const;
+
+    // Incorpora ratings nuevos (ids originales) sin repetir el preprocesamiento:
+    // los ratings de cada usuario tocado se combinan con los que ya tenía (un
+    // rating nuevo reemplaza al viejo del mismo item) y solo sus tripletas se
+    // regeneran. Los usuarios e items nuevos que aparecen en esas tripletas
+    // reciben índices al final, así los vectores existentes siguen valiendo
+    // (los modelos crecen con grow()). Devuelve los índices de los usuarios
+    // cuyas tripletas cambiaron. No reescribe el cache: eso lo hace save_cache().
+    vector<int> add_ratings(const vector<Rating>& ratings);
+
+    void save_cache() const { save_cache(cache_path); }
+    // Escribe el cache en otro archivo (p. ej. uno preparado para renombrar
+    // después); false si la escritura falla.
+    bool save_cache(const string& filepath) const;
+
 private:
     string path;
+    string prefix;
     string cache_path; 
     int max_ratings_to_load;
     int max_triplets_per_user;
@@ -32,7 +169,8 @@ private:
     void load_and_prepare_data();
 
     bool load_cache();
-    void save_cache() const;
+    void apply_item_order(const vector<int>& order);
+    void apply_saved_item_order();
 
     // Mapas para la conversión de IDs
     unordered_map<int, int> user_to_idx;
@@ -47,7 +185,8 @@ private:
 DataManager::DataManager(string ratings_path, int max_ratings, int max_triplets_per_user)
     : path(move(ratings_path)), max_ratings_to_load(max_ratings), max_triplets_per_user(max_triplets_per_user) {
     // Definimos un nombre para nuestro archivo de caché basado en los parámetros
-    cache_path = "../data/preprocessed_data." + to_string(max_ratings) + "." + to_string(max_triplets_per_user) + ".cache";
+    prefix = dataset_prefix(path);
+    cache_path = preprocessed_cache_path(path, max_ratings, max_triplets_per_user);
 }
 
 void DataManager::init() {
@@ -64,6 +203,139 @@ void DataManager::init() {
         cout << "Cache guardado exitosamente." << endl;
         cout << "------------------------------------------" << endl;
     }
+    apply_saved_item_order();
+}
+
+void DataManager::apply_item_order(const vector<int>& order) {
+    const size_t num_items = idx_to_original_item.size();
+    vector<int> new_of_old(num_items, -1);
+    for (size_t new_idx = 0; new_idx < order.size(); ++new_idx) {
+        if (order[new_idx] < 0 || static_cast<size_t>(order[new_idx]) >= num_items || new_of_old[order[new_idx]] != -1) {
+            throw invalid_argument("DataManager: el orden de items no es una permutacion.");
+        }
+        new_of_old[order[new_idx]] = static_cast<int>(new_idx);
+    }
+    if (order.size() != num_items) throw invalid_argument("DataManager: el orden de items no es una permutacion.");
+
+    vector<int> reordered_ids(num_items);
+    for (size_t new_idx = 0; new_idx < num_items; ++new_idx) reordered_ids[new_idx] = idx_to_original_item[order[new_idx]];
+    idx_to_original_item = move(reordered_ids);
+    for (auto& entry : item_to_idx) entry.second = new_of_old[entry.second];
+    for (auto& triplet : triplets_with_internal_ids) {
+        triplet.preferred_item_id = new_of_old[triplet.preferred_item_id];
+        triplet.less_preferred_item_id = new_of_old[triplet.less_preferred_item_id];
+    }
+    for (auto& user_ratings : internal_ratings) {
+        unordered_map<int, double> remapped;
+        remapped.reserve(user_ratings.second.size());
+        for (const auto& item_rating : user_ratings.second) remapped[new_of_old[item_rating.first]] = item_rating.second;
+        user_ratings.second = move(remapped);
+    }
+}
+
+void DataManager::reorder_items(const vector<int>& order) {
+    apply_item_order(order);
+    save_cache();
+    save_item_order(item_order_path(path), idx_to_original_item);
+}
+
+uint64_t DataManager::catalog_fingerprint() const {
+    uint64_t hash = 1469598103934665603ULL;
+    auto mix = [&hash](uint64_t word) { hash = (hash ^ word) * 1099511628211ULL; };
+    mix(idx_to_original_user.size());
+    for (int user_id : idx_to_original_user) mix(static_cast<uint32_t>(user_id));
+    mix(idx_to_original_item.size());
+    for (int item_id : idx_to_original_item) mix(static_cast<uint32_t>(item_id));
+    return hash;
+}
+
+vector<pair<int, double>> DataManager::get_user_ratings(int user_idx) const {
+    vector<pair<int, double>> ratings;
+    auto user_it = internal_ratings.find(user_idx);
+    if (user_it == internal_ratings.end()) return ratings;
+    ratings.assign(user_it->second.begin(), user_it->second.end());
+    sort(ratings.begin(), ratings.end());
+    return ratings;
+}
+
+vector<int> DataManager::add_ratings(const vector<Rating>& ratings) {
+    map<int, vector<Rating>> new_by_user; // ascendente por user_id, como ratings_to_triplets
+    for (const auto& rating : ratings) new_by_user[rating.user_id].push_back(rating);
+
+    vector<int> touched;
+    vector<Triplet> new_triplets, user_triplets;
+    for (const auto& [user_id, user_new] : new_by_user) {
+        // Historial completo en ids originales; el rating más reciente de un item gana.
+        map<int, Rating> merged;
+        int user_idx = get_user_idx(user_id);
+        if (user_idx != -1) {
+            for (const auto& [item_idx, value] : get_user_ratings(user_idx)) {
+                merged[idx_to_original_item[item_idx]] = {user_id, idx_to_original_item[item_idx], value, 0};
+            }
+        }
+        for (const auto& rating : user_new) merged[rating.movie_id] = rating;
+        vector<Rating> history;
+        history.reserve(merged.size());
+        for (const auto& entry : merged) history.push_back(entry.second);
+
+        // Semilla por usuario: el resultado no depende de qué otros usuarios llegaron en el lote.
+        mt19937 rng(42 + static_cast<uint32_t>(user_id));
+        user_ratings_to_triplets(user_id, history, max_triplets_per_user, 0.5, rng, user_triplets);
+        if (user_triplets.empty() && user_idx == -1) continue;
+
+        if (user_idx == -1) {
+            user_idx = static_cast<int>(idx_to_original_user.size());
+            user_to_idx[user_id] = user_idx;
+            idx_to_original_user.push_back(user_id);
+        }
+        for (const auto& triplet : user_triplets) {
+            for (int original_item : {triplet.preferred_item_id, triplet.less_preferred_item_id}) {
+                if (item_to_idx.count(original_item)) continue;
+                item_to_idx[original_item] = static_cast<int>(idx_to_original_item.size());
+                idx_to_original_item.push_back(original_item);
+            }
+            new_triplets.push_back({user_idx, item_to_idx.at(triplet.preferred_item_id),
+                                    item_to_idx.at(triplet.less_preferred_item_id)});
+        }
+        auto& user_ratings = internal_ratings[user_idx];
+        for (const auto& rating : history) {
+            auto item_it = item_to_idx.find(rating.movie_id);
+            if (item_it != item_to_idx.end()) user_ratings[item_it->second] = rating.rating;
+        }
+        touched.push_back(user_idx);
+    }
+
+    vector<char> is_touched(idx_to_original_user.size(), 0);
+    for (int user_idx : touched) is_touched[user_idx] = 1;
+    erase_if(triplets_with_internal_ids, [&is_touched](const Triplet& triplet) { return is_touched[triplet.user_id]; });
+    triplets_with_internal_ids.insert(triplets_with_internal_ids.end(), new_triplets.begin(), new_triplets.end());
+    return touched;
+}
+
+// Los items del orden guardado van primero y en ese orden; los que no están
+// en él (otro max_ratings, por ejemplo) siguen detrás en su orden actual.
+void DataManager::apply_saved_item_order() {
+    vector<int> saved_ids;
+    if (idx_to_original_item.empty() || !load_item_order(item_order_path(path), saved_ids)) return;
+    vector<int> order;
+    vector<char> placed(idx_to_original_item.size(), 0);
+    order.reserve(idx_to_original_item.size());
+    for (int original_id : saved_ids) {
+        auto it = item_to_idx.find(original_id);
+        if (it != item_to_idx.end() && !placed[it->second]) {
+            order.push_back(it->second);
+            placed[it->second] = 1;
+        }
+    }
+    for (size_t idx = 0; idx < placed.size(); ++idx) {
+        if (!placed[idx]) order.push_back(static_cast<int>(idx));
+    }
+    bool identity = true;
+    for (size_t idx = 0; idx < order.size() && identity; ++idx) identity = order[idx] == static_cast<int>(idx);
+    if (identity) return;
+    cout << "Aplicando el orden de items de " << item_order_path(path) << " al cache." << endl;
+    apply_item_order(order);
+    save_cache();
 }
 
 void DataManager::load_and_prepare_data() {
@@ -177,11 +449,11 @@ bool DataManager::load_cache() {
     return true;
 }
 
-void DataManager::save_cache() const {
-    ofstream cache_file(cache_path, ios::binary);
+bool DataManager::save_cache(const string& filepath) const {
+    ofstream cache_file(filepath, ios::binary);
     if (!cache_file.is_open()) {
-        cerr << "Error: No se pudo crear el archivo de cache en " << cache_path << endl;
-        return;
+        cerr << "Error: No se pudo crear el archivo de cache en " << filepath << endl;
+        return false;
     }
 
     // Guardar tamaños
@@ -217,6 +489,12 @@ void DataManager::save_cache() const {
             cache_file.write(reinterpret_cast<const char*>(&item_rating.second), sizeof(double)); // rating
         }
     }
+    cache_file.close();
+    if (!cache_file) {
+        cerr << "Error: fallo la escritura del cache en " << filepath << endl;
+        return false;
+    }
+    return true;
 }
 
 int DataManager::get_user_idx(int original_user_id) const {
@@ -224,6 +502,11 @@ int DataManager::get_user_idx(int original_user_id) const {
     return (it != user_to_idx.end()) ? it->second : -1;
 }
 
+int DataManager::get_item_idx(int original_item_id) const {
+    auto it = item_to_idx.find(original_item_id);
+    return (it != item_to_idx.end()) ? it->second : -1;
+}
+
 int DataManager::get_original_item_id(int item_idx) const {
     return (item_idx >= 0 && item_idx < idx_to_original_item.size()) ? idx_to_original_item[item_idx] : -1;
 }
@@ -242,3 +525,141 @@ double DataManager::get_rating(int user_idx, int item_idx) const {
     }
     return 0.0;
 }
+
+// Escribe un cache con el formato de DataManager::save_cache sin tener todos
+// los ratings en memoria. Recibe los ratings usuario por usuario, en orden
+// ascendente de user_id y sin pares (usuario, item) repetidos, y produce el
+// mismo contenido que DataManager::init() obtendría leyendo ese CSV: mismas
+// tripletas, mismos índices internos y mismos ratings.
+// Las tripletas y los ratings se acumulan en archivos temporales junto al cache.
+class DataCacheWriter {
+public:
+    DataCacheWriter(string cache_path, int max_ratings, int max_triplets_per_user);
+
+    // Devuelve false una vez alcanzado max_ratings; los ratings restantes se ignoran.
+    bool add_user(int user_id, const vector<Rating>& user_ratings);
+    bool finish();
+
+private:
+    string cache_path_, triplets_tmp_path_, ratings_tmp_path_;
+    ofstream triplets_tmp_, ratings_tmp_;
+    long long remaining_ratings_;
+    int max_triplets_per_user_;
+    mt19937 rng_{42}; // misma semilla que ratings_to_triplets
+
+    unordered_map<int, int> user_to_idx_, item_to_idx_;
+    vector<int> idx_to_original_user_, idx_to_original_item_;
+    size_t num_triplets_ = 0;
+    vector<Triplet> user_triplets_;
+
+    int item_idx(int original_item_id);
+};
+
+DataCacheWriter::DataCacheWriter(string cache_path, int max_ratings, int max_triplets_per_user)
+    : cache_path_(move(cache_path)),
+      triplets_tmp_path_(cache_path_ + ".triplets.tmp"),
+      ratings_tmp_path_(cache_path_ + ".ratings.tmp"),
+      triplets_tmp_(triplets_tmp_path_, ios::binary),
+      ratings_tmp_(ratings_tmp_path_, ios::binary),
+      remaining_ratings_(max_ratings == -1 ? LLONG_MAX : max_ratings),
+      max_triplets_per_user_(max_triplets_per_user) {}
+
+int DataCacheWriter::item_idx(int original_item_id) {
+    auto [it, inserted] = item_to_idx_.try_emplace(original_item_id, static_cast<int>(idx_to_original_item_.size()));
+    if (inserted) idx_to_original_item_.push_back(original_item_id);
+    return it->second;
+}
+
+bool DataCacheWriter::add_user(int user_id, const vector<Rating>& user_ratings) {
+    if (remaining_ratings_ <= 0) return false;
+    // DataManager solo lee las primeras max_ratings líneas del CSV.
+    size_t used = static_cast<size_t>(min<long long>(remaining_ratings_, user_ratings.size()));
+    remaining_ratings_ -= used;
+    vector<Rating> loaded;
+    const vector<Rating>* ratings = &user_ratings;
+    if (used < user_ratings.size()) {
+        loaded.assign(user_ratings.begin(), user_ratings.begin() + used);
+        ratings = &loaded;
+    }
+
+    user_ratings_to_triplets(user_id, *ratings, max_triplets_per_user_, 0.5, rng_, user_triplets_);
+    // Usuarios sin tripletas no reciben índice y sus ratings se descartan.
+    if (user_triplets_.empty()) return remaining_ratings_ > 0;
+
+    int user_idx = static_cast<int>(idx_to_original_user_.size());
+    user_to_idx_[user_id] = user_idx;
+    idx_to_original_user_.push_back(user_id);
+    for (const auto& triplet : user_triplets_) {
+        // Mismo orden de asignación de índices que load_and_prepare_data().
+        Triplet internal{user_idx, item_idx(triplet.preferred_item_id), item_idx(triplet.less_preferred_item_id)};
+        triplets_tmp_.write(reinterpret_cast<const char*>(&internal), sizeof(Triplet));
+    }
+    num_triplets_ += user_triplets_.size();
+
+    // El item puede recibir índice en tripletas de usuarios posteriores, así que
+    // se guarda el id original y se traduce en finish().
+    for (const auto& rating : *ratings) {
+        ratings_tmp_.write(reinterpret_cast<const char*>(&user_idx), sizeof(int));
+        ratings_tmp_.write(reinterpret_cast<const char*>(&rating.movie_id), sizeof(int));
+        ratings_tmp_.write(reinterpret_cast<const char*>(&rating.rating), sizeof(double));
+    }
+    return remaining_ratings_ > 0;
+}
+
+bool DataCacheWriter::finish() {
+    triplets_tmp_.close();
+    ratings_tmp_.close();
+    ofstream cache_file(cache_path_, ios::binary);
+    if (!cache_file.is_open()) {
+        cerr << "Error: No se pudo crear el archivo de cache en " << cache_path_ << endl;
+        return false;
+    }
+
+    size_t num_users = idx_to_original_user_.size();
+    size_t num_items = idx_to_original_item_.size();
+    cache_file.write(reinterpret_cast<const char*>(&num_users), sizeof(size_t));
+    cache_file.write(reinterpret_cast<const char*>(&num_items), sizeof(size_t));
+    cache_file.write(reinterpret_cast<const char*>(&num_triplets_), sizeof(size_t));
+    for (int idx = 0; idx < static_cast<int>(num_users); ++idx) {
+        cache_file.write(reinterpret_cast<const char*>(&idx_to_original_user_[idx]), sizeof(int));
+        cache_file.write(reinterpret_cast<const char*>(&idx), sizeof(int));
+    }
+    for (int idx = 0; idx < static_cast<int>(num_items); ++idx) {
+        cache_file.write(reinterpret_cast<const char*>(&idx_to_original_item_[idx]), sizeof(int));
+        cache_file.write(reinterpret_cast<const char*>(&idx), sizeof(int));
+    }
+
+    ifstream triplets_in(triplets_tmp_path_, ios::binary);
+    if (num_triplets_ > 0) cache_file << triplets_in.rdbuf();
+    triplets_in.close();
+
+    // El total de ratings se conoce al final: se reserva su lugar y se completa después.
+    auto count_pos = cache_file.tellp();
+    size_t total_ratings = 0;
+    cache_file.write(reinterpret_cast<const char*>(&total_ratings), sizeof(size_t));
+    ifstream ratings_in(ratings_tmp_path_, ios::binary);
+    int user_idx, original_item_id;
+    double rating;
+    while (ratings_in.read(reinterpret_cast<char*>(&user_idx), sizeof(int)) &&
+           ratings_in.read(reinterpret_cast<char*>(&original_item_id), sizeof(int)) &&
+           ratings_in.read(reinterpret_cast<char*>(&rating), sizeof(double))) {
+        auto it = item_to_idx_.find(original_item_id);
+        if (it == item_to_idx_.end()) continue;
+        cache_file.write(reinterpret_cast<const char*>(&user_idx), sizeof(int));
+        cache_file.write(reinterpret_cast<const char*>(&it->second), sizeof(int));
+        cache_file.write(reinterpret_cast<const char*>(&rating), sizeof(double));
+        ++total_ratings;
+    }
+    ratings_in.close();
+    cache_file.seekp(count_pos);
+    cache_file.write(reinterpret_cast<const char*>(&total_ratings), sizeof(size_t));
+    bool ok = cache_file.good();
+    cache_file.close();
+
+    error_code ec;
+    filesystem::remove(triplets_tmp_path_, ec);
+    filesystem::remove(ratings_tmp_path_, ec);
+    cout << "Cache escrito en " << cache_path_ << ": " << num_users << " usuarios, " << num_items << " items, "
+         << num_triplets_ << " tripletas, " << total_ratings << " ratings." << endl;
+    return ok;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DataManager.h"
+#include "MatrixFactorization.h"
+#include "SRPRModel.h"
+#include "Triplet.h"
+#include "vec.h"
+
+using namespace std;
+
+// Fold-in de usuarios nuevos o con ratings actualizados: unos cientos de pasos
+// de SGD sobre la fila del usuario con los items congelados, con la misma
+// pérdida que el entrenamiento (BPR o SRPR). Tarda milisegundos y el vector
+// resultante se consulta en el índice LSH igual que uno entrenado.
+struct FoldInOptions {
+    int steps = 300;
+    double learning_rate = 0.05;
+    double lambda = 0.001;
+    int srp_bits = 8;            // b de SRPR (bits por tabla del LSH), como en train()
+    int max_triplets = 300;      // mismo tope por usuario que el preprocesamiento
+    double min_rating_diff = 0.5;
+    uint64_t seed = 42;
+};
+
+// Tripletas del usuario a partir de ratings crudos (item original, rating),
+// con el mismo muestreo que el preprocesamiento y ya barajadas para que el
+// recorrido cíclico de fold_in_user no siga el orden de entrada. Los items
+// que el DataManager no conoce se ignoran (no tienen vector).
+inline vector<Triplet> fold_in_triplets(const DataManager& dm, const vector<pair<int, double>>& ratings,
+                                        const FoldInOptions& options) {
+    vector<Rating> known;
+    for (const auto& [original_item_id, rating] : ratings) {
+        int item_idx = dm.get_item_idx(original_item_id);
+        if (item_idx != -1) known.push_back({-1, item_idx, rating, 0});
+    }
+    mt19937 rng(options.seed);
+    vector<Triplet> triplets;
+    user_ratings_to_triplets(-1, known, options.max_triplets, options.min_rating_diff, rng, triplets);
+    shuffle(triplets.begin(), triplets.end(), rng);
+    return triplets;
+}
+
+// Punto de partida de un usuario nuevo: la misma distribución con la que los
+// modelos inicializan sus vectores.
+inline Vec fold_in_initial_vector(size_t dimension, uint64_t seed) {
+    mt19937 rng(seed);
+    normal_distribution<double> dist(0.0, 0.1);
+    Vec vec(dimension);
+    for (size_t i = 0; i < dimension; ++i) vec[i] = dist(rng);
+    return vec;
+}
+
+inline Vec fold_in_user(const MatrixFactorization& model, const vector<Triplet>& triplets, Vec start,
+                        const FoldInOptions& options) {
+    return model.fold_in_user(triplets, move(start), options.steps, options.learning_rate, options.lambda);
+}
+
+inline Vec fold_in_user(const SRPRModel& model, const vector<Triplet>& triplets, Vec start,
+                        const FoldInOptions& options) {
+    return model.fold_in_user(triplets, move(start), options.srp_bits, options.learning_rate, options.lambda,
+                              options.steps);
+}
+
+// Vectores plegados por usuario original, ligados a la versión de los modelos
+// con la que se calcularon (con otra versión los items ya no son los mismos).
+// Capacidad fija; al llenarse se descarta el más antiguo.
+class FoldInCache {
+public:
+    struct Entry {
+        uint64_t model_version = 0;
+        Vec bpr;   // vacío si BPR no estaba publicado
+        Vec srpr;
+    };
+
+    explicit FoldInCache(size_t capacity = 10000) : capacity_(max<size_t>(1, capacity)) {}
+
+    void put(int user_id, Entry entry) {
+        lock_guard<mutex> lock(mutex_);
+        auto [it, inserted] = entries_.insert_or_assign(user_id, move(entry));
+        if (!inserted) return;
+        order_.push_back(user_id);
+        if (order_.size() > capacity_) {
+            entries_.erase(order_.front());
+            order_.pop_front();
+        }
+    }
+
+    // La entrada del usuario si se calculó con model_version.
+    optional<Entry> get(int user_id, uint64_t model_version) const {
+        lock_guard<mutex> lock(mutex_);
+        auto it = entries_.find(user_id);
+        if (it == entries_.end() || it->second.model_version != model_version) return nullopt;
+        return it->second;
+    }
+
+    size_t size() const {
+        lock_guard<mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+private:
+    size_t capacity_;
+    mutable mutex mutex_;
+    unordered_map<int, Entry> entries_;
+    deque<int> order_;  // orden de inserción, para descartar
+};
@@ -0,0 +1,190 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "vec.h"
+#include "lsh.h"
+#include "simd.h"
+
+using namespace std;
+
+// Verdad de referencia exacta para los benchmarks: el top-k_max por similitud
+// coseno de los primeros num_users usuarios contra todo el catálogo. Se calcula
+// una sola vez, en paralelo, y se guarda en un archivo binario identificado por
+// la huella de los embeddings; cada configuración de un barrido lee de ahí el
+// prefijo top-k que necesita en vez de repetir la fuerza bruta.
+class GroundTruth {
+public:
+    int num_users() const { return num_users_; }
+    int k_max() const { return k_max_; }
+
+    // Los k (<= k_max) mejores items del usuario como (item, similitud), de mayor
+    // a menor; el mismo orden que la fuerza bruta de los ejecutables.
+    vector<pair<int, double>> top_k(int user_idx, int k) const;
+
+    template <typename ModelType>
+    static GroundTruth compute(const ModelType& model, int num_users, int k_max);
+    // Igual, pero sin los items para los que exclude(usuario, item) es true
+    // (p. ej. los que el usuario ya vio al evaluar contra ratings apartados).
+    template <typename ModelType, typename Exclude>
+    static GroundTruth compute(const ModelType& model, int num_users, int k_max, Exclude exclude);
+
+    bool save(const string& filepath) const;
+    // Falla si el archivo no existe, es de otros embeddings o cubre menos
+    // usuarios o un k_max menor que el pedido.
+    bool load(const string& filepath, uint64_t checksum, int num_users, int k_max);
+
+    // Lee el archivo si sirve para (modelo, num_users, k_max); si no, calcula y lo reescribe.
+    template <typename ModelType>
+    static GroundTruth load_or_compute(const ModelType& model, int num_users, int k_max, const string& filepath);
+
+    template <typename ModelType>
+    static uint64_t model_checksum(const ModelType& model) {
+        return embedding_checksum(model.get_user_vectors(), embedding_checksum(model.get_item_vectors()));
+    }
+
+private:
+    int num_users_ = 0;
+    int k_max_ = 0;
+    uint64_t checksum_ = 0;
+    // num_users_ x k_max_, fila-mayor; si el catálogo tiene menos de k_max
+    // items las filas se rellenan con id -1.
+    vector<int> ids_;
+    vector<double> scores_;
+};
+
+// Ruta por defecto de la verdad de referencia de un modelo.
+inline string ground_truth_path(const string& model_name) {
+    return "../data/" + model_name + ".groundtruth.bin";
+}
+
+struct GroundTruthFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_users;
+    uint32_t k_max;
+    uint32_t reserved;
+    uint64_t checksum;
+};
+
+constexpr char GROUND_TRUTH_MAGIC[8] = {'S', 'R', 'P', 'R', 'G', 'T', 'R', 'U'};
+constexpr uint32_t GROUND_TRUTH_VERSION = 1;
+
+inline vector<pair<int, double>> GroundTruth::top_k(int user_idx, int k) const {
+    vector<pair<int, double>> results;
+    size_t row = static_cast<size_t>(user_idx) * k_max_;
+    for (int i = 0; i < min(k, k_max_) && ids_[row + i] >= 0; ++i) {
+        results.push_back({ids_[row + i], scores_[row + i]});
+    }
+    return results;
+}
+
+template <typename ModelType>
+GroundTruth GroundTruth::compute(const ModelType& model, int num_users, int k_max) {
+    return compute(model, num_users, k_max, [](int, int) { return false; });
+}
+
+template <typename ModelType, typename Exclude>
+GroundTruth GroundTruth::compute(const ModelType& model, int num_users, int k_max, Exclude exclude) {
+    const auto& items = model.get_item_vectors();
+    vector<double> item_norms(items.size());
+    for (size_t i = 0; i < items.size(); ++i) item_norms[i] = items[i].magnitude();
+
+    GroundTruth truth;
+    truth.num_users_ = num_users;
+    truth.k_max_ = k_max;
+    truth.checksum_ = model_checksum(model);
+    truth.ids_.assign(static_cast<size_t>(num_users) * k_max, -1);
+    truth.scores_.assign(static_cast<size_t>(num_users) * k_max, 0.0);
+
+    #pragma omp parallel for schedule(dynamic, 4)
+    for (int u = 0; u < num_users; ++u) {
+        ConstVecView user_vec = model.get_user_vector(u);
+        const double user_norm = user_vec.magnitude();
+        // Los productos contra todos los items de una vez (mismos valores que dot()).
+        vector<double> dots(items.size());
+        simd_batch_dot(user_vec.data(), items.data(), items.size(), items.dimension(), dots.data());
+        vector<pair<double, int>> scores;
+        scores.reserve(items.size());
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (exclude(u, static_cast<int>(i))) continue;
+            // Misma expresión que calculate_cosine_similarity, para obtener los mismos valores.
+            double magnitude_product = user_norm * item_norms[i];
+            double score = magnitude_product < 1e-9 ? 0.0 : dots[i] / magnitude_product;
+            scores.push_back({score, static_cast<int>(i)});
+        }
+        size_t k = min<size_t>(k_max, scores.size());
+        partial_sort(scores.begin(), scores.begin() + k, scores.end(), greater<>());
+        for (size_t i = 0; i < k; ++i) {
+            truth.ids_[static_cast<size_t>(u) * k_max + i] = scores[i].second;
+            truth.scores_[static_cast<size_t>(u) * k_max + i] = scores[i].first;
+        }
+    }
+    return truth;
+}
+
+inline bool GroundTruth::save(const string& filepath) const {
+    ofstream out_file(filepath, ios::binary);
+    if (!out_file.is_open()) {
+        cerr << "Error: No se pudo abrir el archivo para guardar la verdad de referencia: " << filepath << endl;
+        return false;
+    }
+    GroundTruthFileHeader header{};
+    copy(begin(GROUND_TRUTH_MAGIC), end(GROUND_TRUTH_MAGIC), header.magic);
+    header.version = GROUND_TRUTH_VERSION;
+    header.num_users = num_users_;
+    header.k_max = k_max_;
+    header.checksum = checksum_;
+    out_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_file.write(reinterpret_cast<const char*>(ids_.data()), ids_.size() * sizeof(int));
+    out_file.write(reinterpret_cast<const char*>(scores_.data()), scores_.size() * sizeof(double));
+    return static_cast<bool>(out_file);
+}
+
+inline bool GroundTruth::load(const string& filepath, uint64_t checksum, int num_users, int k_max) {
+    ifstream in_file(filepath, ios::binary);
+    if (!in_file.is_open()) return false;
+    GroundTruthFileHeader header{};
+    if (!in_file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !equal(begin(GROUND_TRUTH_MAGIC), end(GROUND_TRUTH_MAGIC), header.magic) ||
+        header.version != GROUND_TRUTH_VERSION || header.checksum != checksum ||
+        header.num_users < static_cast<uint32_t>(num_users) || header.k_max < static_cast<uint32_t>(k_max)) {
+        return false;
+    }
+    // Se conserva todo lo guardado: un k o un número de usuarios menor es un prefijo.
+    size_t cells = static_cast<size_t>(header.num_users) * header.k_max;
+    vector<int> ids(cells);
+    vector<double> scores(cells);
+    if (!in_file.read(reinterpret_cast<char*>(ids.data()), cells * sizeof(int)) ||
+        !in_file.read(reinterpret_cast<char*>(scores.data()), cells * sizeof(double))) {
+        cerr << "Error: verdad de referencia truncada en " << filepath << endl;
+        return false;
+    }
+    num_users_ = header.num_users;
+    k_max_ = header.k_max;
+    checksum_ = checksum;
+    ids_ = move(ids);
+    scores_ = move(scores);
+    return true;
+}
+
+template <typename ModelType>
+GroundTruth GroundTruth::load_or_compute(const ModelType& model, int num_users, int k_max, const string& filepath) {
+    GroundTruth truth;
+    if (truth.load(filepath, model_checksum(model), num_users, k_max)) {
+        cout << "Verdad de referencia cargada desde " << filepath << " (" << truth.num_users() << " usuarios, top-"
+             << truth.k_max() << ")." << endl;
+        return truth;
+    }
+    auto start = chrono::steady_clock::now();
+    truth = compute(model, num_users, k_max);
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    cout << "Verdad de referencia calculada (" << num_users << " usuarios, top-" << k_max << ") en "
+         << elapsed.count() << " ms." << endl;
+    if (truth.save(filepath)) cout << "Verdad de referencia guardada en: " << filepath << endl;
+    return truth;
+}
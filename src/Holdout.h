@@ -0,0 +1,275 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DataManager.h"
+#include "GroundTruth.h"
+#include "Triplet.h"
+#include "matrix.h"
+#include "vec.h"
+
+using namespace std;
+
+// Evaluación con ratings apartados durante el entrenamiento, para no fijar
+// las épocas a ciegas: a una muestra de usuarios se le apartan algunos items
+// bien calificados (y las tripletas que los usan), y al final de cada época un
+// hilo aparte mide recall@k y nDCG@k de esos items sobre una copia de los
+// vectores, con el top-k exacto en paralelo de GroundTruth. El SGD no se
+// detiene a esperar; cuando nDCG@k deja de mejorar durante patience
+// evaluaciones, train() corta y se queda con los vectores de la mejor época.
+struct HoldoutOptions {
+    bool enabled = false;
+    int num_users = 2000;       // usuarios evaluados
+    double fraction = 0.2;      // de sus items relevantes, cuántos se apartan (al menos 1)
+    double min_rating = 4.0;    // un item es relevante con rating >= min_rating
+    int k = 10;
+    int patience = 2;           // evaluaciones sin mejora antes de cortar
+    double min_delta = 1e-4;    // mejora mínima de nDCG@k que cuenta
+    uint64_t seed = 42;
+};
+
+// --holdout [--holdout_users=<n>] [--holdout_k=<k>] [--patience=<n>]
+inline HoldoutOptions parse_holdout_options(int argc, char* argv[]) {
+    HoldoutOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--holdout") options.enabled = true;
+        else if (arg.rfind("--holdout_users=", 0) == 0) options.num_users = stoi(arg.substr(16));
+        else if (arg.rfind("--holdout_k=", 0) == 0) options.k = stoi(arg.substr(12));
+        else if (arg.rfind("--patience=", 0) == 0) options.patience = stoi(arg.substr(11));
+    }
+    return options;
+}
+
+// Usuarios evaluados con sus items apartados y los que ya vieron (el resto de
+// sus ratings), que no cuentan en el ranking.
+struct HoldoutSet {
+    vector<int> users;
+    vector<vector<int>> held_out;  // ordenados
+    vector<vector<int>> seen;      // ordenados
+
+    // Elige los usuarios, aparta sus items y devuelve las tripletas de
+    // entrenamiento sin las que los mencionan, en el mismo orden.
+    static HoldoutSet split(const DataManager& dm, const HoldoutOptions& options, vector<Triplet>& train_triplets);
+};
+
+inline HoldoutSet HoldoutSet::split(const DataManager& dm, const HoldoutOptions& options,
+                                    vector<Triplet>& train_triplets) {
+    mt19937 rng(options.seed);
+    vector<int> candidates(dm.get_num_users());
+    iota(candidates.begin(), candidates.end(), 0);
+    shuffle(candidates.begin(), candidates.end(), rng);
+
+    HoldoutSet set;
+    vector<int> held_index(dm.get_num_users(), -1);
+    for (int user_idx : candidates) {
+        if (static_cast<int>(set.users.size()) >= options.num_users) break;
+        vector<int> relevant, seen;
+        for (const auto& [item_idx, rating] : dm.get_user_ratings(user_idx)) {
+            (rating >= options.min_rating ? relevant : seen).push_back(item_idx);
+        }
+        // Tiene que quedarle con qué entrenar.
+        if (relevant.size() < 2 || relevant.size() + seen.size() < 5) continue;
+        shuffle(relevant.begin(), relevant.end(), rng);
+        size_t count = max<size_t>(1, static_cast<size_t>(options.fraction * relevant.size()));
+        vector<int> held(relevant.begin(), relevant.begin() + count);
+        seen.insert(seen.end(), relevant.begin() + count, relevant.end());
+        sort(held.begin(), held.end());
+        sort(seen.begin(), seen.end());
+        held_index[user_idx] = set.users.size();
+        set.users.push_back(user_idx);
+        set.held_out.push_back(move(held));
+        set.seen.push_back(move(seen));
+    }
+
+    const auto& triplets = dm.get_training_triplets();
+    train_triplets.clear();
+    train_triplets.reserve(triplets.size());
+    for (const auto& triplet : triplets) {
+        int h = held_index[triplet.user_id];
+        if (h >= 0) {
+            const auto& held = set.held_out[h];
+            if (binary_search(held.begin(), held.end(), triplet.preferred_item_id) ||
+                binary_search(held.begin(), held.end(), triplet.less_preferred_item_id)) {
+                continue;
+            }
+        }
+        train_triplets.push_back(triplet);
+    }
+    cout << "Holdout: " << set.users.size() << " usuarios evaluados, " << triplets.size() - train_triplets.size()
+         << " tripletas apartadas de " << triplets.size() << "." << endl;
+    return set;
+}
+
+// Copia de los vectores al final de una época. Expone la interfaz de modelo
+// que usa GroundTruth::compute, con los usuarios evaluados como 0..n-1.
+struct EmbeddingSnapshot {
+    int epoch = 0;
+    EmbeddingMatrix user_vectors;
+    EmbeddingMatrix item_vectors;
+    const vector<int>* users = nullptr;
+
+    ConstVecView get_user_vector(int u) const { return user_vectors[(*users)[u]]; }
+    const EmbeddingMatrix& get_user_vectors() const { return user_vectors; }
+    const EmbeddingMatrix& get_item_vectors() const { return item_vectors; }
+};
+
+struct HoldoutResult {
+    int epoch = 0;
+    double recall = 0.0;
+    double ndcg = 0.0;
+    double elapsed_ms = 0.0;
+};
+
+// Evaluador en segundo plano con una sola ranura, como CheckpointWriter: si
+// una época termina antes de que se evalúe la anterior, la pendiente se
+// reemplaza y se evalúa solo la más reciente.
+class HoldoutEvaluator {
+public:
+    HoldoutEvaluator(HoldoutSet set, const HoldoutOptions& options, string name)
+        : set_(move(set)), options_(options), name_(move(name)) {
+        thread_ = jthread([this](stop_token stop) { run(stop); });
+    }
+    HoldoutEvaluator(const HoldoutEvaluator&) = delete;
+    HoldoutEvaluator& operator=(const HoldoutEvaluator&) = delete;
+    ~HoldoutEvaluator() {
+        flush();
+        thread_.request_stop();
+    }
+
+    // Al final de una época: copia los vectores y vuelve enseguida.
+    void submit(int epoch, const EmbeddingMatrix& user_vectors, const EmbeddingMatrix& item_vectors) {
+        auto snapshot = make_unique<EmbeddingSnapshot>();
+        snapshot->epoch = epoch;
+        snapshot->user_vectors = user_vectors;
+        snapshot->item_vectors = item_vectors;
+        snapshot->users = &set_.users;
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (pending_) cout << "[" << name_ << "] holdout: se salta la epoch " << pending_->epoch << endl;
+            pending_ = move(snapshot);
+        }
+        wake_.notify_all();
+    }
+
+    // Con lo evaluado hasta ahora, ¿lleva patience evaluaciones sin mejorar?
+    bool should_stop() const {
+        lock_guard<mutex> lock(mutex_);
+        return evaluations_since_best_ >= options_.patience;
+    }
+
+    // Espera lo pendiente y, si la mejor época evaluada no es la última que
+    // se entrenó, deja en los vectores los de esa época.
+    bool restore_best(int last_epoch, EmbeddingMatrix& user_vectors, EmbeddingMatrix& item_vectors) {
+        flush();
+        lock_guard<mutex> lock(mutex_);
+        if (!best_ || best_->epoch == last_epoch) return false;
+        cout << "[" << name_ << "] holdout: se restauran los vectores de la epoch " << best_->epoch
+             << " (nDCG@" << options_.k << " " << fixed << setprecision(4) << best_result_.ndcg << ")." << endl;
+        user_vectors = move(best_->user_vectors);
+        item_vectors = move(best_->item_vectors);
+        best_.reset();
+        return true;
+    }
+
+    vector<HoldoutResult> history() const {
+        lock_guard<mutex> lock(mutex_);
+        return history_;
+    }
+
+private:
+    void flush() {
+        unique_lock<mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return !pending_ && !evaluating_; });
+    }
+
+    void run(stop_token stop) {
+        while (true) {
+            unique_ptr<EmbeddingSnapshot> snapshot;
+            {
+                unique_lock<mutex> lock(mutex_);
+                wake_.wait(lock, stop, [this] { return pending_ != nullptr; });
+                if (!pending_) break;
+                snapshot = move(pending_);
+                evaluating_ = true;
+            }
+            HoldoutResult result = evaluate(*snapshot);
+            cout << "[" << name_ << "] holdout epoch " << result.epoch << ": recall@" << options_.k << " "
+                 << fixed << setprecision(4) << result.recall << ", nDCG@" << options_.k << " " << result.ndcg
+                 << " (" << setprecision(1) << result.elapsed_ms << " ms)" << endl;
+            {
+                lock_guard<mutex> lock(mutex_);
+                history_.push_back(result);
+                if (history_.size() == 1 || result.ndcg > best_result_.ndcg + options_.min_delta) {
+                    best_result_ = result;
+                    best_ = move(snapshot);
+                    evaluations_since_best_ = 0;
+                } else {
+                    ++evaluations_since_best_;
+                }
+                evaluating_ = false;
+            }
+            idle_.notify_all();
+        }
+    }
+
+    // Top-k exacto sin los items que el usuario ya vio; los apartados que
+    // aparecen ahí son aciertos.
+    HoldoutResult evaluate(const EmbeddingSnapshot& snapshot) const {
+        auto start = chrono::steady_clock::now();
+        const int n = set_.users.size();
+        GroundTruth ranking = GroundTruth::compute(snapshot, n, options_.k, [this](int u, int item_idx) {
+            const auto& seen = set_.seen[u];
+            return binary_search(seen.begin(), seen.end(), item_idx);
+        });
+
+        HoldoutResult result;
+        result.epoch = snapshot.epoch;
+        for (int u = 0; u < n; ++u) {
+            const auto& held = set_.held_out[u];
+            double dcg = 0.0, idcg = 0.0;
+            int hits = 0, rank = 0;
+            for (const auto& [item_idx, score] : ranking.top_k(u, options_.k)) {
+                if (binary_search(held.begin(), held.end(), item_idx)) {
+                    ++hits;
+                    dcg += 1.0 / log2(rank + 2.0);
+                }
+                ++rank;
+            }
+            int ideal = min<int>(options_.k, held.size());
+            for (int i = 0; i < ideal; ++i) idcg += 1.0 / log2(i + 2.0);
+            result.recall += static_cast<double>(hits) / ideal;
+            result.ndcg += dcg / idcg;
+        }
+        if (n > 0) {
+            result.recall /= n;
+            result.ndcg /= n;
+        }
+        result.elapsed_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    HoldoutSet set_;
+    HoldoutOptions options_;
+    string name_;
+    mutable mutex mutex_;
+    condition_variable_any wake_;
+    condition_variable idle_;
+    unique_ptr<EmbeddingSnapshot> pending_;
+    bool evaluating_ = false;
+    vector<HoldoutResult> history_;
+    unique_ptr<EmbeddingSnapshot> best_;
+    HoldoutResult best_result_;
+    int evaluations_since_best_ = 0;
+    jthread thread_;
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Archivo binario de solo lectura proyectado en memoria (mmap). En Windows se
+// lee completo a un buffer, con la misma interfaz.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string& path);
+    void close();
+
+    bool is_open() const { return data_ != nullptr; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Puntero tipado a [offset, offset + count * sizeof(T)), o nullptr si se sale del archivo.
+    template <typename T>
+    const T* at(uint64_t offset, uint64_t count = 1) const {
+        if (offset > size_ || count > (size_ - offset) / sizeof(T)) return nullptr;
+        return reinterpret_cast<const T*>(data_ + offset);
+    }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    vector<uint8_t> buffer_; // solo se usa sin mmap
+};
+
+inline bool MappedFile::open(const string& path) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    data_ = static_cast<const uint8_t*>(mapped);
+    size_ = st.st_size;
+#else
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file.is_open()) return false;
+    buffer_.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (buffer_.empty() || !file.read(reinterpret_cast<char*>(buffer_.data()), buffer_.size())) {
+        buffer_.clear();
+        return false;
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+    return true;
+}
+
+inline void MappedFile::close() {
+#ifndef _WIN32
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+    buffer_.clear();
+    data_ = nullptr;
+    size_ = 0;
+}
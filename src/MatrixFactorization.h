@@ -1,10 +1,14 @@
 #pragma once
 #include <vector>
-#include "DataManager.h" 
+#include "Checkpoint.h"
+#include "DataManager.h"
+#include "Holdout.h" 
+#include "matrix.h"
 #include "vec.h"         
 #include <random>
 #include <cmath>
 #include <iostream>
+#include <sstream>
 
 using namespace std;
 
@@ -12,110 +16,209 @@ class MatrixFactorization {
 public:
     MatrixFactorization(int num_users, int num_items, int dimensions);
 
-    void train(const vector<Triplet>& triplets, int epochs, double learning_rate, double lambda);
+    // Con checkpoint, guarda puntos de control en segundo plano y, si se pide,
+    // retoma desde el último (ver Checkpoint.h). Con holdout, evalúa cada época
+    // en segundo plano y corta cuando deja de mejorar (ver Holdout.h).
+    void train(const vector<Triplet>& triplets, int epochs, double learning_rate, double lambda,
+               const CheckpointOptions* checkpoint = nullptr, HoldoutEvaluator* holdout = nullptr);
+    // Fold-in: steps pasos de SGD de BPR solo sobre un vector de usuario
+    // (partiendo de user_vec) contra los items congelados, recorriendo las
+    // tripletas en orden cíclico. No modifica el modelo; user_id se ignora.
+    Vec fold_in_user(const vector<Triplet>& triplets, Vec user_vec, int steps, double learning_rate, double lambda) const;
 
-    const Vec& get_user_vector(int user_idx) const;
-    const Vec& get_item_vector(int item_idx) const;
+    // Vistas sobre las matrices del modelo (ver matrix.h); valen mientras el
+    // modelo no cambie de tamaño (grow) ni se reordene (permute_items).
+    ConstVecView get_user_vector(int user_idx) const;
+    ConstVecView get_item_vector(int item_idx) const;
+    const EmbeddingMatrix& get_user_vectors() const { return user_vectors; }
+    const EmbeddingMatrix& get_item_vectors() const { return item_vectors; }
 
-    void save_vectors(const string& filepath) const;
-    bool load_vectors(const string& filepath);
+    // catalog_fingerprint (DataManager::catalog_fingerprint) queda en la
+    // cabecera; al cargar, si ambos lo tienen y no coinciden, el archivo es de
+    // otro orden de usuarios o items y se rechaza. 0 = sin huella.
+    bool save_vectors(const string& filepath, uint64_t catalog_fingerprint = 0) const;
+    bool load_vectors(const string& filepath, uint64_t catalog_fingerprint = 0);
+    // Reordena los items igual que DataManager::reorder_items (order[nuevo] = viejo).
+    void permute_items(const vector<int>& order);
+    // Agrega filas para usuarios o items nuevos (DataManager::add_ratings) con
+    // la misma inicialización que el constructor; las existentes no cambian.
+    void grow(int num_users, int num_items);
     int get_num_users() const { return user_vectors.size(); }
     int get_num_items() const { return item_vectors.size(); }
 
 private:
     int d; // Dimensiones
-    vector<Vec> user_vectors;
-    vector<Vec> item_vectors;
+    EmbeddingMatrix user_vectors;
+    EmbeddingMatrix item_vectors;
 
     double sigmoid(double x) const;
+    // Un paso de SGD de BPR sobre una tripleta; V es Vec o FixedVec<double, D>.
+    template <typename V>
+    void sgd_step(V& user_vec, V& pos_item_vec, V& neg_item_vec, double learning_rate, double lambda) const;
 };
 
-MatrixFactorization::MatrixFactorization(int num_users, int num_items, int dimensions) : d(dimensions) {
-    user_vectors.reserve(num_users);
-    for (int i = 0; i < num_users; ++i) {
-        user_vectors.emplace_back(d); 
-    }
-
-    item_vectors.reserve(num_items);
-    for (int i = 0; i < num_items; ++i) {
-        item_vectors.emplace_back(d); 
-    }
-
+MatrixFactorization::MatrixFactorization(int num_users, int num_items, int dimensions)
+    : d(dimensions), user_vectors(num_users, dimensions), item_vectors(num_items, dimensions) {
     mt19937 rng(42); // Semilla fija para reproducibilidad
     normal_distribution<double> dist(0.0, 0.1);
-    for (auto& vec : user_vectors) {
-        for (size_t i = 0; i < d; ++i) vec[i] = dist(rng);
-    }
-    for (auto& vec : item_vectors) {
-        for (size_t i = 0; i < d; ++i) vec[i] = dist(rng);
-    }
+    for (size_t i = 0; i < user_vectors.size() * d; ++i) user_vectors.data()[i] = dist(rng);
+    for (size_t i = 0; i < item_vectors.size() * d; ++i) item_vectors.data()[i] = dist(rng);
 }
 
 double MatrixFactorization::sigmoid(double x) const {
     return 1.0 / (1.0 + exp(-x));
 }
 
-void MatrixFactorization::train(const vector<Triplet>& triplets, int epochs, double learning_rate, double lambda) {
+template <typename V>
+void MatrixFactorization::sgd_step(V& user_vec, V& pos_item_vec, V& neg_item_vec, double learning_rate,
+                                   double lambda) const {
+    // Calcular predicciones usando la función dot de vec.h
+    double x_ui = dot(user_vec, pos_item_vec);
+    double x_uj = dot(user_vec, neg_item_vec);
+    double x_uij = x_ui - x_uj;
+
+    double sigmoid_x = sigmoid(x_uij);
+    double gradient_common = 1.0 - sigmoid_x;
+
+    // Calcular gradientes usando los operadores de Vec / FixedVec
+    V user_grad = (pos_item_vec - neg_item_vec) * gradient_common - (user_vec * lambda);
+    V pos_item_grad = user_vec * gradient_common - (pos_item_vec * lambda);
+    V neg_item_grad = user_vec * -gradient_common - (neg_item_vec * lambda);
+
+    // Actualizar vectores
+    user_vec += user_grad * learning_rate;
+    pos_item_vec += pos_item_grad * learning_rate;
+    neg_item_vec += neg_item_grad * learning_rate;
+}
+
+void MatrixFactorization::train(const vector<Triplet>& triplets, int epochs, double learning_rate, double lambda,
+                                const CheckpointOptions* checkpoint, HoldoutEvaluator* holdout) {
     if (triplets.empty()) {
         cerr << "Error: No hay tripletas para entrenar." << endl;
         return;
     }
 
-    for (int epoch = 1; epoch <= epochs; ++epoch) {
-        for (const auto& triplet : triplets) {
-            Vec& user_vec = user_vectors.at(triplet.user_id);
-            Vec& pos_item_vec = item_vectors.at(triplet.preferred_item_id);
-            Vec& neg_item_vec = item_vectors.at(triplet.less_preferred_item_id);
-
-            // Calcular predicciones usando la función dot de vec.h
-            double x_ui = dot(user_vec, pos_item_vec);
-            double x_uj = dot(user_vec, neg_item_vec);
-            double x_uij = x_ui - x_uj;
-
-            double sigmoid_x = sigmoid(x_uij);
-            double gradient_common = 1.0 - sigmoid_x;
-
-            // Calcular gradientes usando los operadores de la clase Vec
-            Vec user_grad = (pos_item_vec - neg_item_vec) * gradient_common - (user_vec * lambda);
-            Vec pos_item_grad = user_vec * gradient_common - (pos_item_vec * lambda);
-            Vec neg_item_grad = user_vec * -gradient_common - (neg_item_vec * lambda);
-
-            // Actualizar vectores
-            user_vec += user_grad * learning_rate;
-            pos_item_vec += pos_item_grad * learning_rate;
-            neg_item_vec += neg_item_grad * learning_rate;
+    TrainingSetup setup;
+    setup.model = 0;
+    setup.dimensions = d;
+    setup.num_users = user_vectors.size();
+    setup.num_items = item_vectors.size();
+    setup.num_triplets = triplets.size();
+    setup.triplets_fingerprint = checkpoint && !checkpoint->path.empty() ? triplets_fingerprint(triplets) : 0;
+    setup.learning_rate = learning_rate;
+    setup.lambda = lambda;
+    TrainingCheckpointer checkpointer(checkpoint, setup);
+    TrainingCursor cursor;
+    checkpointer.resume(user_vectors, item_vectors, cursor);
+
+    while (cursor.epoch <= epochs) {
+        // El paso se hace sobre copias de las tres filas: FixedVec con una
+        // dimensión de FIXED_DIMENSIONS, Vec si no (ver SRPRModel::train).
+        dispatch_dimension(d, [&](auto fixed) {
+            constexpr size_t D = decltype(fixed)::value;
+            using V = conditional_t<D == 0, Vec, FixedVec<double, D>>;
+            auto make = [&] {
+                if constexpr (D == 0) return Vec(d);
+                else return V();
+            };
+            V user_vec = make(), pos_item_vec = make(), neg_item_vec = make();
+            for (; cursor.position < triplets.size(); ++cursor.position) {
+                const Triplet& triplet = triplets[cursor.position];
+                VecView user_row = user_vectors.at(triplet.user_id);
+                VecView pos_item_row = item_vectors.at(triplet.preferred_item_id);
+                VecView neg_item_row = item_vectors.at(triplet.less_preferred_item_id);
+
+                copy_n(user_row.data(), d, user_vec.data());
+                copy_n(pos_item_row.data(), d, pos_item_vec.data());
+                copy_n(neg_item_row.data(), d, neg_item_vec.data());
+                sgd_step(user_vec, pos_item_vec, neg_item_vec, learning_rate, lambda);
+                copy_n(user_vec.data(), d, user_row.data());
+                copy_n(pos_item_vec.data(), d, pos_item_row.data());
+                copy_n(neg_item_vec.data(), d, neg_item_row.data());
+
+                checkpointer.after_triplet(user_vectors, item_vectors, {cursor.epoch, cursor.position + 1, 0.0});
+            }
+        });
+        cout << "Epoch " << cursor.epoch << "/" << epochs << " completado." << endl;
+        cursor = {cursor.epoch + 1, 0, 0.0};
+        bool stop = false;
+        if (holdout) {
+            holdout->submit(cursor.epoch - 1, user_vectors, item_vectors);
+            stop = holdout->should_stop();
+            if (stop) cout << "Holdout sin mejora: se detiene el entrenamiento BPR." << endl;
         }
-        cout << "Epoch " << epoch << "/" << epochs << " completado." << endl;
+        checkpointer.after_epoch(user_vectors, item_vectors, cursor, cursor.epoch > epochs || stop);
+        if (stop) break;
+    }
+    if (holdout) holdout->restore_best(cursor.epoch - 1, user_vectors, item_vectors);
+}
+
+Vec MatrixFactorization::fold_in_user(const vector<Triplet>& triplets, Vec user_vec, int steps, double learning_rate,
+                                      double lambda) const {
+    if (triplets.empty()) return user_vec;
+    for (int step = 0; step < steps; ++step) {
+        const Triplet& triplet = triplets[step % triplets.size()];
+        const Vec pos_item_vec(item_vectors.at(triplet.preferred_item_id));
+        const Vec neg_item_vec(item_vectors.at(triplet.less_preferred_item_id));
+
+        // Mismo gradiente de usuario que train().
+        double x_uij = dot(user_vec, pos_item_vec) - dot(user_vec, neg_item_vec);
+        double gradient_common = 1.0 - sigmoid(x_uij);
+        Vec user_grad = (pos_item_vec - neg_item_vec) * gradient_common - (user_vec * lambda);
+        user_vec += user_grad * learning_rate;
     }
+    return user_vec;
 }
 
-const Vec& MatrixFactorization::get_user_vector(int user_idx) const {
+ConstVecView MatrixFactorization::get_user_vector(int user_idx) const {
     return user_vectors.at(user_idx);
 }
 
-const Vec& MatrixFactorization::get_item_vector(int item_idx) const {
+ConstVecView MatrixFactorization::get_item_vector(int item_idx) const {
     return item_vectors.at(item_idx);
 }
 
-void MatrixFactorization::save_vectors(const string& filepath) const {
-    ofstream out_file(filepath);
+void MatrixFactorization::permute_items(const vector<int>& order) {
+    item_vectors.permute_rows(order);
+}
+
+void MatrixFactorization::grow(int num_users, int num_items) {
+    mt19937 rng(42 + user_vectors.size() + item_vectors.size());
+    normal_distribution<double> dist(0.0, 0.1);
+    auto grow_matrix = [&](EmbeddingMatrix& matrix, int rows) {
+        const size_t old_rows = matrix.size();
+        if (static_cast<int>(old_rows) >= rows) return;
+        matrix.resize(rows);
+        for (size_t i = old_rows * d; i < matrix.size() * d; ++i) matrix.data()[i] = dist(rng);
+    };
+    grow_matrix(user_vectors, num_users);
+    grow_matrix(item_vectors, num_items);
+}
+
+bool MatrixFactorization::save_vectors(const string& filepath, uint64_t catalog_fingerprint) const {
+    // Se escribe a un temporal y se renombra: quien recarga los vectores
+    // (App con --watch) nunca ve un archivo a medio escribir.
+    const string tmp_path = filepath + ".tmp";
+    ofstream out_file(tmp_path);
     if (!out_file.is_open()) {
-        cerr << "Error: No se pudo abrir el archivo para guardar vectores: " << filepath << endl;
-        return;
+        cerr << "Error: No se pudo abrir el archivo para guardar vectores: " << tmp_path << endl;
+        return false;
     }
 
-    out_file << user_vectors.size() << " " << item_vectors.size() << " " << d << "\n";
+    out_file << user_vectors.size() << " " << item_vectors.size() << " " << d << " " << catalog_fingerprint << "\n";
 
     out_file << fixed << setprecision(8);
 
-    for (const auto& vec : user_vectors) {
+    for (size_t u = 0; u < user_vectors.size(); ++u) {
+        ConstVecView vec = user_vectors[u];
         for (size_t i = 0; i < d; ++i) {
             out_file << vec[i] << (i == d - 1 ? "" : " ");
         }
         out_file << "\n";
     }
 
-    for (const auto& vec : item_vectors) {
+    for (size_t item = 0; item < item_vectors.size(); ++item) {
+        ConstVecView vec = item_vectors[item];
         for (size_t i = 0; i < d; ++i) {
             out_file << vec[i] << (i == d - 1 ? "" : " ");
         }
@@ -123,22 +226,43 @@ void MatrixFactorization::save_vectors(const string& filepath) const {
     }
 
     out_file.close();
+    if (!out_file) {
+        cerr << "Error: fallo la escritura de los vectores en " << tmp_path << endl;
+        return false;
+    }
+    error_code ec;
+    filesystem::rename(tmp_path, filepath, ec);
+    if (ec) {
+        cerr << "Error: no se pudo reemplazar " << filepath << ": " << ec.message() << endl;
+        return false;
+    }
     cout << "Vectores del modelo BPR guardados en: " << filepath << endl;
+    return true;
 }
 
-bool MatrixFactorization::load_vectors(const string& filepath) {
+bool MatrixFactorization::load_vectors(const string& filepath, uint64_t catalog_fingerprint) {
     ifstream in_file(filepath);
     if (!in_file.is_open()) {
         return false; 
     }
 
-    size_t num_users, num_items, file_d;
-    in_file >> num_users >> num_items >> file_d;
+    // Cabecera: usuarios, items, dimensión y, desde que existe, la huella del
+    // catálogo (los archivos viejos no la tienen).
+    string header;
+    getline(in_file, header);
+    istringstream header_stream(header);
+    size_t num_users = 0, num_items = 0, file_d = 0;
+    uint64_t file_fingerprint = 0;
+    header_stream >> num_users >> num_items >> file_d >> file_fingerprint;
 
     if (file_d != d || num_users != user_vectors.size() || num_items != item_vectors.size()) {
         cerr << "Error: Las dimensiones del archivo no coinciden con las del modelo. Se re-entrenara." << endl;
         return false;
     }
+    if (catalog_fingerprint != 0 && file_fingerprint != 0 && file_fingerprint != catalog_fingerprint) {
+        cerr << "Error: los vectores de " << filepath << " corresponden a otro orden de usuarios o items. Se re-entrenara." << endl;
+        return false;
+    }
 
     for (size_t i = 0; i < num_users; ++i) {
         for (size_t j = 0; j < d; ++j) {
@@ -152,6 +276,12 @@ bool MatrixFactorization::load_vectors(const string& filepath) {
         }
     }
 
+    // Un archivo truncado (p. ej. copiado a mano mientras se escribía) deja el
+    // stream en error: no se devuelven vectores a medias.
+    if (!in_file) {
+        cerr << "Error: el archivo de vectores " << filepath << " esta incompleto." << endl;
+        return false;
+    }
     in_file.close();
     cout << "Vectores del modelo BPR cargados desde: " << filepath << endl;
     return true;
@@ -0,0 +1,238 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "MatrixFactorization.h"
+#include "SRPRModel.h"
+#include "lsh.h"
+
+using namespace std;
+
+// Un modelo junto con su índice LSH. Se construye una vez y después solo se
+// lee, así que puede compartirse entre hilos sin sincronización adicional.
+template <typename ModelType>
+struct ServingIndex {
+    ServingIndex(string name, int num_users, int num_items, int dimensions, int lsh_tables, int lsh_hash_size)
+        : name(move(name)),
+          model(num_users, num_items, dimensions),
+          lsh(lsh_tables, lsh_hash_size, dimensions),
+          index(lsh) {}
+    ServingIndex(const ServingIndex&) = delete;
+    ServingIndex& operator=(const ServingIndex&) = delete;
+
+    // Reutiliza el índice persistido si corresponde a los vectores actuales.
+    void build_index() {
+        index.build_or_load(model.get_item_vectors(), lsh_index_path(name, lsh.num_tables(), lsh.hash_size()));
+    }
+
+    string name;
+    ModelType model;
+    SignedRandomProjectionLSH lsh;
+    LSHIndex index;
+};
+
+using BprServing = ServingIndex<MatrixFactorization>;
+using SrprServing = ServingIndex<SRPRModel>;
+
+// Una versión de lo que sirve el App: los modelos junto con el DataManager
+// cuyos índices internos usan. Cualquiera puede ser nulo mientras el arranque
+// todavía lo está construyendo; el DataManager se publica antes que los modelos.
+struct ServingModels {
+    uint64_t version = 0;
+    shared_ptr<const DataManager> data;
+    shared_ptr<BprServing> bpr;
+    shared_ptr<SrprServing> srpr;
+};
+
+// Puntero estilo RCU a la versión activa de ServingModels. Los lectores toman
+// una referencia con current() y terminan su consulta sobre esa versión aunque
+// entre tanto se publique otra; la versión vieja se libera con el último lector.
+class ModelStore {
+public:
+    // dataset y max_triplets_per_user son los del DataManager del arranque; las
+    // recargas vuelven a leer su cache. index_prefix distingue los índices
+    // persistidos de cada conjunto de datos.
+    ModelStore(DatasetOptions dataset, int max_triplets_per_user, int dimensions, int lsh_tables, int lsh_hash_size,
+               string bpr_vectors_path, string srpr_vectors_path, string index_prefix = "");
+    ~ModelStore();
+
+    // Publica el DataManager ya inicializado; los modelos de make_bpr/make_srpr
+    // toman su tamaño de él.
+    void set_data(shared_ptr<const DataManager> data);
+
+    // Nunca es nulo; antes de publicar algo devuelve una versión vacía.
+    shared_ptr<const ServingModels> current() const { return current_.load(memory_order_acquire); }
+    shared_ptr<BprServing> make_bpr() const { return make_bpr(*current()->data); }
+    shared_ptr<SrprServing> make_srpr() const { return make_srpr(*current()->data); }
+    // Publican una versión nueva reemplazando lo que no sea nulo.
+    void publish(shared_ptr<BprServing> bpr, shared_ptr<SrprServing> srpr, shared_ptr<const DataManager> data = nullptr);
+    void publish_bpr(shared_ptr<BprServing> bpr);
+    void publish_srpr(shared_ptr<SrprServing> srpr);
+
+    // Relee el cache del DataManager, carga los vectores (que deben tener su
+    // huella de catálogo) y construye los índices en un hilo aparte; los tres
+    // se publican juntos, así que un catálogo que creció (incrementalTrain) o
+    // se reordenó (reorderItems) se sirve sin reiniciar. Devuelve false si ya
+    // había una recarga en curso.
+    bool reload_async();
+    bool is_reloading() const { return reloading_.load(); }
+    string last_reload_status() const;
+
+    // Revisa periódicamente la fecha de modificación de los archivos de vectores
+    // y lanza una recarga cuando ambos cambiaron de versión.
+    void watch_files(chrono::seconds interval);
+
+private:
+    DatasetOptions dataset_;
+    int max_triplets_per_user_;
+    int dimensions_, lsh_tables_, lsh_hash_size_;
+    string bpr_vectors_path_, srpr_vectors_path_, index_prefix_;
+
+    atomic<shared_ptr<const ServingModels>> current_;
+    mutex publish_mutex_; // serializa a los escritores; los lectores nunca lo toman
+    uint64_t next_version_ = 1;
+    atomic<bool> reloading_{false};
+    thread reload_thread_;
+    jthread watcher_thread_;
+    mutable mutex status_mutex_;
+    string last_status_ = "sin recargas";
+
+    shared_ptr<BprServing> make_bpr(const DataManager& data) const;
+    shared_ptr<SrprServing> make_srpr(const DataManager& data) const;
+    void reload();
+    void set_status(const string& status);
+};
+
+ModelStore::ModelStore(DatasetOptions dataset, int max_triplets_per_user, int dimensions, int lsh_tables,
+                       int lsh_hash_size, string bpr_vectors_path, string srpr_vectors_path, string index_prefix)
+    : dataset_(move(dataset)), max_triplets_per_user_(max_triplets_per_user), dimensions_(dimensions), lsh_tables_(lsh_tables), lsh_hash_size_(lsh_hash_size),
+      bpr_vectors_path_(move(bpr_vectors_path)), srpr_vectors_path_(move(srpr_vectors_path)),
+      index_prefix_(move(index_prefix)),
+      current_(make_shared<const ServingModels>()) {}
+
+void ModelStore::set_data(shared_ptr<const DataManager> data) {
+    publish(nullptr, nullptr, move(data));
+}
+
+ModelStore::~ModelStore() {
+    if (watcher_thread_.joinable()) {
+        watcher_thread_.request_stop();
+        watcher_thread_.join();
+    }
+    if (reload_thread_.joinable()) reload_thread_.join();
+}
+
+shared_ptr<BprServing> ModelStore::make_bpr(const DataManager& data) const {
+    return make_shared<BprServing>(index_prefix_ + "bpr", data.get_num_users(), data.get_num_items(), dimensions_,
+                                   lsh_tables_, lsh_hash_size_);
+}
+
+shared_ptr<SrprServing> ModelStore::make_srpr(const DataManager& data) const {
+    return make_shared<SrprServing>(index_prefix_ + "srpr", data.get_num_users(), data.get_num_items(), dimensions_,
+                                    lsh_tables_, lsh_hash_size_);
+}
+
+void ModelStore::publish(shared_ptr<BprServing> bpr, shared_ptr<SrprServing> srpr, shared_ptr<const DataManager> data) {
+    lock_guard<mutex> lock(publish_mutex_);
+    auto models = make_shared<ServingModels>(*current_.load());
+    if (data) models->data = move(data);
+    if (bpr) models->bpr = move(bpr);
+    if (srpr) models->srpr = move(srpr);
+    models->version = next_version_++;
+    current_.store(move(models), memory_order_release);
+}
+
+void ModelStore::publish_bpr(shared_ptr<BprServing> bpr) {
+    publish(move(bpr), nullptr);
+}
+
+void ModelStore::publish_srpr(shared_ptr<SrprServing> srpr) {
+    publish(nullptr, move(srpr));
+}
+
+bool ModelStore::reload_async() {
+    bool expected = false;
+    if (!reloading_.compare_exchange_strong(expected, true)) return false;
+    // El hilo anterior ya terminó (reloading_ estaba en false), solo falta recogerlo.
+    if (reload_thread_.joinable()) reload_thread_.join();
+    reload_thread_ = thread([this] {
+        reload();
+        reloading_.store(false);
+    });
+    return true;
+}
+
+void ModelStore::reload() {
+    auto start = chrono::steady_clock::now();
+    cout << "--- Recargando vectores en segundo plano ---" << endl;
+    // El cache confirmado es el que corresponde a los vectores publicados:
+    // incrementalTrain y reorderItems lo reemplazan antes que los vectores.
+    auto data = make_shared<DataManager>(dataset_.ratings_path, dataset_.max_ratings, max_triplets_per_user_);
+    data->init();
+    if (data->get_training_triplets().empty()) {
+        cerr << "Error: no se pudo recargar el cache del DataManager, se mantiene la version actual." << endl;
+        set_status("error: no se pudo cargar el cache del DataManager");
+        return;
+    }
+    const uint64_t catalog_fingerprint = data->catalog_fingerprint();
+    auto bpr = make_bpr(*data);
+    auto srpr = make_srpr(*data);
+    if (!bpr->model.load_vectors(bpr_vectors_path_, catalog_fingerprint)) {
+        cerr << "Error: no se pudo recargar " << bpr_vectors_path_ << ", se mantiene la version actual." << endl;
+        set_status("error: no se pudo cargar " + bpr_vectors_path_);
+        return;
+    }
+    if (!srpr->model.load_vectors(srpr_vectors_path_, catalog_fingerprint)) {
+        cerr << "Error: no se pudo recargar " << srpr_vectors_path_ << ", se mantiene la version actual." << endl;
+        set_status("error: no se pudo cargar " + srpr_vectors_path_);
+        return;
+    }
+    bpr->build_index();
+    srpr->build_index();
+    publish(move(bpr), move(srpr), move(data));
+
+    uint64_t version = current()->version;
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    set_status("version " + to_string(version) + " publicada en " + to_string(elapsed.count()) + " ms");
+    cout << "--- Nueva version " << version << " publicada ---" << endl;
+}
+
+void ModelStore::watch_files(chrono::seconds interval) {
+    watcher_thread_ = jthread([this, interval](stop_token stop) {
+        error_code ec;
+        auto bpr_time = filesystem::last_write_time(bpr_vectors_path_, ec);
+        auto srpr_time = filesystem::last_write_time(srpr_vectors_path_, ec);
+        mutex wait_mutex;
+        condition_variable_any wake;
+        while (true) {
+            // Espera interrumpible: el destructor no tiene que esperar el intervalo completo.
+            unique_lock<mutex> lock(wait_mutex);
+            wake.wait_for(lock, stop, interval, [] { return false; });
+            if (stop.stop_requested()) break;
+            auto new_bpr_time = filesystem::last_write_time(bpr_vectors_path_, ec);
+            if (ec) continue;
+            auto new_srpr_time = filesystem::last_write_time(srpr_vectors_path_, ec);
+            if (ec) continue;
+            // Se espera a que ambos archivos sean nuevos para no mezclar versiones.
+            if (new_bpr_time != bpr_time && new_srpr_time != srpr_time && reload_async()) {
+                bpr_time = new_bpr_time;
+                srpr_time = new_srpr_time;
+            }
+        }
+    });
+}
+
+string ModelStore::last_reload_status() const {
+    lock_guard<mutex> lock(status_mutex_);
+    return last_status_;
+}
+
+void ModelStore::set_status(const string& status) {
+    lock_guard<mutex> lock(status_mutex_);
+    last_status_ = status;
+}
@@ -0,0 +1,459 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "lsh.h"
+#include "matrix.h"
+
+using namespace std;
+
+// Índice LSH que admite altas, cambios y bajas de items mientras se consulta.
+//
+// Los lectores trabajan sobre una instantánea publicada estilo RCU (como
+// ModelStore): una base congelada (LSHIndex) con los items que había en la
+// última compactación, un segmento delta de solo-agregar con lo escrito
+// después, y un estado atómico por id que dice dónde está su versión vigente:
+//   kAbsent -> nunca se insertó o se borró (lápida sobre la copia de la base)
+//   kInBase -> la versión vigente es la de la base
+//   k >= 0  -> la versión vigente es la entrada k del delta
+// Los escritores se serializan con un mutex que los lectores nunca toman:
+// escriben la entrada del delta, publican el contador con release y recién
+// después apuntan el estado del id a ella, así que un lector que ve el estado
+// nuevo ve también la entrada completa. Las copias viejas de un id siguen en
+// la base o en el delta, pero ya no coinciden con su estado y se descartan.
+// Las consultas recorren la base antes de leer el contador del delta, así un
+// id que se mueve durante la consulta aparece en su versión vieja o la nueva.
+//
+// compact() reconstruye la base con los items vivos fuera del mutex y al final
+// traspasa lo que se escribió mientras tanto; puede llamarse a mano o dejarse
+// a un hilo en segundo plano (start_background_compaction).
+class MutableLSHIndex {
+public:
+    MutableLSHIndex(int num_tables, int hash_size, int dimension, uint64_t seed = 42, size_t delta_capacity = 4096);
+    ~MutableLSHIndex() { stop_background_compaction(); }
+    MutableLSHIndex(const MutableLSHIndex&) = delete;
+    MutableLSHIndex& operator=(const MutableLSHIndex&) = delete;
+
+    // Carga inicial: el item i recibe el id i y todo va a la base congelada.
+    void build(const EmbeddingMatrix& items);
+
+    // Alta o reemplazo del vector de item_id (>= 0). Las consultas que empiecen
+    // después de que vuelva ya lo ven.
+    void upsert(int item_id, const Vec& item_vector);
+    // Baja de item_id; false si no existía.
+    bool remove(int item_id);
+
+    // Mismo contrato que LSHIndex::find_neighbors (ids de item, de mayor a
+    // menor similitud). Nunca espera a un escritor ni a una compactación.
+    vector<pair<int, double>> find_neighbors(ConstVecView query_vector, int max_results = 10,
+                                             LSHQueryStats* stats = nullptr) const;
+
+    // Rehace la base con los items vivos y vacía el delta. Las consultas y las
+    // escrituras siguen mientras tanto; dos compactaciones no se solapan.
+    void compact();
+
+    // Compacta en un hilo aparte cuando pending_writes() llega a
+    // max(min_writes, ratio * items de la base). Revisa cada interval y
+    // también cuando una escritura cruza el umbral. Se llama antes de empezar
+    // a escribir desde otros hilos, no durante.
+    void start_background_compaction(chrono::milliseconds interval, size_t min_writes = 1024, double ratio = 0.1);
+    void stop_background_compaction();
+
+    // Buckets por tabla en base y delta; se aplica desde la próxima base
+    // (build() o compactación), no a la que ya se está consultando.
+    void set_num_probes(int num_probes) { num_probes_.store(max(1, num_probes)); }
+    // Silencia el mensaje de cada compactación.
+    void set_verbose(bool verbose) { verbose_.store(verbose); }
+
+    size_t size() const { return live_items_.load(); }
+    // Entradas del delta más copias de la base que ya no son la vigente.
+    size_t pending_writes() const;
+    uint64_t compactions() const { return compactions_.load(); }
+
+private:
+    static constexpr int32_t kAbsent = -1;
+    static constexpr int32_t kInBase = -2;
+
+    // Estado por id con capacidad fija; para crecer se copia a uno nuevo.
+    struct IdStates {
+        explicit IdStates(size_t capacity) : capacity(capacity), slots(new atomic<int32_t>[capacity]) {
+            for (size_t i = 0; i < capacity; ++i) slots[i].store(kAbsent, memory_order_relaxed);
+        }
+        int32_t get(int item_id) const {
+            return static_cast<size_t>(item_id) < capacity ? slots[item_id].load(memory_order_acquire) : kAbsent;
+        }
+        size_t capacity;
+        unique_ptr<atomic<int32_t>[]> slots;
+    };
+
+    // Entradas de solo-agregar con capacidad fija: los lectores recorren
+    // [0, count) y el único escritor solo toca posiciones >= count.
+    struct DeltaSegment {
+        DeltaSegment(size_t capacity, size_t dimension, int num_tables)
+            : capacity(capacity), ids(capacity), norms(capacity), vectors(capacity * dimension),
+              codes(capacity * num_tables) {}
+        size_t capacity;
+        vector<int> ids;
+        vector<double> norms;
+        vector<double> vectors;  // capacity x dimension, fila-mayor
+        vector<uint64_t> codes;  // capacity x num_tables
+        atomic<size_t> count{0};
+    };
+
+    struct Base {
+        Base(SignedRandomProjectionLSH& lsh) : index(lsh) {}
+        LSHIndex index;
+        vector<int> ids;  // id denso de la base -> id del item
+        int num_probes = 1;
+    };
+
+    struct Snapshot {
+        shared_ptr<Base> base;
+        shared_ptr<DeltaSegment> delta;
+        shared_ptr<IdStates> states;
+    };
+
+    SignedRandomProjectionLSH lsh_;  // los mismos planos para todas las bases y el delta
+    size_t dimension_;
+    size_t delta_capacity_;
+    atomic<int> num_probes_{1};
+    atomic<bool> verbose_{true};
+
+    atomic<shared_ptr<const Snapshot>> current_;
+    mutex write_mutex_;       // serializa a los escritores; los lectores nunca lo toman
+    mutex compaction_mutex_;  // una compactación a la vez
+    // Copia de los vectores vigentes (bajo write_mutex_), para compactar.
+    vector<Vec> items_;
+    vector<char> live_;
+    atomic<size_t> live_items_{0};
+    atomic<size_t> stale_base_entries_{0};
+    atomic<uint64_t> compactions_{0};
+
+    jthread compaction_thread_;
+    mutex wake_mutex_;
+    condition_variable_any wake_;
+    size_t compaction_min_writes_ = 1024;
+    double compaction_ratio_ = 0.1;
+
+    shared_ptr<Base> build_base(const EmbeddingMatrix& items, vector<int> ids);
+    shared_ptr<const Snapshot> grow(const shared_ptr<const Snapshot>& snapshot, int item_id);
+    void store_item(int item_id, const Vec& item_vector);
+    bool compaction_due() const;
+    void wake_compaction() {
+        if (compaction_thread_.joinable() && compaction_due()) wake_.notify_one();
+    }
+};
+
+inline MutableLSHIndex::MutableLSHIndex(int num_tables, int hash_size, int dimension, uint64_t seed,
+                                        size_t delta_capacity)
+    : lsh_(num_tables, hash_size, dimension, seed), dimension_(dimension), delta_capacity_(max<size_t>(1, delta_capacity)) {
+    if (hash_size > 64) throw invalid_argument("MutableLSHIndex: hasta 64 bits por tabla.");
+    auto snapshot = make_shared<Snapshot>();
+    snapshot->base = build_base({}, {});
+    snapshot->delta = make_shared<DeltaSegment>(delta_capacity_, dimension_, num_tables);
+    snapshot->states = make_shared<IdStates>(0);
+    current_.store(move(snapshot));
+}
+
+inline shared_ptr<MutableLSHIndex::Base> MutableLSHIndex::build_base(const EmbeddingMatrix& items, vector<int> ids) {
+    auto base = make_shared<Base>(lsh_);
+    base->index.set_verbose(false);
+    base->num_probes = num_probes_.load();
+    base->index.set_num_probes(base->num_probes);
+    base->index.build(items);
+    base->ids = move(ids);
+    return base;
+}
+
+inline void MutableLSHIndex::build(const EmbeddingMatrix& items) {
+    if (!items.empty() && items.dimension() != dimension_) {
+        throw invalid_argument("MutableLSHIndex: dimension de item incorrecta.");
+    }
+    lock_guard<mutex> compaction_lock(compaction_mutex_);
+    vector<int> ids(items.size());
+    iota(ids.begin(), ids.end(), 0);
+    auto snapshot = make_shared<Snapshot>();
+    snapshot->base = build_base(items, move(ids));
+    snapshot->delta = make_shared<DeltaSegment>(delta_capacity_, dimension_, lsh_.num_tables());
+    snapshot->states = make_shared<IdStates>(items.size() + items.size() / 4);
+    for (size_t i = 0; i < items.size(); ++i) snapshot->states->slots[i].store(kInBase, memory_order_relaxed);
+
+    lock_guard<mutex> lock(write_mutex_);
+    items_.clear();
+    items_.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i) items_.emplace_back(items[i]);
+    live_.assign(items.size(), 1);
+    live_items_.store(items.size());
+    stale_base_entries_.store(0);
+    current_.store(move(snapshot), memory_order_release);
+}
+
+inline shared_ptr<const MutableLSHIndex::Snapshot> MutableLSHIndex::grow(const shared_ptr<const Snapshot>& snapshot,
+                                                                         int item_id) {
+    // Nueva instantánea con más lugar; la vieja queda intacta para quien la
+    // esté leyendo. Las posiciones del delta se conservan.
+    const DeltaSegment& old_delta = *snapshot->delta;
+    const IdStates& old_states = *snapshot->states;
+    const size_t count = old_delta.count.load(memory_order_relaxed);
+    const int num_tables = lsh_.num_tables();
+
+    auto grown = make_shared<Snapshot>();
+    grown->base = snapshot->base;
+    size_t delta_capacity = count < old_delta.capacity ? old_delta.capacity : 2 * old_delta.capacity;
+    grown->delta = make_shared<DeltaSegment>(delta_capacity, dimension_, num_tables);
+    copy_n(old_delta.ids.begin(), count, grown->delta->ids.begin());
+    copy_n(old_delta.norms.begin(), count, grown->delta->norms.begin());
+    copy_n(old_delta.vectors.begin(), count * dimension_, grown->delta->vectors.begin());
+    copy_n(old_delta.codes.begin(), count * num_tables, grown->delta->codes.begin());
+    grown->delta->count.store(count, memory_order_relaxed);
+
+    size_t id_capacity = old_states.capacity;
+    if (static_cast<size_t>(item_id) >= id_capacity) id_capacity = max<size_t>(static_cast<size_t>(item_id) + 1, 2 * id_capacity);
+    grown->states = make_shared<IdStates>(id_capacity);
+    for (size_t i = 0; i < old_states.capacity; ++i) {
+        grown->states->slots[i].store(old_states.slots[i].load(memory_order_relaxed), memory_order_relaxed);
+    }
+    shared_ptr<const Snapshot> published = grown;
+    current_.store(published, memory_order_release);
+    return published;
+}
+
+inline void MutableLSHIndex::store_item(int item_id, const Vec& item_vector) {
+    if (static_cast<size_t>(item_id) >= items_.size()) {
+        items_.resize(item_id + 1);
+        live_.resize(item_id + 1, 0);
+    }
+    items_[item_id] = item_vector;
+    live_[item_id] = 1;
+}
+
+inline void MutableLSHIndex::upsert(int item_id, const Vec& item_vector) {
+    if (item_id < 0) throw invalid_argument("MutableLSHIndex: id de item negativo.");
+    if (item_vector.getDimension() != dimension_) throw invalid_argument("MutableLSHIndex: dimension de item incorrecta.");
+    // Los códigos no dependen del estado del índice: se calculan fuera del mutex.
+    const int num_tables = lsh_.num_tables();
+    vector<uint64_t> codes(num_tables);
+    for (int t = 0; t < num_tables; ++t) codes[t] = lsh_.hash_code(item_vector.data(), t);
+    const double norm = item_vector.magnitude();
+    {
+        lock_guard<mutex> lock(write_mutex_);
+        auto snapshot = current_.load(memory_order_acquire);
+        if (static_cast<size_t>(item_id) >= snapshot->states->capacity ||
+            snapshot->delta->count.load(memory_order_relaxed) == snapshot->delta->capacity) {
+            snapshot = grow(snapshot, item_id);
+        }
+        DeltaSegment& delta = *snapshot->delta;
+        const size_t position = delta.count.load(memory_order_relaxed);
+        delta.ids[position] = item_id;
+        delta.norms[position] = norm;
+        copy(item_vector.data(), item_vector.data() + dimension_, delta.vectors.begin() + position * dimension_);
+        copy(codes.begin(), codes.end(), delta.codes.begin() + position * num_tables);
+        delta.count.store(position + 1, memory_order_release);
+
+        int32_t previous = snapshot->states->slots[item_id].exchange(static_cast<int32_t>(position), memory_order_acq_rel);
+        if (previous == kInBase) stale_base_entries_++;
+        if (previous == kAbsent) live_items_++;
+        store_item(item_id, item_vector);
+    }
+    wake_compaction();
+}
+
+inline bool MutableLSHIndex::remove(int item_id) {
+    {
+        lock_guard<mutex> lock(write_mutex_);
+        auto snapshot = current_.load(memory_order_acquire);
+        if (snapshot->states->get(item_id) == kAbsent) return false;
+        int32_t previous = snapshot->states->slots[item_id].exchange(kAbsent, memory_order_acq_rel);
+        if (previous == kInBase) stale_base_entries_++;
+        live_items_--;
+        items_[item_id] = Vec();
+        live_[item_id] = 0;
+    }
+    wake_compaction();
+    return true;
+}
+
+inline vector<pair<int, double>> MutableLSHIndex::find_neighbors(ConstVecView query_vector, int max_results,
+                                                                 LSHQueryStats* stats) const {
+    auto snapshot = current_.load(memory_order_acquire);
+    Base& base = *snapshot->base;
+    const IdStates& states = *snapshot->states;
+    const DeltaSegment& delta = *snapshot->delta;
+
+    // 1. Base: se descartan antes de puntuar las copias que ya no son la
+    // vigente.
+    auto base_results = base.index.find_neighbors_if(query_vector, max_results, [&](int base_id) {
+        return states.get(base.ids[base_id]) == kInBase;
+    }, stats);
+
+    // 2. Delta, con el contador leído después de la base: un id que un
+    // escritor sacó de la base mientras se la recorría ya tiene su entrada
+    // en [0, count). Recorrido lineal de las entradas vigentes que caen en
+    // algún bucket de la consulta; es chico (se compacta antes de que crezca).
+    vector<pair<int, double>> similarities;
+    vector<int> delta_ids;  // ids con versión visible en el delta, caigan o no en la consulta
+    const size_t count = delta.count.load(memory_order_acquire);
+    if (count > 0) {
+        const int num_tables = lsh_.num_tables();
+        const int hash_size = lsh_.hash_size();
+        const size_t codes_per_table = base.num_probes;
+        vector<uint64_t> probe_codes(num_tables * codes_per_table);
+        vector<double> margins(hash_size);
+        vector<uint64_t> table_codes;
+        for (int t = 0; t < num_tables; ++t) {
+            uint64_t code = lsh_.hash_code(query_vector.data(), t, margins.data());
+            multiprobe_codes(code, margins.data(), hash_size, base.num_probes, table_codes);
+            table_codes.resize(codes_per_table, table_codes.back());
+            copy(table_codes.begin(), table_codes.end(), probe_codes.begin() + t * codes_per_table);
+        }
+        const double query_norm = query_vector.magnitude();
+        for (size_t position = 0; position < count; ++position) {
+            const int item_id = delta.ids[position];
+            const int32_t state = states.get(item_id);
+            if (state != static_cast<int32_t>(position)) {
+                // Si el estado ya apunta más allá de count (una escritura
+                // posterior), vale la última entrada del id que sí se ve.
+                if (state < 0 || static_cast<size_t>(state) < count) continue;
+                if (find(delta.ids.begin() + position + 1, delta.ids.begin() + count, item_id) !=
+                    delta.ids.begin() + count) {
+                    continue;
+                }
+            }
+            delta_ids.push_back(item_id);
+            const uint64_t* item_codes = delta.codes.data() + position * num_tables;
+            bool match = false;
+            for (int t = 0; t < num_tables && !match; ++t) {
+                const uint64_t* begin = probe_codes.data() + t * codes_per_table;
+                match = find(begin, begin + codes_per_table, item_codes[t]) != begin + codes_per_table;
+            }
+            if (!match) continue;
+            double dot_product = dot(delta.vectors.data() + position * dimension_, query_vector.data(), dimension_);
+            similarities.push_back({item_id, dot_product / (query_norm * delta.norms[position])});
+        }
+    }
+    const size_t delta_candidates = similarities.size();
+
+    // 3. Un id que pasó de la base al delta durante esta consulta se queda
+    // solo con la versión del delta.
+    sort(delta_ids.begin(), delta_ids.end());
+    for (const auto& [base_id, similarity] : base_results) {
+        const int item_id = base.ids[base_id];
+        if (!binary_search(delta_ids.begin(), delta_ids.end(), item_id)) similarities.push_back({item_id, similarity});
+    }
+
+    sort(similarities.begin(), similarities.end(),
+         [](const pair<int, double>& a, const pair<int, double>& b) { return a.second > b.second; });
+    if (similarities.size() > static_cast<size_t>(max(0, max_results))) similarities.resize(max(0, max_results));
+    if (stats) {
+        stats->num_candidates += delta_candidates;
+        stats->num_rescored += delta_candidates;
+    }
+    return similarities;
+}
+
+inline void MutableLSHIndex::compact() {
+    lock_guard<mutex> compaction_lock(compaction_mutex_);
+    auto start = chrono::steady_clock::now();
+
+    // 1. Foto de los items vivos y de hasta dónde llegaba el delta.
+    EmbeddingMatrix items;
+    vector<int> ids;
+    size_t mark = 0;
+    {
+        lock_guard<mutex> lock(write_mutex_);
+        mark = current_.load(memory_order_acquire)->delta->count.load(memory_order_relaxed);
+        for (size_t id = 0; id < live_.size(); ++id) {
+            if (live_[id]) ids.push_back(static_cast<int>(id));
+        }
+        items = EmbeddingMatrix(ids.size(), dimension_);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            copy(items_[ids[i]].data(), items_[ids[i]].data() + dimension_, items.row(i));
+        }
+    }
+
+    // 2. La base nueva se construye sin bloquear a nadie.
+    auto base = build_base(items, ids);
+    items = EmbeddingMatrix();
+
+    // 3. Traspaso: lo escrito desde la foto (posiciones >= mark) pasa a un
+    // delta nuevo; lo borrado desde la foto queda como lápida sobre la base.
+    {
+        lock_guard<mutex> lock(write_mutex_);
+        auto current = current_.load(memory_order_acquire);
+        const DeltaSegment& old_delta = *current->delta;
+        const IdStates& old_states = *current->states;
+        const int num_tables = lsh_.num_tables();
+        const size_t carried = old_delta.count.load(memory_order_relaxed) - mark;
+
+        auto snapshot = make_shared<Snapshot>();
+        snapshot->base = move(base);
+        snapshot->delta = make_shared<DeltaSegment>(max(delta_capacity_, 2 * carried), dimension_, num_tables);
+        snapshot->states = make_shared<IdStates>(old_states.capacity);
+        DeltaSegment& delta = *snapshot->delta;
+        vector<char> in_base(old_states.capacity, 0);
+        for (int id : ids) in_base[id] = 1;
+        size_t count = 0, stale = 0;
+        for (size_t id = 0; id < old_states.capacity; ++id) {
+            int32_t state = old_states.slots[id].load(memory_order_relaxed);
+            if (state >= 0 && static_cast<size_t>(state) >= mark) {
+                delta.ids[count] = static_cast<int>(id);
+                delta.norms[count] = old_delta.norms[state];
+                copy_n(old_delta.vectors.begin() + state * dimension_, dimension_, delta.vectors.begin() + count * dimension_);
+                copy_n(old_delta.codes.begin() + state * num_tables, num_tables, delta.codes.begin() + count * num_tables);
+                state = static_cast<int32_t>(count++);
+                if (in_base[id]) stale++;
+            } else if (state == kAbsent) {
+                if (in_base[id]) stale++;
+            } else {
+                state = kInBase;  // sin cambios desde la foto: está en la base nueva
+            }
+            snapshot->states->slots[id].store(state, memory_order_relaxed);
+        }
+        delta.count.store(count, memory_order_relaxed);
+        stale_base_entries_.store(stale);
+        current_.store(move(snapshot), memory_order_release);
+    }
+    compactions_++;
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    if (verbose_) cout << "Indice mutable compactado: " << ids.size() << " items en la base en " << elapsed.count() << " ms." << endl;
+}
+
+inline size_t MutableLSHIndex::pending_writes() const {
+    return current_.load(memory_order_acquire)->delta->count.load(memory_order_relaxed) + stale_base_entries_.load();
+}
+
+inline bool MutableLSHIndex::compaction_due() const {
+    auto snapshot = current_.load(memory_order_acquire);
+    size_t pending = snapshot->delta->count.load(memory_order_relaxed) + stale_base_entries_.load();
+    return pending > 0 && pending >= max(compaction_min_writes_, static_cast<size_t>(compaction_ratio_ * snapshot->base->ids.size()));
+}
+
+inline void MutableLSHIndex::start_background_compaction(chrono::milliseconds interval, size_t min_writes, double ratio) {
+    stop_background_compaction();
+    compaction_min_writes_ = max<size_t>(1, min_writes);
+    compaction_ratio_ = ratio;
+    compaction_thread_ = jthread([this, interval](stop_token stop) {
+        while (true) {
+            {
+                // Espera interrumpible, como el vigía de ModelStore.
+                unique_lock<mutex> lock(wake_mutex_);
+                wake_.wait_for(lock, stop, interval, [this] { return compaction_due(); });
+            }
+            if (stop.stop_requested()) break;
+            if (compaction_due()) compact();
+        }
+    });
+}
+
+inline void MutableLSHIndex::stop_background_compaction() {
+    if (compaction_thread_.joinable()) {
+        compaction_thread_.request_stop();
+        compaction_thread_.join();
+    }
+}
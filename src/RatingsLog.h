@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "DataManager.h"
+#include "Triplet.h"
+
+using namespace std;
+
+// Lectura incremental de un log de ratings de solo-agregar (mismo formato que
+// ratings.csv) y el punto de control del entrenamiento incremental: hasta qué
+// byte del log ya se incorporó a los modelos y qué versión se emitió.
+struct IncrementalState {
+    uint64_t log_offset = 0;
+    uint64_t version = 0;
+    uint64_t ratings_seen = 0;  // ratings incorporados desde el entrenamiento completo
+};
+
+inline string incremental_state_path(const string& ratings_path) {
+    return "../data/" + dataset_prefix(ratings_path) + "incremental.state";
+}
+
+// Cada versión incremental reescribe varios archivos (vectores y cache). Se
+// preparan primero como <archivo>.v<version>; guardar el estado con esa
+// versión es el punto de confirmación, y recién después se renombran a su
+// lugar. Si la corrida se corta antes del estado, la próxima repite el lote
+// sobre los archivos viejos; si se corta después, los renombres pendientes se
+// terminan con publish_incremental_version.
+inline string incremental_staged_path(const string& filepath, uint64_t version) {
+    return filepath + ".v" + to_string(version);
+}
+
+// Renombra a su lugar lo preparado para la versión ya confirmada y descarta
+// lo de una versión siguiente que no llegó a confirmarse. Es idempotente:
+// se llama al confirmar y al empezar cada corrida.
+inline bool publish_incremental_version(const vector<string>& filepaths, uint64_t version) {
+    for (const string& filepath : filepaths) {
+        error_code ec;
+        filesystem::remove(incremental_staged_path(filepath, version + 1), ec);
+        const string staged_path = incremental_staged_path(filepath, version);
+        if (!filesystem::exists(staged_path, ec)) continue;
+        filesystem::rename(staged_path, filepath, ec);
+        if (ec) {
+            cerr << "Error: no se pudo reemplazar " << filepath << ": " << ec.message() << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr char INCREMENTAL_STATE_MAGIC[8] = {'S', 'R', 'P', 'R', 'I', 'N', 'C', 'R'};
+constexpr uint32_t INCREMENTAL_STATE_VERSION = 1;
+
+// Se escribe a un temporal y se renombra: un corte a mitad de escritura deja
+// el estado anterior, nunca uno a medias.
+inline bool save_incremental_state(const string& filepath, const IncrementalState& state) {
+    const string tmp_path = filepath + ".tmp";
+    {
+        ofstream out_file(tmp_path, ios::binary);
+        if (!out_file.is_open()) {
+            cerr << "Error: No se pudo abrir el archivo para guardar el estado incremental: " << tmp_path << endl;
+            return false;
+        }
+        out_file.write(INCREMENTAL_STATE_MAGIC, sizeof(INCREMENTAL_STATE_MAGIC));
+        out_file.write(reinterpret_cast<const char*>(&INCREMENTAL_STATE_VERSION), sizeof(uint32_t));
+        out_file.write(reinterpret_cast<const char*>(&state), sizeof(state));
+        if (!out_file) {
+            cerr << "Error: fallo la escritura del estado incremental en " << tmp_path << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmp_path, filepath, ec);
+    if (ec) {
+        cerr << "Error: no se pudo reemplazar " << filepath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool load_incremental_state(const string& filepath, IncrementalState& state) {
+    ifstream in_file(filepath, ios::binary);
+    if (!in_file.is_open()) return false;
+    char magic[8];
+    uint32_t version = 0;
+    IncrementalState loaded;
+    if (!in_file.read(magic, sizeof(magic)) || !equal(begin(magic), end(magic), INCREMENTAL_STATE_MAGIC) ||
+        !in_file.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != INCREMENTAL_STATE_VERSION ||
+        !in_file.read(reinterpret_cast<char*>(&loaded), sizeof(loaded))) {
+        cerr << "Error: " << filepath << " no es un estado incremental valido." << endl;
+        return false;
+    }
+    state = loaded;
+    return true;
+}
+
+// Byte donde empieza la fila de datos número rows (sin contar la cabecera),
+// o el final del archivo si tiene menos filas o rows == -1. Es el punto de
+// partida del log cuando los modelos se entrenaron con las primeras rows filas.
+inline uint64_t csv_offset_after_rows(const string& filepath, long long rows) {
+    ifstream file(filepath, ios::binary);
+    if (!file.is_open()) return 0;
+    if (rows < 0) {
+        file.seekg(0, ios::end);
+        return static_cast<uint64_t>(file.tellg());
+    }
+    string line;
+    getline(file, line); // cabecera
+    for (long long i = 0; i < rows && getline(file, line); ++i) {}
+    if (file.eof()) {
+        file.clear();
+        file.seekg(0, ios::end);
+    }
+    return static_cast<uint64_t>(file.tellg());
+}
+
+// Ratings de las líneas completas a partir de offset. Una última línea sin
+// '\n' puede estar escribiéndose todavía: se deja para la próxima lectura.
+// Devuelve el offset siguiente a la última línea consumida; las líneas que no
+// son un rating (la cabecera, líneas vacías) se saltan.
+inline uint64_t read_appended_ratings(const string& filepath, uint64_t offset, vector<Rating>& ratings) {
+    ifstream file(filepath, ios::binary);
+    if (!file.is_open()) {
+        cerr << "Error: No se pudo abrir el log de ratings " << filepath << endl;
+        return offset;
+    }
+    file.seekg(0, ios::end);
+    const uint64_t size = static_cast<uint64_t>(file.tellg());
+    if (size <= offset) return offset;
+    file.seekg(static_cast<streamoff>(offset));
+
+    string line;
+    uint64_t position = offset;
+    while (getline(file, line)) {
+        if (file.eof()) break; // sin '\n': línea incompleta
+        position += line.size() + 1;
+        Rating rating{};
+        if (sscanf(line.c_str(), "%d,%d,%lf,%ld", &rating.user_id, &rating.movie_id, &rating.rating,
+                   &rating.timestamp) >= 3) {
+            ratings.push_back(rating);
+        }
+    }
+    return position;
+}
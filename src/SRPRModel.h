@@ -1,9 +1,14 @@
 #pragma once
 #include <vector>
+#include "Checkpoint.h"
 #include "DataManager.h"
+#include "Holdout.h"
+#include "fastmath.h"
+#include "matrix.h"
 #include "vec.h"
 #include <cmath>
 #include <iostream>
+#include <sstream>
 #include <algorithm>
 #include <chrono>
 
@@ -18,141 +23,275 @@ class SRPRModel
 public:
     SRPRModel(int num_users, int num_items, int dimensions);
 
-    void train(const vector<Triplet> &triplets, int b, double learning_rate, double lambda, int epochs);
-
-    const Vec &get_user_vector(int user_idx) const;
-    const Vec &get_item_vector(int item_idx) const;
-    void save_vectors(const string &filepath) const;
-    bool load_vectors(const string &filepath);
+    // Con checkpoint, guarda puntos de control en segundo plano y, si se pide,
+    // retoma desde el último (ver Checkpoint.h). Con holdout, evalúa cada época
+    // en segundo plano y corta cuando deja de mejorar (ver Holdout.h).
+    void train(const vector<Triplet> &triplets, int b, double learning_rate, double lambda, int epochs,
+               const CheckpointOptions *checkpoint = nullptr, HoldoutEvaluator *holdout = nullptr);
+    // Fold-in: steps pasos de SGD solo sobre un vector de usuario (partiendo
+    // de user_vec) contra los items congelados, recorriendo las tripletas en
+    // orden cíclico. No modifica el modelo; user_id de las tripletas se ignora.
+    Vec fold_in_user(const vector<Triplet> &triplets, Vec user_vec, int b, double learning_rate, double lambda,
+                     int steps) const;
+
+    // Vistas sobre las matrices del modelo (ver matrix.h); valen mientras el
+    // modelo no cambie de tamaño (grow) ni se reordene (permute_items).
+    ConstVecView get_user_vector(int user_idx) const;
+    ConstVecView get_item_vector(int item_idx) const;
+    const EmbeddingMatrix &get_user_vectors() const { return user_vectors; }
+    const EmbeddingMatrix &get_item_vectors() const { return item_vectors; }
+    // catalog_fingerprint (DataManager::catalog_fingerprint) queda en la
+    // cabecera; al cargar, si ambos lo tienen y no coinciden, el archivo es de
+    // otro orden de usuarios o items y se rechaza. 0 = sin huella.
+    bool save_vectors(const string &filepath, uint64_t catalog_fingerprint = 0) const;
+    bool load_vectors(const string &filepath, uint64_t catalog_fingerprint = 0);
+    // Reordena los items igual que DataManager::reorder_items (order[nuevo] = viejo).
+    void permute_items(const vector<int> &order);
+    // Agrega filas para usuarios o items nuevos (DataManager::add_ratings) con
+    // la misma inicialización que el constructor; las existentes no cambian.
+    void grow(int num_users, int num_items);
     int get_num_users() const { return user_vectors.size(); }
     int get_num_items() const { return item_vectors.size(); }
+    // acos, erf, exp y log de libm en vez de las aproximaciones de fastmath.h
+    // (por defecto), para comparar entrenamientos.
+    void set_exact_math(bool exact) { exact_math = exact; }
 
 private:
     int d; // Dimensiones
-    vector<Vec> user_vectors;
-    vector<Vec> item_vectors;
-
-    double p_srp(const Vec &v1, const Vec &v2) const;
+    bool exact_math = false;
+    EmbeddingMatrix user_vectors;
+    EmbeddingMatrix item_vectors;
+
+    // V es Vec o FixedVec<double, D> (ver train()).
+    template <typename V>
+    bool triplet_gradients(const V &xu, const V &yi, const V &yj, int b, double &log_likelihood,
+                           V &grad_xu, type_identity_t<V> *grad_yi, type_identity_t<V> *grad_yj) const;
+    template <typename V>
+    double p_srp(const V &v1, const V &v2) const;
     double gamma(double p_ui, double p_uj) const;
     double phi(double x) const;
     double pdf(double x) const;
 };
 
-SRPRModel::SRPRModel(int num_users, int num_items, int dimensions) : d(dimensions) {
-    user_vectors.resize(num_users, Vec(d));
-    item_vectors.resize(num_items, Vec(d));
-
+SRPRModel::SRPRModel(int num_users, int num_items, int dimensions)
+    : d(dimensions), user_vectors(num_users, dimensions), item_vectors(num_items, dimensions) {
     mt19937 rng(42);
     normal_distribution<double> dist(0.0, 0.1);
-    for (auto &vec : user_vectors)
-    {
-        for (size_t i = 0; i < d; ++i)
-            vec[i] = dist(rng);
-    }
-    for (auto &vec : item_vectors)
-    {
-        for (size_t i = 0; i < d; ++i)
-            vec[i] = dist(rng);
-    }
+    for (size_t i = 0; i < user_vectors.size() * d; ++i)
+        user_vectors.data()[i] = dist(rng);
+    for (size_t i = 0; i < item_vectors.size() * d; ++i)
+        item_vectors.data()[i] = dist(rng);
 }
 
 // Entrenamiento principal que optimiza la función de SRPR.
-void SRPRModel::train(const vector<Triplet> &triplets, int b, double learning_rate, double lambda, int epochs) {
+void SRPRModel::train(const vector<Triplet> &triplets, int b, double learning_rate, double lambda, int epochs,
+                      const CheckpointOptions *checkpoint, HoldoutEvaluator *holdout) {
     cout << "=== Iniciando Entrenamiento SRPR (Implementacion Corregida) ===" << endl;
 
-    for (int epoch = 1; epoch <= epochs; ++epoch)
+    TrainingSetup setup;
+    setup.model = 1;
+    setup.dimensions = d;
+    setup.num_users = user_vectors.size();
+    setup.num_items = item_vectors.size();
+    setup.num_triplets = triplets.size();
+    setup.triplets_fingerprint = checkpoint && !checkpoint->path.empty() ? triplets_fingerprint(triplets) : 0;
+    setup.learning_rate = learning_rate;
+    setup.lambda = lambda;
+    setup.b = b;
+    setup.exact_math = exact_math;
+    TrainingCheckpointer checkpointer(checkpoint, setup);
+    TrainingCursor cursor;
+    checkpointer.resume(user_vectors, item_vectors, cursor);
+
+    while (cursor.epoch <= epochs)
     {
         auto epoch_start = chrono::high_resolution_clock::now();
-        double total_log_likelihood = 0.0;
 
-        for (const auto &triplet : triplets)
-        {
-            Vec &xu = user_vectors.at(triplet.user_id);                // usuario
-            Vec &yi = item_vectors.at(triplet.preferred_item_id);      // item preferido
-            Vec &yj = item_vectors.at(triplet.less_preferred_item_id); // item menos preferido
-
-            // --- 1. Calcular valores intermedios ---
-            double p_ui = p_srp(xu, yi);
-            double p_uj = p_srp(xu, yj);
-            double gamma_uij = gamma(p_ui, p_uj);
-            double z = sqrt(b) * gamma_uij;
-
-            total_log_likelihood += log(phi(z) + 1e-12);
-
-            // --- 2. Calcular factor común del gradiente (dL/d(gamma)) ---
-            double phi_z = phi(z);
-            if (phi_z < 1e-12)
-                continue;
-            double grad_L_wrt_gamma = (pdf(z) / phi_z) * sqrt(b);
-
-            // --- 3. Derivadas de gamma respecto a p_ui y p_uj ---
-            double var_ui = max(1e-9, p_ui * (1.0 - p_ui));
-            double var_uj = max(1e-9, p_uj * (1.0 - p_uj));
-            double sigma_sq = var_ui + var_uj;
-            double sigma = sqrt(sigma_sq);
-            double sigma_cubed = sigma_sq * sigma; // --->(sigma^2)^3/2
-
-            double dgamma_dpui = -1.0 / sigma - (p_uj - p_ui) * (0.5 - p_ui) / sigma_cubed; // ---> -1/sqrt(sigma^2) + (puj-pui)*(1-2pui)/2*sigma^3
-            double dgamma_dpuj = 1.0 / sigma - (p_uj - p_ui) * (0.5 - p_uj) / sigma_cubed;  // ---> 1/sqrt(sigma^2) - (puj-pui)*(1-2puj)/2*sigma^3
-
-            // --- 4. Derivadas de p_srp respecto a los vectores ---
-            double n_xu = xu.magnitude();
-            double n_yi = yi.magnitude();
-            double n_yj = yj.magnitude();
-            if (n_xu < 1e-9 || n_yi < 1e-9 || n_yj < 1e-9)
-                continue;
-
-            // Derivadas para el par (u,i)
-            double cos_ui = dot(xu, yi) / (n_xu * n_yi);
-            double sin_ui = sqrt(max(1e-9, 1.0 - cos_ui * cos_ui));
-            double dp_dcos_ui = -1.0 / (M_PI * sin_ui);
-            Vec dcos_dxu_ui = (yi / (n_xu * n_yi)) - (xu * cos_ui / (n_xu * n_xu));
-            Vec dcos_dyi = (xu / (n_xu * n_yi)) - (yi * cos_ui / (n_yi * n_yi));
-
-            // Derivadas para el par (u,j)
-            double cos_uj = dot(xu, yj) / (n_xu * n_yj);
-            double sin_uj = sqrt(max(1e-9, 1.0 - cos_uj * cos_uj));
-            double dp_dcos_uj = -1.0 / (M_PI * sin_uj);
-            Vec dcos_dxu_uj = (yj / (n_xu * n_yj)) - (xu * cos_uj / (n_xu * n_xu));
-            Vec dcos_dyj = (xu / (n_xu * n_yj)) - (yj * cos_uj / (n_yj * n_yj));
-
-            // --- 5. Gradientes finales aplicando regla de la cadena ---
-            Vec grad_xu = (dcos_dxu_ui * dp_dcos_ui * dgamma_dpui + dcos_dxu_uj * dp_dcos_uj * dgamma_dpuj) * grad_L_wrt_gamma;
-            Vec grad_yi = (dcos_dyi * dp_dcos_ui * dgamma_dpui) * grad_L_wrt_gamma;
-            Vec grad_yj = (dcos_dyj * dp_dcos_uj * dgamma_dpuj) * grad_L_wrt_gamma;
-
-            // actualizacion de vectores
-            xu += (grad_xu - (xu * lambda)) * learning_rate;
-            yi += (grad_yi - (yi * lambda)) * learning_rate;
-            yj += (grad_yj - (yj * lambda)) * learning_rate;
-        }
+        // Las tres filas de la tripleta se copian a vectores de trabajo (los
+        // mismos en toda la época) y se escriben de vuelta si hubo gradiente.
+        // Con una dimensión de FIXED_DIMENSIONS son FixedVec en la pila y el
+        // gradiente se calcula desenrollado y sin reservar memoria; si no, Vec.
+        dispatch_dimension(d, [&](auto fixed) {
+            constexpr size_t D = decltype(fixed)::value;
+            using V = conditional_t<D == 0, Vec, FixedVec<double, D>>;
+            auto make = [&] {
+                if constexpr (D == 0)
+                    return Vec(d);
+                else
+                    return V();
+            };
+            V grad_xu, grad_yi, grad_yj;
+            V xu = make(), yi = make(), yj = make();
+
+            for (; cursor.position < triplets.size(); ++cursor.position)
+            {
+                const Triplet &triplet = triplets[cursor.position];
+                VecView user_row = user_vectors.at(triplet.user_id);                // usuario
+                VecView item_row_i = item_vectors.at(triplet.preferred_item_id);      // item preferido
+                VecView item_row_j = item_vectors.at(triplet.less_preferred_item_id); // item menos preferido
+                copy_n(user_row.data(), d, xu.data());
+                copy_n(item_row_i.data(), d, yi.data());
+                copy_n(item_row_j.data(), d, yj.data());
+
+                double log_likelihood = 0.0;
+                bool has_gradient = triplet_gradients(xu, yi, yj, b, log_likelihood, grad_xu, &grad_yi, &grad_yj);
+                cursor.epoch_loss += log_likelihood;
+                if (has_gradient)
+                {
+                    // actualizacion de vectores
+                    xu += (grad_xu - (xu * lambda)) * learning_rate;
+                    yi += (grad_yi - (yi * lambda)) * learning_rate;
+                    yj += (grad_yj - (yj * lambda)) * learning_rate;
+                    copy_n(xu.data(), d, user_row.data());
+                    copy_n(yi.data(), d, item_row_i.data());
+                    copy_n(yj.data(), d, item_row_j.data());
+                }
+
+                checkpointer.after_triplet(user_vectors, item_vectors,
+                                           {cursor.epoch, cursor.position + 1, cursor.epoch_loss});
+            }
+        });
 
         auto epoch_end = chrono::high_resolution_clock::now();
         auto duration = chrono::duration_cast<chrono::milliseconds>(epoch_end - epoch_start);
-        cout << "Epoch " << setw(2) << epoch << "/" << epochs
-                  << " | Log-Likelihood: " << fixed << setprecision(6) << total_log_likelihood / triplets.size()
+        cout << "Epoch " << setw(2) << cursor.epoch << "/" << epochs
+                  << " | Log-Likelihood: " << fixed << setprecision(6) << cursor.epoch_loss / triplets.size()
                   << " | Tiempo: " << duration.count() << "ms" << endl;
+        cursor = {cursor.epoch + 1, 0, 0.0};
+        bool stop = false;
+        if (holdout)
+        {
+            holdout->submit(cursor.epoch - 1, user_vectors, item_vectors);
+            stop = holdout->should_stop();
+            if (stop)
+                cout << "Holdout sin mejora: se detiene el entrenamiento SRPR." << endl;
+        }
+        checkpointer.after_epoch(user_vectors, item_vectors, cursor, cursor.epoch > epochs || stop);
+        if (stop)
+            break;
+    }
+    if (holdout)
+        holdout->restore_best(cursor.epoch - 1, user_vectors, item_vectors);
+}
+
+Vec SRPRModel::fold_in_user(const vector<Triplet> &triplets, Vec user_vec, int b, double learning_rate, double lambda,
+                            int steps) const {
+    if (triplets.empty())
+        return user_vec;
+    double log_likelihood = 0.0;
+    Vec grad_xu;
+    for (int step = 0; step < steps; ++step)
+    {
+        const Triplet &triplet = triplets[step % triplets.size()];
+        const Vec yi(item_vectors.at(triplet.preferred_item_id));
+        const Vec yj(item_vectors.at(triplet.less_preferred_item_id));
+        if (!triplet_gradients(user_vec, yi, yj, b, log_likelihood, grad_xu, nullptr, nullptr))
+            continue;
+        user_vec += (grad_xu - (user_vec * lambda)) * learning_rate;
     }
+    return user_vec;
 }
 
-const Vec &SRPRModel::get_user_vector(int user_idx) const { 
+// Log-verosimilitud de una tripleta y sus gradientes (de ascenso) respecto a
+// xu y, si se piden, a yi e yj. Devuelve false si la tripleta no aporta
+// gradiente (Φ(z) ~ 0 o algún vector nulo). La usan train() y fold_in_user().
+template <typename V>
+bool SRPRModel::triplet_gradients(const V &xu, const V &yi, const V &yj, int b, double &log_likelihood,
+                                  V &grad_xu, type_identity_t<V> *grad_yi, type_identity_t<V> *grad_yj) const {
+    // --- 1. Calcular valores intermedios ---
+    double p_ui = p_srp(xu, yi);
+    double p_uj = p_srp(xu, yj);
+    double gamma_uij = gamma(p_ui, p_uj);
+    double z = sqrt(b) * gamma_uij;
+
+    double phi_z = phi(z);
+    log_likelihood = exact_math ? log(phi_z + 1e-12) : fast_log(phi_z + 1e-12);
+
+    // --- 2. Calcular factor común del gradiente (dL/d(gamma)) ---
+    if (phi_z < 1e-12)
+        return false;
+    double grad_L_wrt_gamma = (pdf(z) / phi_z) * sqrt(b);
+
+    // --- 3. Derivadas de gamma respecto a p_ui y p_uj ---
+    double var_ui = max(1e-9, p_ui * (1.0 - p_ui));
+    double var_uj = max(1e-9, p_uj * (1.0 - p_uj));
+    double sigma_sq = var_ui + var_uj;
+    double sigma = sqrt(sigma_sq);
+    double sigma_cubed = sigma_sq * sigma; // --->(sigma^2)^3/2
+
+    double dgamma_dpui = -1.0 / sigma - (p_uj - p_ui) * (0.5 - p_ui) / sigma_cubed; // ---> -1/sqrt(sigma^2) + (puj-pui)*(1-2pui)/2*sigma^3
+    double dgamma_dpuj = 1.0 / sigma - (p_uj - p_ui) * (0.5 - p_uj) / sigma_cubed;  // ---> 1/sqrt(sigma^2) - (puj-pui)*(1-2puj)/2*sigma^3
+
+    // --- 4. Derivadas de p_srp respecto a los vectores ---
+    double n_xu = xu.magnitude();
+    double n_yi = yi.magnitude();
+    double n_yj = yj.magnitude();
+    if (n_xu < 1e-9 || n_yi < 1e-9 || n_yj < 1e-9)
+        return false;
+
+    // Derivadas para el par (u,i)
+    double cos_ui = dot(xu, yi) / (n_xu * n_yi);
+    double sin_ui = sqrt(max(1e-9, 1.0 - cos_ui * cos_ui));
+    double dp_dcos_ui = -1.0 / (M_PI * sin_ui);
+    V dcos_dxu_ui = (yi / (n_xu * n_yi)) - (xu * cos_ui / (n_xu * n_xu));
+    V dcos_dyi = (xu / (n_xu * n_yi)) - (yi * cos_ui / (n_yi * n_yi));
+
+    // Derivadas para el par (u,j)
+    double cos_uj = dot(xu, yj) / (n_xu * n_yj);
+    double sin_uj = sqrt(max(1e-9, 1.0 - cos_uj * cos_uj));
+    double dp_dcos_uj = -1.0 / (M_PI * sin_uj);
+    V dcos_dxu_uj = (yj / (n_xu * n_yj)) - (xu * cos_uj / (n_xu * n_xu));
+    V dcos_dyj = (xu / (n_xu * n_yj)) - (yj * cos_uj / (n_yj * n_yj));
+
+    // --- 5. Gradientes finales aplicando regla de la cadena ---
+    grad_xu = (dcos_dxu_ui * dp_dcos_ui * dgamma_dpui + dcos_dxu_uj * dp_dcos_uj * dgamma_dpuj) * grad_L_wrt_gamma;
+    if (grad_yi)
+        *grad_yi = (dcos_dyi * dp_dcos_ui * dgamma_dpui) * grad_L_wrt_gamma;
+    if (grad_yj)
+        *grad_yj = (dcos_dyj * dp_dcos_uj * dgamma_dpuj) * grad_L_wrt_gamma;
+    return true;
+}
+
+ConstVecView SRPRModel::get_user_vector(int user_idx) const { 
     return user_vectors.at(user_idx); 
 }
 
-const Vec &SRPRModel::get_item_vector(int item_idx) const { 
+ConstVecView SRPRModel::get_item_vector(int item_idx) const { 
     return item_vectors.at(item_idx); 
 }
 
+void SRPRModel::permute_items(const vector<int> &order) {
+    item_vectors.permute_rows(order);
+}
+
+void SRPRModel::grow(int num_users, int num_items) {
+    mt19937 rng(42 + user_vectors.size() + item_vectors.size());
+    normal_distribution<double> dist(0.0, 0.1);
+    auto grow_matrix = [&](EmbeddingMatrix &matrix, int rows)
+    {
+        const size_t old_rows = matrix.size();
+        if (static_cast<int>(old_rows) >= rows)
+            return;
+        matrix.resize(rows);
+        for (size_t i = old_rows * d; i < matrix.size() * d; ++i)
+            matrix.data()[i] = dist(rng);
+    };
+    grow_matrix(user_vectors, num_users);
+    grow_matrix(item_vectors, num_items);
+}
+
 // --- Funciones matemáticas auxiliares basadas en el paper ---
 
 // Calcula p_ui, la probabilidad de colisión (hash diferente) para SRP-LSH (Eq. 9).
-double SRPRModel::p_srp(const Vec &v1, const Vec &v2) const {
+template <typename V>
+double SRPRModel::p_srp(const V &v1, const V &v2) const {
     double n1 = v1.magnitude();
     double n2 = v2.magnitude();
     if (n1 < 1e-12 || n2 < 1e-12)
         return 0.5;
     double cosine_sim = dot(v1, v2) / (n1 * n2); // vT*v2 / norm(v1)*norm(v2)
-    return acos(max(-1.0, min(1.0, cosine_sim))) / M_PI;
+    double clamped = max(-1.0, min(1.0, cosine_sim));
+    return (exact_math ? acos(clamped) : fast_acos(clamped)) / M_PI;
 }
 
 // Calcula gamma_uij (Eq. 5).
@@ -163,30 +302,38 @@ double SRPRModel::gamma(double p_ui, double p_uj) const {
 }
 
 // Función de distribución acumulativa (CDF) de la normal estándar, Φ(x).
+// La versión rápida usa erfc, que conserva el error relativo en la cola
+// izquierda (1 + erf(x) ahí pierde dígitos por cancelación).
 double SRPRModel::phi(double x) const {
-    return 0.5 * (1.0 + erf(x / sqrt(2.0)));
+    if (exact_math)
+        return 0.5 * (1.0 + erf(x / sqrt(2.0)));
+    return 0.5 * fast_erfc(-x / sqrt(2.0));
 }
 
 // Función de densidad de probabilidad (PDF) de la normal estándar, φ(x).
 double SRPRModel::pdf(double x) const {
-    return (1.0 / sqrt(2.0 * M_PI)) * exp(-0.5 * x * x);
+    return (1.0 / sqrt(2.0 * M_PI)) * (exact_math ? exp(-0.5 * x * x) : fast_exp(-0.5 * x * x));
 }
 
-inline void SRPRModel::save_vectors(const string &filepath) const {
-    ofstream out_file(filepath);
+inline bool SRPRModel::save_vectors(const string &filepath, uint64_t catalog_fingerprint) const {
+    // Se escribe a un temporal y se renombra: quien recarga los vectores
+    // (App con --watch) nunca ve un archivo a medio escribir.
+    const string tmp_path = filepath + ".tmp";
+    ofstream out_file(tmp_path);
     if (!out_file.is_open())
     {
-        cerr << "Error: No se pudo abrir el archivo para guardar vectores: " << filepath << endl;
-        return;
+        cerr << "Error: No se pudo abrir el archivo para guardar vectores: " << tmp_path << endl;
+        return false;
     }
 
-    out_file << user_vectors.size() << " " << item_vectors.size() << " " << d << "\n";
+    out_file << user_vectors.size() << " " << item_vectors.size() << " " << d << " " << catalog_fingerprint << "\n";
 
     out_file << fixed << setprecision(8);
 
     // Guardar vectores de usuario
-    for (const auto &vec : user_vectors)
+    for (size_t u = 0; u < user_vectors.size(); ++u)
     {
+        ConstVecView vec = user_vectors[u];
         for (size_t i = 0; i < d; ++i)
         {
             out_file << vec[i] << (i == d - 1 ? "" : " ");
@@ -195,8 +342,9 @@ inline void SRPRModel::save_vectors(const string &filepath) const {
     }
 
     // Guardar vectores de ítem
-    for (const auto &vec : item_vectors)
+    for (size_t item = 0; item < item_vectors.size(); ++item)
     {
+        ConstVecView vec = item_vectors[item];
         for (size_t i = 0; i < d; ++i)
         {
             out_file << vec[i] << (i == d - 1 ? "" : " ");
@@ -205,24 +353,48 @@ inline void SRPRModel::save_vectors(const string &filepath) const {
     }
 
     out_file.close();
+    if (!out_file)
+    {
+        cerr << "Error: fallo la escritura de los vectores en " << tmp_path << endl;
+        return false;
+    }
+    error_code ec;
+    filesystem::rename(tmp_path, filepath, ec);
+    if (ec)
+    {
+        cerr << "Error: no se pudo reemplazar " << filepath << ": " << ec.message() << endl;
+        return false;
+    }
     cout << "Vectores del modelo BPR guardados en: " << filepath << endl;
+    return true;
 }
 
-inline bool SRPRModel::load_vectors(const string &filepath) {
+inline bool SRPRModel::load_vectors(const string &filepath, uint64_t catalog_fingerprint) {
     ifstream in_file(filepath);
     if (!in_file.is_open())
     {
         return false; 
     }
 
-    size_t num_users, num_items, file_d;
-    in_file >> num_users >> num_items >> file_d;
+    // Cabecera: usuarios, items, dimensión y, desde que existe, la huella del
+    // catálogo (los archivos viejos no la tienen).
+    string header;
+    getline(in_file, header);
+    istringstream header_stream(header);
+    size_t num_users = 0, num_items = 0, file_d = 0;
+    uint64_t file_fingerprint = 0;
+    header_stream >> num_users >> num_items >> file_d >> file_fingerprint;
 
     if (file_d != d || num_users != user_vectors.size() || num_items != item_vectors.size())
     {
         cerr << "Error: Las dimensiones del archivo no coinciden con las del modelo. Se re-entrenara." << endl;
         return false;
     }
+    if (catalog_fingerprint != 0 && file_fingerprint != 0 && file_fingerprint != catalog_fingerprint)
+    {
+        cerr << "Error: los vectores de " << filepath << " corresponden a otro orden de usuarios o items. Se re-entrenara." << endl;
+        return false;
+    }
 
     // Cargar vectores de usuario
     for (size_t i = 0; i < num_users; ++i)
@@ -242,6 +414,13 @@ inline bool SRPRModel::load_vectors(const string &filepath) {
         }
     }
 
+    // Un archivo truncado (p. ej. copiado a mano mientras se escribía) deja el
+    // stream en error: no se devuelven vectores a medias.
+    if (!in_file)
+    {
+        cerr << "Error: el archivo de vectores " << filepath << " esta incompleto." << endl;
+        return false;
+    }
     in_file.close();
     cout << "Vectores del modelo BPR cargados desde: " << filepath << endl;
     return true;
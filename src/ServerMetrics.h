@@ -0,0 +1,265 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "lsh.h"
+
+using namespace std;
+
+// Histograma log-lineal estilo HDR: valores exactos por debajo de 8 y, a partir
+// de ahí, 8 sub-buckets por potencia de dos (error relativo <= 12.5%).
+// Cada hilo escribe en su propio shard sin locks ni operaciones RMW; el
+// scrape suma todos los shards con lecturas relajadas.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 3;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    struct Snapshot {
+        vector<uint64_t> counts = vector<uint64_t>(kNumBuckets, 0);
+        uint64_t count = 0;
+        uint64_t sum = 0;
+
+        uint64_t quantile(double q) const;
+    };
+
+    LatencyHistogram() : id_(next_id_.fetch_add(1)) {}
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t value);
+    Snapshot snapshot() const;
+
+    static int bucket_index(uint64_t value);
+    // Límite superior (exclusivo) de los valores que caen en el bucket.
+    static uint64_t bucket_upper_bound(int index);
+
+private:
+    struct Shard {
+        array<atomic<uint64_t>, kNumBuckets> counts{};
+        atomic<uint64_t> count{0};
+        atomic<uint64_t> sum{0};
+    };
+
+    size_t id_;
+    mutable mutex registry_mutex_; // solo se toma al registrar un hilo nuevo o al hacer scrape
+    vector<unique_ptr<Shard>> shards_;
+
+    inline static atomic<size_t> next_id_{0};
+
+    Shard& local_shard();
+};
+
+int LatencyHistogram::bucket_index(uint64_t value) {
+    if (value < kSubBuckets) return static_cast<int>(value);
+    int msb = 63 - countl_zero(value);
+    int shift = msb - kSubBucketBits;
+    int sub = static_cast<int>((value >> shift) & (kSubBuckets - 1));
+    return (shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(int index) {
+    if (index < kSubBuckets) return static_cast<uint64_t>(index) + 1;
+    int shift = index / kSubBuckets - 1;
+    uint64_t sub = index % kSubBuckets;
+    if (shift + kSubBucketBits + 1 >= 64 && sub == kSubBuckets - 1) return UINT64_MAX;
+    return (kSubBuckets + sub + 1) << shift;
+}
+
+LatencyHistogram::Shard& LatencyHistogram::local_shard() {
+    // Cache por hilo indexado por id de histograma: el camino rapido es un acceso a vector.
+    thread_local vector<Shard*> cache;
+    if (id_ < cache.size() && cache[id_]) return *cache[id_];
+
+    lock_guard<mutex> lock(registry_mutex_);
+    shards_.push_back(make_unique<Shard>());
+    if (cache.size() <= id_) cache.resize(id_ + 1, nullptr);
+    cache[id_] = shards_.back().get();
+    return *cache[id_];
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    Shard& shard = local_shard();
+    auto& bucket = shard.counts[bucket_index(value)];
+    // Un único escritor por shard: load + store relajados bastan.
+    bucket.store(bucket.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    shard.count.store(shard.count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    shard.sum.store(shard.sum.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot result;
+    lock_guard<mutex> lock(registry_mutex_);
+    for (const auto& shard : shards_) {
+        for (int i = 0; i < kNumBuckets; ++i) {
+            result.counts[i] += shard->counts[i].load(memory_order_relaxed);
+        }
+        result.count += shard->count.load(memory_order_relaxed);
+        result.sum += shard->sum.load(memory_order_relaxed);
+    }
+    return result;
+}
+
+uint64_t LatencyHistogram::Snapshot::quantile(double q) const {
+    if (count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(q * count);
+    if (rank >= count) rank = count - 1;
+    uint64_t cumulative = 0;
+    for (int i = 0; i < kNumBuckets; ++i) {
+        cumulative += counts[i];
+        if (cumulative > rank) return bucket_upper_bound(i) - 1;
+    }
+    return bucket_upper_bound(kNumBuckets - 1);
+}
+
+// Histogramas agregados del servidor, expuestos en formato de texto de Prometheus.
+class ServerMetrics {
+public:
+    enum Stage { IdLookup, Hashing, BucketProbe, CandidateScoring, TopK, BruteForce, Serialization, NumStages };
+
+    explicit ServerMetrics(vector<string> model_names);
+
+    // Etapas comunes a la petición (id_lookup, serialization).
+    void record_stage(Stage stage, uint64_t ns);
+    // Etapas de una consulta de un modelo concreto.
+    void record_stage(int model, Stage stage, uint64_t ns);
+    void record_lsh_query(int model, const LSHQueryStats& stats);
+
+    void write_prometheus(ostream& out) const;
+
+private:
+    vector<string> model_names_;
+    array<LatencyHistogram, NumStages> request_stages_;
+    vector<unique_ptr<array<LatencyHistogram, NumStages>>> model_stages_;
+    vector<unique_ptr<LatencyHistogram>> candidate_counts_;
+    vector<unique_ptr<LatencyHistogram>> bucket_sizes_;
+
+    static const char* stage_name(Stage stage);
+    static void write_buckets(ostream& out, const string& name, const string& labels,
+                              const LatencyHistogram::Snapshot& snap, double scale, int min_pow2, int max_pow2);
+    static void write_quantiles(ostream& out, const string& name, const string& labels,
+                                const LatencyHistogram::Snapshot& snap, double scale);
+};
+
+ServerMetrics::ServerMetrics(vector<string> model_names) : model_names_(move(model_names)) {
+    for (size_t i = 0; i < model_names_.size(); ++i) {
+        model_stages_.push_back(make_unique<array<LatencyHistogram, NumStages>>());
+        candidate_counts_.push_back(make_unique<LatencyHistogram>());
+        bucket_sizes_.push_back(make_unique<LatencyHistogram>());
+    }
+}
+
+const char* ServerMetrics::stage_name(Stage stage) {
+    switch (stage) {
+        case IdLookup: return "id_lookup";
+        case Hashing: return "hashing";
+        case BucketProbe: return "bucket_probe";
+        case CandidateScoring: return "candidate_scoring";
+        case TopK: return "top_k";
+        case BruteForce: return "brute_force";
+        case Serialization: return "serialization";
+        default: return "unknown";
+    }
+}
+
+void ServerMetrics::record_stage(Stage stage, uint64_t ns) {
+    request_stages_[stage].record(ns);
+}
+
+void ServerMetrics::record_stage(int model, Stage stage, uint64_t ns) {
+    (*model_stages_[model])[stage].record(ns);
+}
+
+void ServerMetrics::record_lsh_query(int model, const LSHQueryStats& stats) {
+    auto& stages = *model_stages_[model];
+    stages[Hashing].record(stats.hashing_ns);
+    stages[BucketProbe].record(stats.probe_ns);
+    stages[CandidateScoring].record(stats.scoring_ns);
+    stages[TopK].record(stats.topk_ns);
+    candidate_counts_[model]->record(stats.num_candidates);
+    for (size_t size : stats.bucket_sizes) {
+        bucket_sizes_[model]->record(size);
+    }
+}
+
+void ServerMetrics::write_buckets(ostream& out, const string& name, const string& labels,
+                                  const LatencyHistogram::Snapshot& snap, double scale, int min_pow2, int max_pow2) {
+    // Se exportan solo los límites 2^p - 1: coinciden con bordes de bucket del
+    // HDR, así que los conteos acumulados (valores <= le) son exactos.
+    string sep = labels.empty() ? "" : ",";
+    uint64_t cumulative = 0;
+    int idx = 0;
+    for (int p = min_pow2; p <= max_pow2; ++p) {
+        uint64_t bound = uint64_t{1} << p;
+        while (idx < LatencyHistogram::kNumBuckets && LatencyHistogram::bucket_upper_bound(idx) <= bound) {
+            cumulative += snap.counts[idx++];
+        }
+        out << name << "_bucket{" << labels << sep << "le=\"" << (bound - 1) * scale << "\"} " << cumulative << "\n";
+    }
+    out << name << "_bucket{" << labels << sep << "le=\"+Inf\"} " << snap.count << "\n";
+    out << name << "_sum{" << labels << "} " << snap.sum * scale << "\n";
+    out << name << "_count{" << labels << "} " << snap.count << "\n";
+}
+
+void ServerMetrics::write_quantiles(ostream& out, const string& name, const string& labels,
+                                    const LatencyHistogram::Snapshot& snap, double scale) {
+    string sep = labels.empty() ? "" : ",";
+    for (double q : {0.5, 0.9, 0.99, 0.999}) {
+        out << name << "{" << labels << sep << "quantile=\"" << q << "\"} " << snap.quantile(q) * scale << "\n";
+    }
+}
+
+void ServerMetrics::write_prometheus(ostream& out) const {
+    const double ns_to_s = 1e-9;
+    // 2^10 ns ~ 1us hasta 2^35 ns ~ 34s
+    const int min_latency_pow2 = 10, max_latency_pow2 = 35;
+
+    out << "# HELP srpr_stage_latency_seconds Latencia por etapa de /api/recommend.\n";
+    out << "# TYPE srpr_stage_latency_seconds histogram\n";
+    for (Stage stage : {IdLookup, Serialization}) {
+        string labels = string("stage=\"") + stage_name(stage) + "\"";
+        write_buckets(out, "srpr_stage_latency_seconds", labels, request_stages_[stage].snapshot(),
+                      ns_to_s, min_latency_pow2, max_latency_pow2);
+    }
+    for (size_t m = 0; m < model_names_.size(); ++m) {
+        for (Stage stage : {Hashing, BucketProbe, CandidateScoring, TopK, BruteForce}) {
+            string labels = "model=\"" + model_names_[m] + "\",stage=\"" + stage_name(stage) + "\"";
+            write_buckets(out, "srpr_stage_latency_seconds", labels, (*model_stages_[m])[stage].snapshot(),
+                          ns_to_s, min_latency_pow2, max_latency_pow2);
+        }
+    }
+
+    out << "# HELP srpr_stage_latency_quantile_seconds Cuantiles estimados del histograma HDR.\n";
+    out << "# TYPE srpr_stage_latency_quantile_seconds gauge\n";
+    for (Stage stage : {IdLookup, Serialization}) {
+        string labels = string("stage=\"") + stage_name(stage) + "\"";
+        write_quantiles(out, "srpr_stage_latency_quantile_seconds", labels, request_stages_[stage].snapshot(), ns_to_s);
+    }
+    for (size_t m = 0; m < model_names_.size(); ++m) {
+        for (Stage stage : {Hashing, BucketProbe, CandidateScoring, TopK, BruteForce}) {
+            string labels = "model=\"" + model_names_[m] + "\",stage=\"" + stage_name(stage) + "\"";
+            write_quantiles(out, "srpr_stage_latency_quantile_seconds", labels, (*model_stages_[m])[stage].snapshot(), ns_to_s);
+        }
+    }
+
+    out << "# HELP srpr_lsh_candidates Candidatos evaluados por consulta LSH.\n";
+    out << "# TYPE srpr_lsh_candidates histogram\n";
+    for (size_t m = 0; m < model_names_.size(); ++m) {
+        write_buckets(out, "srpr_lsh_candidates", "model=\"" + model_names_[m] + "\"",
+                      candidate_counts_[m]->snapshot(), 1.0, 0, 24);
+    }
+
+    out << "# HELP srpr_lsh_bucket_size Tamaño de cada bucket consultado (uno por tabla).\n";
+    out << "# TYPE srpr_lsh_bucket_size histogram\n";
+    for (size_t m = 0; m < model_names_.size(); ++m) {
+        write_buckets(out, "srpr_lsh_bucket_size", "model=\"" + model_names_[m] + "\"",
+                      bucket_sizes_[m]->snapshot(), 1.0, 0, 24);
+    }
+}
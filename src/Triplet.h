@@ -121,6 +121,65 @@ static vector<Rating> load_movielens_ratings(const string& filepath, int max_rat
     return ratings;
 }
 
+// Tripletas de un único usuario. rng se comparte entre usuarios, así que el
+// resultado depende del orden en que se procesan (ascendente por user_id).
+static void user_ratings_to_triplets(int user_id, const vector<Rating>& user_movie_ratings, int max_triplets_per_user,
+                                     double min_rating_diff, mt19937& rng, vector<Triplet>& user_triplets) {
+    user_triplets.clear();
+    if (user_movie_ratings.size() < 2) {
+        return;
+    }
+
+    // En lugar de un bucle O(N^2), usamos muestreo aleatorio.
+    if (user_movie_ratings.size() < 300) { 
+        for (size_t i = 0; i < user_movie_ratings.size(); ++i) {
+            for (size_t j = i + 1; j < user_movie_ratings.size(); ++j) {
+                const auto& rating_i = user_movie_ratings[i];
+                const auto& rating_j = user_movie_ratings[j];
+                if (abs(rating_i.rating - rating_j.rating) >= min_rating_diff) {
+                    if (rating_i.rating > rating_j.rating) {
+                        user_triplets.push_back({user_id, rating_i.movie_id, rating_j.movie_id});
+                    } else {
+                        user_triplets.push_back({user_id, rating_j.movie_id, rating_i.movie_id});
+                    }
+                }
+            }
+        }
+        // Si aun así se generan demasiadas, mezclamos y cortamos.
+         if (user_triplets.size() > max_triplets_per_user) {
+            shuffle(user_triplets.begin(), user_triplets.end(), rng);
+            user_triplets.resize(max_triplets_per_user);
+        }
+
+    } else { 
+        uniform_int_distribution<size_t> dist(0, user_movie_ratings.size() - 1);
+        int attempts = 0;
+        const int max_attempts = max_triplets_per_user * 5; // Intentar 5 veces por cada tripleta deseada
+
+        while (user_triplets.size() < max_triplets_per_user && attempts < max_attempts) {
+            size_t idx1 = dist(rng);
+            size_t idx2 = dist(rng);
+
+            if (idx1 == idx2) {
+                attempts++;
+                continue;
+            }
+
+            const auto& rating_i = user_movie_ratings[idx1];
+            const auto& rating_j = user_movie_ratings[idx2];
+
+            if (abs(rating_i.rating - rating_j.rating) >= min_rating_diff) {
+                if (rating_i.rating > rating_j.rating) {
+                    user_triplets.push_back({user_id, rating_i.movie_id, rating_j.movie_id});
+                } else {
+                    user_triplets.push_back({user_id, rating_j.movie_id, rating_i.movie_id});
+                }
+            }
+            attempts++;
+        }
+    }
+}
+
 // Convierte ratings de MovieLens a tripletas de preferencia
 static vector<Triplet> ratings_to_triplets(const vector<Rating>& ratings, int max_triplets_per_user = 100, double min_rating_diff = 0.5) {
     vector<Triplet> triplets;
@@ -136,69 +195,13 @@ static vector<Triplet> ratings_to_triplets(const vector<Rating>& ratings, int ma
     mt19937 rng(42); // Seed fijo para reproducibilidad
 
     int user_count = 0;
+    vector<Triplet> user_triplets;
     for (const auto& user_pair : user_ratings) {
         if (++user_count % 1000 == 0) {
             cout << "Procesando usuario " << user_count << "/" << user_ratings.size() << endl;
         }
 
-        int user_id = user_pair.first;
-        const auto& user_movie_ratings = user_pair.second;
-
-        if (user_movie_ratings.size() < 2) {
-            continue;
-        }
-
-        vector<Triplet> user_triplets;
-
-        // En lugar de un bucle O(N^2), usamos muestreo aleatorio.
-        if (user_movie_ratings.size() < 300) { 
-            for (size_t i = 0; i < user_movie_ratings.size(); ++i) {
-                for (size_t j = i + 1; j < user_movie_ratings.size(); ++j) {
-                    const auto& rating_i = user_movie_ratings[i];
-                    const auto& rating_j = user_movie_ratings[j];
-                    if (abs(rating_i.rating - rating_j.rating) >= min_rating_diff) {
-                        if (rating_i.rating > rating_j.rating) {
-                            user_triplets.push_back({user_id, rating_i.movie_id, rating_j.movie_id});
-                        } else {
-                            user_triplets.push_back({user_id, rating_j.movie_id, rating_i.movie_id});
-                        }
-                    }
-                }
-            }
-            // Si aun así se generan demasiadas, mezclamos y cortamos.
-             if (user_triplets.size() > max_triplets_per_user) {
-                shuffle(user_triplets.begin(), user_triplets.end(), rng);
-                user_triplets.resize(max_triplets_per_user);
-            }
-
-        } else { 
-            uniform_int_distribution<size_t> dist(0, user_movie_ratings.size() - 1);
-            int attempts = 0;
-            const int max_attempts = max_triplets_per_user * 5; // Intentar 5 veces por cada tripleta deseada
-
-            while (user_triplets.size() < max_triplets_per_user && attempts < max_attempts) {
-                size_t idx1 = dist(rng);
-                size_t idx2 = dist(rng);
-
-                if (idx1 == idx2) {
-                    attempts++;
-                    continue;
-                }
-
-                const auto& rating_i = user_movie_ratings[idx1];
-                const auto& rating_j = user_movie_ratings[idx2];
-
-                if (abs(rating_i.rating - rating_j.rating) >= min_rating_diff) {
-                    if (rating_i.rating > rating_j.rating) {
-                        user_triplets.push_back({user_id, rating_i.movie_id, rating_j.movie_id});
-                    } else {
-                        user_triplets.push_back({user_id, rating_j.movie_id, rating_i.movie_id});
-                    }
-                }
-                attempts++;
-            }
-        }
-
+        user_ratings_to_triplets(user_pair.first, user_pair.second, max_triplets_per_user, min_rating_diff, rng, user_triplets);
         triplets.insert(triplets.end(), user_triplets.begin(), user_triplets.end());
     }
 
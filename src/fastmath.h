@@ -0,0 +1,186 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Aproximaciones de exp, log, erfc/erf y acos para el entrenamiento de SRPR,
+// donde estas llamadas dominan el costo de cada tripleta. Son polinomios o
+// racionales sin tablas ni saltos: los casos se eligen con máscaras de bits,
+// porque sin -fno-trapping-math GCC no convierte un ?: ni un min/max de
+// doubles en una mezcla y deja de vectorizar el bucle. Así el compilador puede vectorizarlas
+// con SSE2; con OpenMP además se generan versiones SIMD (declare simd).
+//
+// Error máximo (verificado por fast_math_accuracy contra libm):
+//   fast_exp   relativo < 1e-14 en [-708, 709] (fuera se satura)
+//   fast_log   relativo < 1e-14 para x normal positivo (fuera no vale)
+//   fast_erfc  relativo < 1.2e-7 en todo R (Numerical Recipes, erfcc)
+//   fast_erf   absoluto < 2.4e-7 en todo R
+//   fast_acos  absoluto < 2.5e-8 en [-1, 1] (Abramowitz-Stegun 4.4.46: 2e-8
+//              con los coeficientes exactos, más el redondeo de los publicados)
+
+constexpr double FAST_MATH_LOG2E = 1.4426950408889634;
+constexpr double FAST_MATH_LN2_HI = 6.93147180369123816490e-01;
+constexpr double FAST_MATH_LN2_LO = 1.90821492927058770002e-10;
+constexpr double FAST_MATH_PI = 3.14159265358979323846;
+
+// if_negative si x tiene el bit de signo (incluido -0.0), si no if_non_negative.
+inline double fast_math_select_negative(double x, double if_negative, double if_non_negative) {
+    const uint64_t mask = 0 - (bit_cast<uint64_t>(x) >> 63);
+    return bit_cast<double>((bit_cast<uint64_t>(if_negative) & mask) | (bit_cast<uint64_t>(if_non_negative) & ~mask));
+}
+
+// exp(x) = 2^n con |r| <= ln2/2 (reducción de Cody-Waite) y Taylor de
+// grado 11 para e^r; 2^n se arma directamente en el exponente del double.
+#pragma omp declare simd
+inline double fast_exp(double x) {
+    x = fast_math_select_negative(x + 708.0, -708.0, x);
+    x = fast_math_select_negative(709.0 - x, 709.0, x);
+    // Redondeo al entero más cercano sin nearbyint: sumar y restar 1.5 * 2^52.
+    // Los bits bajos de shifted son n en entero, así que 2^n sale de ellos sin
+    // convertir double -> int64 (que SSE2 no tiene en forma vectorial).
+    const double shifted = x * FAST_MATH_LOG2E + 6755399441055744.0;
+    const double n = shifted - 6755399441055744.0;
+    const double r = (x - n * FAST_MATH_LN2_HI) - n * FAST_MATH_LN2_LO;
+    // Esquema de Estrin: los pares se evalúan por separado y se combinan con
+    // r^2, r^4 y r^8. Sin FMA la cadena de Horner (12 mul + suma dependientes)
+    // es más lenta que el exp de glibc; así queda en 4 pasos.
+    const double r2 = r * r, r4 = r2 * r2, r8 = r4 * r4;
+    const double p01 = 1.0 + r, p23 = 0.5 + r * (1.0 / 6.0);
+    const double p45 = 1.0 / 24.0 + r * (1.0 / 120.0), p67 = 1.0 / 720.0 + r * (1.0 / 5040.0);
+    const double p89 = 1.0 / 40320.0 + r * (1.0 / 362880.0), p1011 = 1.0 / 3628800.0 + r * (1.0 / 39916800.0);
+    const double p = (p01 + p23 * r2) + (p45 + p67 * r2) * r4 + (p89 + p1011 * r2) * r8;
+    const uint64_t scale_bits = (bit_cast<uint64_t>(shifted) + 1023) << 52;
+    return p * bit_cast<double>(scale_bits);
+}
+
+// log(x) = e*ln2 + log(m) con m en [sqrt(1/2), sqrt(2)), y log(m) por la serie
+// de atanh: 2s(1 + s^2/3 + ... + s^16/17) con s = (m-1)/(m+1), |s| < 0.172.
+// Solo para x normal positivo (SRPR la llama con Φ(z) + 1e-12); 0, negativos,
+// subnormales, inf y NaN dan resultados sin sentido.
+#pragma omp declare simd
+inline double fast_log(double x) {
+    // Desplazar los bits por sqrt(1/2) deja m en [sqrt(1/2), sqrt(2)) y e
+    // ajustado sin comparar (como el log de musl).
+    constexpr uint64_t SQRT_HALF_BITS = 0x3fe6a09e667f3bcdULL;
+    const uint64_t shifted = bit_cast<uint64_t>(x) + (0x3ff0000000000000ULL - SQRT_HALF_BITS);
+    const double m = bit_cast<double>((shifted & 0x000fffffffffffffULL) + SQRT_HALF_BITS);
+    // El exponente a double sin conversión entera: 2^52 + campo, menos 2^52 + 1023.
+    const double e = bit_cast<double>((shifted >> 52) | 0x4330000000000000ULL) - 4503599627371519.0;
+    const double s = (m - 1.0) / (m + 1.0);
+    const double s2 = s * s;
+    // Estrin en s^2, como en fast_exp.
+    const double s4 = s2 * s2, s8 = s4 * s4;
+    const double p = (1.0 + s2 * (1.0 / 3.0)) + (1.0 / 5.0 + s2 * (1.0 / 7.0)) * s4 +
+                     ((1.0 / 9.0 + s2 * (1.0 / 11.0)) + (1.0 / 13.0 + s2 * (1.0 / 15.0)) * s4) * s8 +
+                     (1.0 / 17.0) * (s8 * s8);
+    return e * FAST_MATH_LN2_HI + (2.0 * s * p + e * FAST_MATH_LN2_LO);
+}
+
+// erfc(x) con la aproximación de Chebyshev de Numerical Recipes (erfcc): error
+// relativo uniforme, también en las colas, que es donde SRPR evalúa Φ(z).
+#pragma omp declare simd
+inline double fast_erfc(double x) {
+    const double z = abs(x);
+    const double t = 1.0 / (1.0 + 0.5 * z);
+    const double t2 = t * t, t4 = t2 * t2, t8 = t4 * t4;
+    const double p = ((-1.26551223 + t * 1.00002368) + (0.37409196 + t * 0.09678418) * t2) +
+                     ((-0.18628806 + t * 0.27886807) + (-1.13520398 + t * 1.48851587) * t2) * t4 +
+                     (-0.82215223 + t * 0.17087277) * t8;
+    const double result = t * fast_exp(-z * z + p);
+    return fast_math_select_negative(x, 2.0 - result, result);
+}
+
+#pragma omp declare simd
+inline double fast_erf(double x) {
+    return 1.0 - fast_erfc(x);
+}
+
+// acos(x) = sqrt(1 - |x|) * P7(|x|) para x >= 0 (Abramowitz-Stegun 4.4.46) y
+// pi - acos(-x) para x < 0. La entrada se acota a [-1, 1].
+#pragma omp declare simd
+inline double fast_acos(double x) {
+    x = fast_math_select_negative(x + 1.0, -1.0, x);
+    x = fast_math_select_negative(1.0 - x, 1.0, x);
+    const double a = abs(x);
+    const double a2 = a * a, a4 = a2 * a2;
+    const double p = ((1.5707963050 - a * 0.2145988016) + (0.0889789874 - a * 0.0501743046) * a2) +
+                     ((0.0308918810 - a * 0.0170881256) + (0.0066700901 - a * 0.0012624911) * a2) * a4;
+    const double result = sqrt(1.0 - a) * p;
+    return fast_math_select_negative(x, FAST_MATH_PI - result, result);
+}
+
+// Modo de verificación: compara cada aproximación con libm sobre muestras de
+// su dominio (uniformes más los extremos) y contra la cota documentada arriba.
+struct FastMathAccuracy {
+    string name;
+    string domain;
+    bool relative;  // la cota es de error relativo (si no, absoluto)
+    double bound;
+    double max_error = 0.0;
+    double worst_x = 0.0;
+    bool ok() const { return max_error <= bound; }
+};
+
+template <typename Fast, typename Reference>
+FastMathAccuracy measure_fast_math(string name, string domain, bool relative, double bound, double lo, double hi,
+                                   size_t samples, Fast fast, Reference reference) {
+    FastMathAccuracy accuracy{move(name), move(domain), relative, bound};
+    mt19937_64 rng(42);
+    uniform_real_distribution<double> dist(lo, hi);
+    for (size_t i = 0; i < samples + 2; ++i) {
+        double x = i == samples ? lo : (i == samples + 1 ? hi : dist(rng));
+        double expected = reference(x);
+        double error = abs(fast(x) - expected);
+        if (relative && expected != 0.0) error /= abs(expected);
+        if (error > accuracy.max_error) {
+            accuracy.max_error = error;
+            accuracy.worst_x = x;
+        }
+    }
+    return accuracy;
+}
+
+inline vector<FastMathAccuracy> fast_math_accuracy(size_t samples = 1000000) {
+    vector<FastMathAccuracy> results;
+    results.push_back(measure_fast_math("fast_exp", "[-708, 709]", true, 1e-14, -708.0, 709.0, samples,
+                                        [](double x) { return fast_exp(x); }, [](double x) { return exp(x); }));
+    results.push_back(measure_fast_math("fast_exp", "[-10, 10]", true, 1e-14, -10.0, 10.0, samples,
+                                        [](double x) { return fast_exp(x); }, [](double x) { return exp(x); }));
+    // log sobre exponentes al azar: x = e^u con u uniforme.
+    results.push_back(measure_fast_math("fast_log", "[1e-300, 1e300]", true, 1e-14, -690.0, 690.0, samples,
+                                        [](double u) { return fast_log(exp(u)); },
+                                        [](double u) { return log(exp(u)); }));
+    results.push_back(measure_fast_math("fast_log", "[1e-12, 2]", true, 1e-14, 1e-12, 2.0, samples,
+                                        [](double x) { return fast_log(x); }, [](double x) { return log(x); }));
+    results.push_back(measure_fast_math("fast_erfc", "[-6, 26]", true, 1.2e-7, -6.0, 26.0, samples,
+                                        [](double x) { return fast_erfc(x); }, [](double x) { return erfc(x); }));
+    results.push_back(measure_fast_math("fast_erf", "[-6, 6]", false, 2.4e-7, -6.0, 6.0, samples,
+                                        [](double x) { return fast_erf(x); }, [](double x) { return erf(x); }));
+    results.push_back(measure_fast_math("fast_acos", "[-1, 1]", false, 2.5e-8, -1.0, 1.0, samples,
+                                        [](double x) { return fast_acos(x); }, [](double x) { return acos(x); }));
+    return results;
+}
+
+// Imprime la tabla; devuelve false si alguna aproximación supera su cota.
+inline bool print_fast_math_accuracy(size_t samples = 1000000) {
+    bool all_ok = true;
+    cout << left << setw(12) << "Funcion" << setw(18) << "Dominio" << setw(10) << "Error" << setw(14) << "Cota"
+         << setw(14) << "Maximo" << "Peor x" << endl;
+    for (const auto& accuracy : fast_math_accuracy(samples)) {
+        cout << left << setw(12) << accuracy.name << setw(18) << accuracy.domain << setw(10)
+             << (accuracy.relative ? "relativo" : "absoluto") << setw(14) << scientific << setprecision(2)
+             << accuracy.bound << setw(14) << accuracy.max_error << setprecision(6) << accuracy.worst_x
+             << (accuracy.ok() ? "" : "  <-- FUERA DE COTA") << endl;
+        all_ok = all_ok && accuracy.ok();
+    }
+    cout << defaultfloat;
+    return all_ok;
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include "simd.h"
+
+using namespace std;
+
+// Vectores de dimensión conocida en compilación. Vec guarda sus valores en el
+// heap y compara dimensiones en cada operación; FixedVec<T, D> los guarda en
+// línea (alineados) y todos sus bucles tienen D constante, así que el
+// compilador los desenrolla y vectoriza sin epílogos ni comprobaciones, y las
+// temporales de una expresión no reservan memoria. Los entrenamientos eligen
+// en ejecución una de las dimensiones precompiladas con dispatch_dimension y,
+// si la suya no está, siguen con Vec. Los productos punto sobre memoria (Vec,
+// filas de matrices, índices) van a los kernels de simd.h.
+//
+// Las operaciones son bucles simples y no un pack de índices desplegado: con
+// D = 64 o 128 GCC deja de integrar las lambdas del pack y pierde la
+// vectorización, mientras que un bucle de cuenta constante sí lo vectoriza.
+
+// Dimensiones con especialización precompilada.
+constexpr size_t FIXED_DIMENSIONS[] = {16, 32, 64, 128};
+
+// Producto punto de D elementos con SIMD_DOT_LANES acumuladores: la suma deja
+// de ser una sola cadena dependiente y se vectoriza. El orden de suma es el de
+// los kernels de simd.h, así que el resultado no depende de quién lo llame ni
+// de la CPU.
+constexpr size_t FIXED_DOT_LANES = SIMD_DOT_LANES;
+
+template <size_t D, typename T>
+constexpr T fixed_dot(const T* a, const T* b) {
+    T partial[FIXED_DOT_LANES] = {};
+    constexpr size_t body = D - D % FIXED_DOT_LANES;
+    for (size_t i = 0; i < body; i += FIXED_DOT_LANES) {
+        for (size_t lane = 0; lane < FIXED_DOT_LANES; ++lane) partial[lane] += a[i + lane] * b[i + lane];
+    }
+    for (size_t i = body; i < D; ++i) partial[i - body] += a[i] * b[i];
+    return simd_reduce_lanes(partial);
+}
+
+// Producto punto de dimensión arbitraria, suma secuencial (la versión previa a
+// simd.h; queda como referencia en Microbench).
+template <typename T>
+T dynamic_dot(const T* a, const T* b, size_t dimension) {
+    T result = 0;
+    for (size_t i = 0; i < dimension; ++i) {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+// f(integral_constant<size_t, D>{}) con D la especialización de dimension, o
+// con D = 0 si no hay ninguna (el llamador usa entonces el camino dinámico).
+// Se elige una vez por bucle: el cuerpo de f queda compilado para esa D.
+template <typename F>
+decltype(auto) dispatch_dimension(size_t dimension, F&& f) {
+    switch (dimension) {
+        case 16: return f(integral_constant<size_t, 16>{});
+        case 32: return f(integral_constant<size_t, 32>{});
+        case 64: return f(integral_constant<size_t, 64>{});
+        case 128: return f(integral_constant<size_t, 128>{});
+        default: return f(integral_constant<size_t, 0>{});
+    }
+}
+
+// Alineación de FixedVec: una línea de caché, o el tamaño del vector
+// redondeado a potencia de dos si es menor.
+template <typename T, size_t D>
+constexpr size_t fixed_vec_alignment() {
+    return max(alignof(T), min<size_t>(64, bit_ceil(D * sizeof(T))));
+}
+
+template <typename T, size_t D>
+struct FixedVec {
+    static_assert(D > 0, "FixedVec necesita al menos una dimension");
+
+    alignas(fixed_vec_alignment<T, D>()) T values[D] = {};
+
+    constexpr FixedVec() = default;
+    // Copia D valores desde memoria contigua (una fila de Vec o de una matriz).
+    constexpr explicit FixedVec(const T* source) {
+        for (size_t i = 0; i < D; ++i) values[i] = source[i];
+    }
+
+    constexpr void store(T* destination) const {
+        for (size_t i = 0; i < D; ++i) destination[i] = values[i];
+    }
+
+    static constexpr size_t getDimension() { return D; }
+    constexpr T& operator[](size_t index) { return values[index]; }
+    constexpr const T& operator[](size_t index) const { return values[index]; }
+    constexpr T* data() { return values; }
+    constexpr const T* data() const { return values; }
+
+    constexpr FixedVec& operator+=(const FixedVec& rhs) {
+        for (size_t i = 0; i < D; ++i) values[i] += rhs.values[i];
+        return *this;
+    }
+    constexpr FixedVec& operator-=(const FixedVec& rhs) {
+        for (size_t i = 0; i < D; ++i) values[i] -= rhs.values[i];
+        return *this;
+    }
+    constexpr FixedVec& operator*=(T scalar) {
+        for (size_t i = 0; i < D; ++i) values[i] *= scalar;
+        return *this;
+    }
+    constexpr FixedVec& operator/=(T scalar) {
+        for (size_t i = 0; i < D; ++i) values[i] /= scalar;
+        return *this;
+    }
+
+    constexpr T magnitudeSquared() const { return fixed_dot<D>(values, values); }
+    T magnitude() const { return sqrt(magnitudeSquared()); }
+};
+
+template <typename T, size_t D>
+constexpr FixedVec<T, D> operator+(const FixedVec<T, D>& lhs, const FixedVec<T, D>& rhs) {
+    FixedVec<T, D> result = lhs;
+    result += rhs;
+    return result;
+}
+
+template <typename T, size_t D>
+constexpr FixedVec<T, D> operator-(const FixedVec<T, D>& lhs, const FixedVec<T, D>& rhs) {
+    FixedVec<T, D> result = lhs;
+    result -= rhs;
+    return result;
+}
+
+template <typename T, size_t D>
+constexpr FixedVec<T, D> operator*(const FixedVec<T, D>& vector, type_identity_t<T> scalar) {
+    FixedVec<T, D> result = vector;
+    result *= scalar;
+    return result;
+}
+
+template <typename T, size_t D>
+constexpr FixedVec<T, D> operator*(type_identity_t<T> scalar, const FixedVec<T, D>& vector) {
+    return vector * scalar;
+}
+
+template <typename T, size_t D>
+constexpr FixedVec<T, D> operator/(const FixedVec<T, D>& vector, type_identity_t<T> scalar) {
+    FixedVec<T, D> result = vector;
+    result /= scalar;
+    return result;
+}
+
+template <typename T, size_t D>
+constexpr T dot(const FixedVec<T, D>& a, const FixedVec<T, D>& b) {
+    return fixed_dot<D>(a.data(), b.data());
+}
@@ -8,11 +8,95 @@
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <cstring>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include <queue>
+#include <bit>
+#include <filesystem>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <span>
 #include "vec.h"
+#include "simd.h"
+#include "matrix.h"
 #include "plane.h"
+#include "MappedFile.h"
+#include "sketch.h"
+#include "quantize.h"
+#include "pq.h"
 
 using namespace std;
 
+// Desglose por etapa de una consulta LSH (para histogramas del servidor).
+struct LSHQueryStats {
+    uint64_t hashing_ns = 0;
+    uint64_t probe_ns = 0;
+    uint64_t scoring_ns = 0;
+    uint64_t topk_ns = 0;
+    size_t num_candidates = 0;
+    size_t num_rescored = 0;     // candidatos puntuados con coseno exacto
+    vector<size_t> bucket_sizes; // items recorridos por bucket consultado (<= bucket_cap)
+};
+
+// Ocupación de los buckets de un índice congelado, sumando todas las tablas.
+struct LSHBucketStats {
+    size_t num_buckets = 0;
+    size_t num_entries = 0;  // items x tablas
+    size_t max_size = 0;
+    // Tamaño medio del bucket en que cae un item al azar (sum s^2 / sum s): el
+    // costo esperado por tabla de una consulta parecida a los items.
+    double expected_scan = 0.0;
+    size_t oversized_buckets = 0; // más grandes que bucket_cap (si hay tope)
+    size_t overflow_entries = 0;  // items que el tope deja sin recorrer
+    // Histograma por potencias de dos: el bin i cuenta buckets con tamaño en
+    // [2^i, 2^(i+1)) y los items que contienen.
+    vector<size_t> histogram_buckets;
+    vector<size_t> histogram_items;
+};
+
+inline uint64_t elapsed_ns(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end) {
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+}
+
+// Conjunto de ids ya vistos para deduplicar candidatos sin hashing: un sello
+// por id y una época por consulta. begin() abre una consulta nueva en O(1)
+// (solo se limpia el arreglo cuando la época da la vuelta), y el arreglo se
+// reutiliza entre consultas, así que en régimen estable no reserva memoria.
+class VisitedSet {
+public:
+    // Prepara una consulta sobre ids en [0, num_ids).
+    void begin(size_t num_ids) {
+        if (stamps_.size() < num_ids) stamps_.resize(num_ids, 0);
+        if (++epoch_ == 0) {
+            fill(stamps_.begin(), stamps_.end(), 0);
+            epoch_ = 1;
+        }
+    }
+
+    // true si el id no se había visto en esta consulta.
+    bool insert(int id) {
+        if (stamps_[id] == epoch_) return false;
+        stamps_[id] = epoch_;
+        return true;
+    }
+
+    // Uno por hilo: las consultas en paralelo no comparten sellos.
+    static VisitedSet& for_thread() {
+        thread_local VisitedSet visited;
+        return visited;
+    }
+
+private:
+    vector<uint32_t> stamps_;
+    uint32_t epoch_ = 0;
+};
+
 class LSH {
 public:
     LSH(int num_tables, int hash_size)
@@ -29,37 +113,124 @@ public:
             string hash_key = hash_vector(vector, i);
             tables_[i][hash_key].insert(item_id);
         }
+        id_bound_ = max(id_bound_, static_cast<size_t>(item_id) + 1);
     }
 
-    unordered_set<int> query(const Vec& vector) {
-        unordered_set<int> candidates;
+    vector<int> query(const Vec& query_vector) {
+        vector<int> candidates;
+        probe(hash_all(query_vector), candidates);
+        return candidates;
+    }
+
+    // Calcula la llave de la consulta en cada tabla.
+    vector<string> hash_all(const Vec& query_vector) {
+        vector<string> keys;
+        keys.reserve(num_tables_);
         for (int i = 0; i < num_tables_; ++i) {
-            string hash_key = hash_vector(vector, i);
-            auto it = tables_[i].find(hash_key);
+            keys.push_back(hash_vector(query_vector, i));
+        }
+        return keys;
+    }
+
+    // Une los buckets correspondientes a las llaves en candidates (ids sin
+    // repetir, en orden de aparición); opcionalmente reporta su tamaño.
+    void probe(const vector<string>& keys, vector<int>& candidates, vector<size_t>* bucket_sizes = nullptr) {
+        candidates.clear();
+        VisitedSet& visited = VisitedSet::for_thread();
+        visited.begin(id_bound_);
+        for (int i = 0; i < num_tables_; ++i) {
+            auto it = tables_[i].find(keys[i]);
+            size_t bucket_size = 0;
             if (it != tables_[i].end()) {
-                candidates.insert(it->second.begin(), it->second.end());
+                bucket_size = it->second.size();
+                for (int item_id : it->second) {
+                    if (visited.insert(item_id)) candidates.push_back(item_id);
+                }
             }
+            if (bucket_sizes) bucket_sizes->push_back(bucket_size);
         }
-        return candidates;
     }
 
     void clear() {
         for (auto& table : tables_) {
             table.clear();
         }
+        id_bound_ = 0;
     }
 
 protected:
     int num_tables_;
     int hash_size_;
+    size_t id_bound_ = 0; // mayor id insertado + 1 (tamaño del VisitedSet)
     vector<unordered_map<string, unordered_set<int>>> tables_;
 };
 
 class SignedRandomProjectionLSH : public LSH {
 public:
-    SignedRandomProjectionLSH(int num_tables, int hash_size, int input_dim)
-        : LSH(num_tables, hash_size), input_dim_(input_dim) {
+    SignedRandomProjectionLSH(int num_tables, int hash_size, int input_dim, uint64_t seed = 42)
+        : LSH(num_tables, hash_size), input_dim_(input_dim), seed_(seed) {
         generateRandomPlanes();
+        buildProjectionMatrix();
+    }
+
+    int num_tables() const { return num_tables_; }
+    int hash_size() const { return hash_size_; }
+    int input_dim() const { return input_dim_; }
+    uint64_t seed() const { return seed_; }
+    const vector<double>& projection_matrix() const { return projections_; }
+
+    // Reemplaza los hiperplanos por los de un índice persistido, en el mismo
+    // orden que projection_matrix().
+    void load_projections(const double* projections) {
+        projections_.assign(projections, projections + static_cast<size_t>(num_tables_) * hash_size_ * input_dim_);
+        for (int table = 0; table < num_tables_; ++table) {
+            hyperplanes_[table].clear();
+            for (int k = 0; k < hash_size_; ++k) {
+                const double* normal = projections + (static_cast<size_t>(table) * hash_size_ + k) * input_dim_;
+                hyperplanes_[table].emplace_back(Vec(vector<double>(normal, normal + input_dim_)));
+            }
+        }
+    }
+
+    // Código entero de la tabla: el bit k es el lado del hiperplano k.
+    uint64_t hash_code(const double* vector, int table_idx) const {
+        check_code_bits();
+        double margins[MAX_CODE_BITS];
+        return hash_code(vector, table_idx, margins);
+    }
+
+    // Igual que hash_code, y además deja en margins[k] la proyección sobre el
+    // plano k: cuanto menor su valor absoluto, más cerca estuvo el bit de cambiar.
+    // Los planos de una tabla son filas contiguas: un solo simd_batch_dot.
+    uint64_t hash_code(const double* vector, int table_idx, double* margins) const {
+        const double* planes = projections_.data() + static_cast<size_t>(table_idx) * hash_size_ * input_dim_;
+        simd_batch_dot(vector, planes, hash_size_, input_dim_, margins);
+        return margins_to_code(margins);
+    }
+
+    // Códigos de n items contiguos (fila i en items + i * input_dim_) para todas
+    // las tablas: codes[t * n + i]. Es una GEMM (planos x items) por bloques de
+    // items, repartidos entre hilos, con los planos reutilizados desde caché.
+    void hash_codes(const double* items, size_t n, vector<uint64_t>& codes) const {
+        const size_t block = 64;
+        const size_t num_blocks = (n + block - 1) / block;
+        codes.assign(static_cast<size_t>(num_tables_) * n, 0);
+
+        check_code_bits();
+        const SimdKernels& kernels = simd_kernels();
+        #pragma omp parallel for schedule(static)
+        for (long long b = 0; b < static_cast<long long>(num_blocks); ++b) {
+            size_t begin = b * block;
+            size_t end = min(n, begin + block);
+            double margins[MAX_CODE_BITS];
+            for (int t = 0; t < num_tables_; ++t) {
+                const double* planes = projections_.data() + static_cast<size_t>(t) * hash_size_ * input_dim_;
+                for (size_t i = begin; i < end; ++i) {
+                    kernels.batch_dot(items + i * input_dim_, planes, hash_size_, input_dim_, margins);
+                    codes[static_cast<size_t>(t) * n + i] = margins_to_code(margins);
+                }
+            }
+        }
     }
 
     string hash_vector(const Vec& vector, int table_idx) override {
@@ -73,11 +244,41 @@ public:
     }
 
 private:
+    // Los códigos enteros tienen un bit por plano en un uint64_t.
+    static constexpr int MAX_CODE_BITS = 64;
+
     int input_dim_;
+    uint64_t seed_;
     vector<vector<Plane>> hyperplanes_;
+    // Normales de todos los planos en una sola matriz fila-mayor
+    // ((num_tables * hash_size) x input_dim), para el camino congelado.
+    vector<double> projections_;
+
+    void check_code_bits() const {
+        if (hash_size_ > MAX_CODE_BITS) throw invalid_argument("SignedRandomProjectionLSH: los códigos enteros soportan hasta 64 bits.");
+    }
+
+    // Bit k del código: el lado del plano k.
+    uint64_t margins_to_code(const double* margins) const {
+        uint64_t code = 0;
+        for (int k = 0; k < hash_size_; ++k) {
+            if (margins[k] >= 0.0) code |= uint64_t{1} << k;
+        }
+        return code;
+    }
+
+    void buildProjectionMatrix() {
+        projections_.reserve(static_cast<size_t>(num_tables_) * hash_size_ * input_dim_);
+        for (const auto& table_planes : hyperplanes_) {
+            for (const auto& plane : table_planes) {
+                const Vec& normal = plane.getNormal();
+                projections_.insert(projections_.end(), normal.data(), normal.data() + input_dim_);
+            }
+        }
+    }
 
     void generateRandomPlanes() {
-        mt19937 gen(42);
+        mt19937 gen(static_cast<mt19937::result_type>(seed_));
         normal_distribution<double> dist(0.0, 1.0);
 
         hyperplanes_.resize(num_tables_);
@@ -107,17 +308,189 @@ private:
     }
 };
 
+// Tabla congelada en formato CSR: los items del bucket b son
+// item_ids[bucket_offsets[b] .. bucket_offsets[b + 1]). Son vistas: apuntan a
+// memoria propia del índice (build) o a un archivo proyectado (load).
+struct FrozenTable {
+    span<const uint64_t> bucket_codes; // códigos distintos, ordenados
+    span<const uint32_t> bucket_offsets;
+    span<const int> item_ids;
+};
+
+// Secuencia de multi-probe dirigida por la consulta (Lv et al., 2007): el
+// bucket propio y luego los que resultan de invertir los conjuntos de bits de
+// menor costo, con costo = suma de margins[k]^2 de los bits invertidos. Los
+// conjuntos se enumeran en orden con un heap (operaciones shift/expand sobre
+// los bits ordenados por margen), sin repetir ninguno.
+inline void multiprobe_codes(uint64_t code, const double* margins, int hash_size, int num_probes, vector<uint64_t>& codes) {
+    codes.clear();
+    codes.push_back(code);
+    if (num_probes <= 1 || hash_size == 0) return;
+
+    vector<int> order(hash_size);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [margins](int a, int b) { return fabs(margins[a]) < fabs(margins[b]); });
+    vector<double> cost(hash_size);
+    for (int j = 0; j < hash_size; ++j) cost[j] = margins[order[j]] * margins[order[j]];
+
+    // Cada conjunto son posiciones crecientes dentro de order.
+    using Perturbation = pair<double, vector<int>>;
+    priority_queue<Perturbation, vector<Perturbation>, greater<>> heap;
+    heap.push({cost[0], {0}});
+    while (static_cast<int>(codes.size()) < num_probes && !heap.empty()) {
+        auto [score, set] = heap.top();
+        heap.pop();
+        uint64_t mask = 0;
+        for (int j : set) mask |= uint64_t{1} << order[j];
+        codes.push_back(code ^ mask);
+
+        int last = set.back();
+        if (last + 1 < hash_size) {
+            auto shifted = set;
+            shifted.back() = last + 1;
+            heap.push({score - cost[last] + cost[last + 1], move(shifted)});
+            auto expanded = set;
+            expanded.push_back(last + 1);
+            heap.push({score + cost[last + 1], move(expanded)});
+        }
+    }
+}
+
+// Huella de un conjunto de embeddings (FNV-1a sobre palabras de 64 bits);
+// identifica los vectores con los que se construyó un índice persistido.
+// Pasando una huella previa como hash se encadenan varios conjuntos.
+inline uint64_t embedding_checksum(const EmbeddingMatrix& vectors, uint64_t hash = 1469598103934665603ULL) {
+    const size_t count = vectors.size() * vectors.dimension();
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t word;
+        memcpy(&word, vectors.data() + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Orden de items para localidad (order[nuevo] = viejo): por el código SRP de
+// la primera tabla de un SignedRandomProjectionLSH(1, bits, dim, seed), leído
+// con el plano 0 como bit más significativo. Como los planos de la tabla 0
+// salen en secuencia de la semilla, los primeros h planos son los de la tabla
+// 0 de cualquier índice con la misma semilla y hash_size = h <= bits: con este
+// orden sus buckets quedan contiguos en la matriz de items, y los de las demás
+// tablas quedan cerca porque los vecinos angulares comparten prefijo.
+inline vector<int> srp_item_order(const EmbeddingMatrix& items, int bits = 32, uint64_t seed = 42) {
+    vector<int> order(items.size());
+    iota(order.begin(), order.end(), 0);
+    if (items.empty()) return order;
+    SignedRandomProjectionLSH lsh(1, bits, static_cast<int>(items.dimension()), seed);
+    vector<uint64_t> keys(items.size());
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < static_cast<long long>(items.size()); ++i) {
+        uint64_t code = lsh.hash_code(items.row(i), 0);
+        uint64_t key = 0;
+        for (int k = 0; k < bits; ++k) key |= ((code >> k) & 1) << (bits - 1 - k);
+        keys[i] = key;
+    }
+    stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+    return order;
+}
+
+// Ruta por defecto del índice persistido de un modelo para una configuración.
+inline string lsh_index_path(const string& model_name, int num_tables, int hash_size) {
+    return "../data/" + model_name + ".lsh." + to_string(num_tables) + "x" + to_string(hash_size) + ".index";
+}
+
 class LSHIndex {
 public:
     LSHIndex(SignedRandomProjectionLSH& lsh) : lsh_(lsh) {}
 
     void add(int item_id, const Vec& vector) {
+        if (frozen_) throw logic_error("LSHIndex: no se puede usar add() sobre un indice construido con build().");
         data_[item_id] = vector;
         lsh_.insert(vector, item_id);
     }
 
-    vector<pair<int, Vec>> find_candidates(const Vec& query_vector) {
-        auto candidate_ids = lsh_.query(query_vector);
+    // Construcción masiva: el item i recibe el id i. Calcula los códigos de todos
+    // los items en paralelo y arma cada tabla en su propio hilo, dejando el
+    // índice en la disposición congelada (CSR + matriz de items contigua).
+    void build(const EmbeddingMatrix& items);
+
+    // Persistencia del índice congelado: proyecciones, CSR por tabla e ids.
+    // load() proyecta el archivo en memoria y lo valida contra la cabecera
+    // (tablas, bits, dimensión, semilla) y la huella de los embeddings.
+    bool save(const string& filepath) const;
+    bool load(const string& filepath, const EmbeddingMatrix& items);
+    // Carga el índice si existe y corresponde a estos items; si no, lo construye y lo guarda.
+    void build_or_load(const EmbeddingMatrix& items, const string& filepath);
+
+    // Silencia los mensajes de build()/load()/save() (p. ej. en benchmarks).
+    void set_verbose(bool verbose) { verbose_ = verbose; }
+
+    // Buckets visitados por tabla en el camino congelado (1 = solo el propio);
+    // ver multiprobe_codes. Se fija antes de consultar, no durante.
+    void set_num_probes(int num_probes) { num_probes_ = max(1, num_probes); }
+    int num_probes() const { return num_probes_; }
+
+    // Re-ranking por Hamming: cada item guarda un sketch SRP de sketch_bits
+    // (64..256) bits y, si una consulta junta más de rerank_candidates
+    // candidatos, solo los rerank_candidates más cercanos en Hamming pasan al
+    // coseno exacto. Los sketches no van en el archivo del índice: se calculan
+    // al construir o cargar (o aquí mismo si el índice ya está congelado).
+    // sketch_bits = 0 lo desactiva.
+    void set_sketch_rerank(int sketch_bits, size_t rerank_candidates);
+    int sketch_bits() const { return sketcher_.bits(); }
+
+    // Puntuación en int8: los candidatos (tras el filtro por Hamming, si está
+    // activo) se puntúan con los items cuantizados (ver quantize.h, 8x menos
+    // memoria que la matriz double) y solo los rescore_candidates mejores se
+    // recalculan con el coseno exacto. Como los sketches, no se persiste.
+    void set_int8_scoring(bool enabled, size_t rescore_candidates);
+    bool int8_scoring() const { return int8_enabled_; }
+
+    // Puntuación por cuantización producto (ver pq.h) con num_subspaces
+    // subespacios de 4 bits: un item ocupa num_subspaces / 2 bytes. Va antes
+    // del int8 y del coseno exacto: solo los rescore_candidates mejores según
+    // PQ siguen adelante. El entrenamiento es determinista (semilla del LSH) y
+    // se repite en build()/load(). num_subspaces = 0 lo desactiva.
+    void set_pq_scoring(int num_subspaces, size_t rescore_candidates);
+    int pq_subspaces() const { return pq_.num_subspaces(); }
+
+    // Tope de items recorridos por bucket (0 = sin tope). Con tablas sesgadas
+    // (pocos bits) unos pocos buckets juntan miles de items; con tope, de un
+    // bucket más grande se recorre una submuestra determinista de bucket_cap
+    // items con paso fijo, empezando en un punto distinto en cada tabla para
+    // que las tablas no repitan la misma submuestra. Acota el costo de la
+    // consulta a num_tables x num_probes x bucket_cap candidatos.
+    void set_bucket_cap(size_t bucket_cap) { bucket_cap_ = bucket_cap; }
+    size_t bucket_cap() const { return bucket_cap_; }
+
+    LSHBucketStats bucket_stats() const;
+    // Resumen e histograma de ocupación en texto, para el log o los benchmarks.
+    void print_bucket_report(ostream& out) const;
+
+    // Bytes de las estructuras LSH congeladas (tablas CSR, proyecciones y sketches). No
+    // incluye la copia de los items, que es la misma para cualquier configuración.
+    size_t memory_bytes() const;
+
+    bool is_frozen() const { return frozen_; }
+    size_t size() const { return frozen_ ? num_items_ : data_.size(); }
+    double last_build_ms() const { return last_build_ms_; }
+
+    vector<pair<int, Vec>> find_candidates(ConstVecView query_vector, LSHQueryStats* stats = nullptr) {
+        if (frozen_) {
+            vector<pair<int, Vec>> candidates;
+            vector<int> candidate_ids;
+            frozen_candidates(query_vector, candidate_ids, stats);
+            for (int item_id : candidate_ids) {
+                const double* row = item_row(item_id);
+                candidates.push_back({item_id, Vec(vector<double>(row, row + dimension_))});
+            }
+            return candidates;
+        }
+
+        vector<int> candidate_ids;
+        auto t0 = chrono::steady_clock::now();
+        auto keys = lsh_.hash_all(Vec(query_vector));
+        auto t1 = chrono::steady_clock::now();
+        lsh_.probe(keys, candidate_ids, stats ? &stats->bucket_sizes : nullptr);
         vector<pair<int, Vec>> candidates;
 
         for (int item_id : candidate_ids) {
@@ -126,29 +499,109 @@ public:
                 candidates.push_back({item_id, it->second});
             }
         }
+        if (stats) {
+            stats->hashing_ns = elapsed_ns(t0, t1);
+            stats->probe_ns = elapsed_ns(t1, chrono::steady_clock::now());
+        }
         return candidates;
     }
 
-    vector<pair<int, double>> find_neighbors(const Vec& query_vector, int max_results = 10) {
-        auto candidates = find_candidates(query_vector);
+    vector<pair<int, double>> find_neighbors(ConstVecView query_vector, int max_results = 10, LSHQueryStats* stats = nullptr) {
+        if (frozen_) return find_neighbors_if(query_vector, max_results, [](int) { return true; }, stats);
+
+        auto candidates = find_candidates(query_vector, stats);
         vector<pair<int, double>> similarities;
 
+        auto t0 = chrono::steady_clock::now();
         for (const auto& candidate : candidates) {
             double similarity = calculateCosineSimilarity(query_vector, candidate.second);
             similarities.push_back({candidate.first, similarity});
         }
+        auto t1 = chrono::steady_clock::now();
 
         sortBySimilarity(similarities);
         limitResults(similarities, max_results);
 
+        if (stats) {
+            stats->scoring_ns = elapsed_ns(t0, t1);
+            stats->topk_ns = elapsed_ns(t1, chrono::steady_clock::now());
+            stats->num_candidates = candidates.size();
+            stats->num_rescored = candidates.size();
+        }
         return similarities;
     }
 
+    // Consulta sobre el índice congelado que descarta, antes de cualquier
+    // puntuación, los candidatos con accept(id) == false. Lo usa
+    // MutableLSHIndex para saltar items borrados o reemplazados sin
+    // reconstruir; accept se evalúa en el hilo que consulta.
+    template <typename Accept>
+    vector<pair<int, double>> find_neighbors_if(ConstVecView query_vector, int max_results, Accept accept,
+                                                LSHQueryStats* stats = nullptr);
+
 private:
     SignedRandomProjectionLSH& lsh_;
     unordered_map<int, Vec> data_;
 
-    double calculateCosineSimilarity(const Vec& vec1, const Vec& vec2) {
+    // Disposición congelada (solo si frozen_)
+    struct TableStorage {
+        vector<uint64_t> bucket_codes;
+        vector<uint32_t> bucket_offsets;
+        vector<int> item_ids;
+    };
+
+    bool frozen_ = false;
+    size_t num_items_ = 0;
+    size_t dimension_ = 0;
+    uint64_t checksum_ = 0;
+    EmbeddingMatrix item_matrix_; // num_items_ x dimension_
+    vector<double> item_norms_;
+    vector<FrozenTable> frozen_tables_;
+    vector<TableStorage> table_storage_;  // respaldo de frozen_tables_ tras build()
+    shared_ptr<MappedFile> mapped_file_;  // respaldo de frozen_tables_ tras load()
+    double last_build_ms_ = 0.0;
+    bool verbose_ = true;
+    int num_probes_ = 1;
+    size_t bucket_cap_ = 0;
+    SRPSketcher sketcher_;
+    size_t rerank_candidates_ = 0;
+    vector<uint64_t> item_sketches_; // num_items_ x sketcher_.words()
+    bool int8_enabled_ = false;
+    size_t int8_rescore_ = 0;
+    Int8ItemStore int8_items_;
+    ProductQuantizer pq_;
+    size_t pq_rescore_ = 0;
+    vector<uint8_t> pq_codes_; // num_items_ x pq_.code_bytes()
+
+    void copy_items(const EmbeddingMatrix& items);
+    void print_bucket_summary() const {
+        LSHBucketStats stats = bucket_stats();
+        cout << "  Buckets: " << stats.num_buckets << ", maximo " << stats.max_size
+             << " items, recorrido esperado por tabla " << stats.expected_scan << " items." << endl;
+    }
+    void compute_sketches() {
+        if (sketcher_.bits() > 0) sketcher_.sketch_all(item_matrix_.data(), num_items_, item_sketches_);
+        else item_sketches_.clear();
+    }
+    void compute_int8_items() {
+        if (int8_enabled_) int8_items_.build(item_matrix_.data(), num_items_, dimension_);
+        else int8_items_.clear();
+    }
+    void compute_pq_codes() {
+        pq_codes_.clear();
+        if (pq_.num_subspaces() == 0 || num_items_ == 0) return;
+        pq_.train(item_matrix_.data(), num_items_, lsh_.seed());
+        pq_.encode(item_matrix_.data(), num_items_, pq_codes_);
+    }
+
+    const double* item_row(int item_id) const {
+        return item_matrix_.data() + static_cast<size_t>(item_id) * dimension_;
+    }
+
+    // Candidatos sin repetir (ids densos, listos para puntuar) en candidate_ids.
+    void frozen_candidates(ConstVecView query_vector, vector<int>& candidate_ids, LSHQueryStats* stats);
+
+    double calculateCosineSimilarity(ConstVecView vec1, ConstVecView vec2) {
         double dot_product = dot(vec1, vec2);
         double magnitude_product = vec1.magnitude() * vec2.magnitude();
         return dot_product / magnitude_product;
@@ -166,4 +619,488 @@ private:
             similarities.resize(max_results);
         }
     }
-};
\ No newline at end of file
+};
+
+inline void LSHIndex::build(const EmbeddingMatrix& items) {
+    if (!data_.empty()) throw logic_error("LSHIndex: build() requiere un indice vacio.");
+    if (lsh_.hash_size() > 64) throw invalid_argument("LSHIndex: build() soporta hasta 64 bits por tabla.");
+    auto start = chrono::steady_clock::now();
+
+    num_items_ = items.size();
+    dimension_ = lsh_.input_dim();
+    const int num_tables = lsh_.num_tables();
+
+    // 1. Matriz de items contigua y normas precalculadas.
+    copy_items(items);
+    compute_sketches();
+    compute_int8_items();
+    compute_pq_codes();
+
+    // 2. Códigos de todos los items para todas las tablas (GEMM por bloques).
+    vector<uint64_t> codes;
+    lsh_.hash_codes(item_matrix_.data(), num_items_, codes);
+
+    // 3. Una tabla por hilo: ordenar ids por código y comprimir en CSR.
+    table_storage_.assign(num_tables, TableStorage{});
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < num_tables; ++t) {
+        const uint64_t* table_codes = codes.data() + static_cast<size_t>(t) * num_items_;
+        TableStorage& table = table_storage_[t];
+        table.item_ids.resize(num_items_);
+        iota(table.item_ids.begin(), table.item_ids.end(), 0);
+        stable_sort(table.item_ids.begin(), table.item_ids.end(),
+                    [table_codes](int a, int b) { return table_codes[a] < table_codes[b]; });
+        for (size_t i = 0; i < num_items_; ++i) {
+            uint64_t code = table_codes[table.item_ids[i]];
+            if (table.bucket_codes.empty() || table.bucket_codes.back() != code) {
+                table.bucket_codes.push_back(code);
+                table.bucket_offsets.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        table.bucket_offsets.push_back(static_cast<uint32_t>(num_items_));
+    }
+    frozen_tables_.clear();
+    for (const auto& table : table_storage_) {
+        frozen_tables_.push_back({table.bucket_codes, table.bucket_offsets, table.item_ids});
+    }
+
+    checksum_ = embedding_checksum(items);
+    frozen_ = true;
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    last_build_ms_ = elapsed.count();
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    if (verbose_) cout << "Indice LSH construido: " << num_items_ << " items, " << num_tables << " tablas, "
+         << lsh_.hash_size() << " bits, " << threads << " hilos, " << last_build_ms_ << " ms." << endl;
+    if (verbose_) print_bucket_summary();
+}
+
+inline void LSHIndex::copy_items(const EmbeddingMatrix& items) {
+    if (!items.empty() && items.dimension() != dimension_) {
+        throw invalid_argument("LSHIndex: dimension de item incorrecta.");
+    }
+    item_matrix_ = items;
+    item_norms_.resize(num_items_);
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < static_cast<long long>(num_items_); ++i) {
+        item_norms_[i] = items[i].magnitude();
+    }
+}
+
+// --- Formato de archivo del índice (little-endian, nativo) ---
+// [cabecera][directorio: una entrada por tabla][proyecciones][por tabla: códigos, offsets, ids]
+// Cada arreglo empieza alineado a 64 bytes para poder usarse directo desde el mmap.
+struct LSHIndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_tables;
+    uint32_t hash_size;
+    uint32_t dimension;
+    uint64_t seed;
+    uint64_t num_items;
+    uint64_t embedding_checksum;
+    uint64_t projections_offset;
+};
+
+struct LSHIndexFileTable {
+    uint64_t num_buckets;
+    uint64_t codes_offset;
+    uint64_t offsets_offset;
+    uint64_t ids_offset;
+};
+
+constexpr char LSH_INDEX_MAGIC[8] = {'S', 'R', 'P', 'R', 'L', 'S', 'H', 'I'};
+constexpr uint32_t LSH_INDEX_VERSION = 1;
+
+inline bool LSHIndex::save(const string& filepath) const {
+    if (!frozen_) {
+        cerr << "Error: solo se puede guardar un indice construido con build()." << endl;
+        return false;
+    }
+    // Se escribe a un temporal y se renombra: un indice vivo puede tener el
+    // archivo anterior mapeado con MAP_SHARED, y truncarlo en sitio le quitaria
+    // las paginas (SIGBUS). Tras el rename el mapeo viejo conserva su inodo.
+    const string tmp_path = filepath + ".tmp";
+    ofstream out_file(tmp_path, ios::binary);
+    if (!out_file.is_open()) {
+        cerr << "Error: No se pudo abrir el archivo para guardar el indice: " << tmp_path << endl;
+        return false;
+    }
+
+    auto align = [](uint64_t offset) { return (offset + 63) & ~uint64_t{63}; };
+    const int num_tables = lsh_.num_tables();
+    const auto& projections = lsh_.projection_matrix();
+
+    LSHIndexFileHeader header{};
+    copy(begin(LSH_INDEX_MAGIC), end(LSH_INDEX_MAGIC), header.magic);
+    header.version = LSH_INDEX_VERSION;
+    header.num_tables = num_tables;
+    header.hash_size = lsh_.hash_size();
+    header.dimension = dimension_;
+    header.seed = lsh_.seed();
+    header.num_items = num_items_;
+    header.embedding_checksum = checksum_;
+
+    // Primero se calculan todos los offsets, luego se escribe en orden.
+    uint64_t offset = align(sizeof(header) + num_tables * sizeof(LSHIndexFileTable));
+    header.projections_offset = offset;
+    offset = align(offset + projections.size() * sizeof(double));
+    vector<LSHIndexFileTable> directory(num_tables);
+    for (int t = 0; t < num_tables; ++t) {
+        const FrozenTable& table = frozen_tables_[t];
+        directory[t].num_buckets = table.bucket_codes.size();
+        directory[t].codes_offset = offset;
+        offset = align(offset + table.bucket_codes.size_bytes());
+        directory[t].offsets_offset = offset;
+        offset = align(offset + table.bucket_offsets.size_bytes());
+        directory[t].ids_offset = offset;
+        offset = align(offset + table.item_ids.size_bytes());
+    }
+
+    auto write_at = [&out_file](uint64_t position, const void* data, size_t bytes) {
+        static const char padding[64] = {};
+        while (static_cast<uint64_t>(out_file.tellp()) < position) {
+            out_file.write(padding, min<uint64_t>(64, position - out_file.tellp()));
+        }
+        out_file.write(static_cast<const char*>(data), bytes);
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(sizeof(header), directory.data(), directory.size() * sizeof(LSHIndexFileTable));
+    write_at(header.projections_offset, projections.data(), projections.size() * sizeof(double));
+    for (int t = 0; t < num_tables; ++t) {
+        const FrozenTable& table = frozen_tables_[t];
+        write_at(directory[t].codes_offset, table.bucket_codes.data(), table.bucket_codes.size_bytes());
+        write_at(directory[t].offsets_offset, table.bucket_offsets.data(), table.bucket_offsets.size_bytes());
+        write_at(directory[t].ids_offset, table.item_ids.data(), table.item_ids.size_bytes());
+    }
+    out_file.close();
+    if (!out_file) {
+        cerr << "Error: fallo la escritura del indice en " << tmp_path << endl;
+        error_code ignored;
+        filesystem::remove(tmp_path, ignored);
+        return false;
+    }
+    error_code ec;
+    filesystem::rename(tmp_path, filepath, ec);
+    if (ec) {
+        cerr << "Error: no se pudo reemplazar " << filepath << ": " << ec.message() << endl;
+        return false;
+    }
+    if (verbose_) cout << "Indice LSH guardado en: " << filepath << endl;
+    return true;
+}
+
+inline bool LSHIndex::load(const string& filepath, const EmbeddingMatrix& items) {
+    if (frozen_ || !data_.empty()) throw logic_error("LSHIndex: load() requiere un indice vacio.");
+    auto start = chrono::steady_clock::now();
+    auto file = make_shared<MappedFile>();
+    if (!file->open(filepath)) return false;
+
+    const auto* header = file->at<LSHIndexFileHeader>(0);
+    if (!header || !equal(begin(LSH_INDEX_MAGIC), end(LSH_INDEX_MAGIC), header->magic) ||
+        header->version != LSH_INDEX_VERSION) {
+        cerr << "Error: " << filepath << " no es un indice LSH valido." << endl;
+        return false;
+    }
+    if (header->num_tables != static_cast<uint32_t>(lsh_.num_tables()) ||
+        header->hash_size != static_cast<uint32_t>(lsh_.hash_size()) ||
+        header->dimension != static_cast<uint32_t>(lsh_.input_dim()) ||
+        header->seed != lsh_.seed() || header->num_items != items.size()) {
+        cerr << "Error: los parametros del indice en " << filepath << " no coinciden. Se reconstruira." << endl;
+        return false;
+    }
+    uint64_t checksum = embedding_checksum(items);
+    if (header->embedding_checksum != checksum) {
+        cerr << "Error: el indice en " << filepath << " se construyo con otros embeddings. Se reconstruira." << endl;
+        return false;
+    }
+
+    const size_t num_tables = header->num_tables;
+    const auto* directory = file->at<LSHIndexFileTable>(sizeof(LSHIndexFileHeader), num_tables);
+    const auto* projections = file->at<double>(header->projections_offset,
+                                               num_tables * header->hash_size * header->dimension);
+    if (!directory || !projections) {
+        cerr << "Error: indice truncado en " << filepath << endl;
+        return false;
+    }
+    vector<FrozenTable> tables;
+    for (size_t t = 0; t < num_tables; ++t) {
+        const auto& entry = directory[t];
+        const auto* codes = file->at<uint64_t>(entry.codes_offset, entry.num_buckets);
+        const auto* offsets = file->at<uint32_t>(entry.offsets_offset, entry.num_buckets + 1);
+        const auto* ids = file->at<int>(entry.ids_offset, header->num_items);
+        if (!codes || !offsets || !ids || offsets[entry.num_buckets] != header->num_items) {
+            cerr << "Error: indice truncado en " << filepath << endl;
+            return false;
+        }
+        // La suma de control solo cubre los embeddings: los rangos de cubeta y
+        // los ids se validan aqui para no leer fuera del mapeo al consultar.
+        const bool monotonic = is_sorted(offsets, offsets + entry.num_buckets + 1);
+        const bool ids_in_range = all_of(ids, ids + header->num_items, [&](int id) {
+            return id >= 0 && static_cast<uint64_t>(id) < header->num_items;
+        });
+        if (!monotonic || !ids_in_range) {
+            cerr << "Error: indice corrupto en " << filepath << ". Se reconstruira." << endl;
+            return false;
+        }
+        tables.push_back({{codes, entry.num_buckets}, {offsets, entry.num_buckets + 1}, {ids, header->num_items}});
+    }
+
+    lsh_.load_projections(projections);
+    num_items_ = items.size();
+    dimension_ = lsh_.input_dim();
+    copy_items(items);
+    compute_sketches();
+    compute_int8_items();
+    compute_pq_codes();
+    frozen_tables_ = move(tables);
+    mapped_file_ = move(file);
+    checksum_ = checksum;
+    frozen_ = true;
+
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    if (verbose_) cout << "Indice LSH cargado desde " << filepath << " en " << elapsed.count() << " ms." << endl;
+    if (verbose_) print_bucket_summary();
+    return true;
+}
+
+inline void LSHIndex::build_or_load(const EmbeddingMatrix& items, const string& filepath) {
+    if (load(filepath, items)) return;
+    build(items);
+    save(filepath);
+}
+
+inline size_t LSHIndex::memory_bytes() const {
+    size_t bytes = lsh_.projection_matrix().size() * sizeof(double);
+    for (const auto& table : frozen_tables_) {
+        bytes += table.bucket_codes.size_bytes() + table.bucket_offsets.size_bytes() + table.item_ids.size_bytes();
+    }
+    return bytes + item_sketches_.size() * sizeof(uint64_t) + int8_items_.memory_bytes() +
+           pq_codes_.size() + pq_.memory_bytes();
+}
+
+inline void LSHIndex::set_pq_scoring(int num_subspaces, size_t rescore_candidates) {
+    if (!data_.empty()) throw logic_error("LSHIndex: la puntuacion PQ requiere build() o load().");
+    pq_ = num_subspaces > 0 ? ProductQuantizer(lsh_.input_dim(), num_subspaces) : ProductQuantizer();
+    pq_rescore_ = rescore_candidates;
+    if (frozen_) compute_pq_codes();
+}
+
+inline void LSHIndex::set_int8_scoring(bool enabled, size_t rescore_candidates) {
+    if (!data_.empty()) throw logic_error("LSHIndex: la puntuacion int8 requiere build() o load().");
+    int8_enabled_ = enabled;
+    int8_rescore_ = rescore_candidates;
+    if (frozen_) compute_int8_items();
+}
+
+inline LSHBucketStats LSHIndex::bucket_stats() const {
+    LSHBucketStats stats;
+    double sum_squares = 0.0;
+    for (const auto& table : frozen_tables_) {
+        for (size_t b = 0; b + 1 < table.bucket_offsets.size(); ++b) {
+            size_t size = table.bucket_offsets[b + 1] - table.bucket_offsets[b];
+            if (size == 0) continue;
+            size_t bin = bit_width(size) - 1;
+            if (stats.histogram_buckets.size() <= bin) {
+                stats.histogram_buckets.resize(bin + 1, 0);
+                stats.histogram_items.resize(bin + 1, 0);
+            }
+            stats.histogram_buckets[bin]++;
+            stats.histogram_items[bin] += size;
+            stats.num_buckets++;
+            stats.num_entries += size;
+            stats.max_size = max(stats.max_size, size);
+            sum_squares += static_cast<double>(size) * size;
+            if (bucket_cap_ > 0 && size > bucket_cap_) {
+                stats.oversized_buckets++;
+                stats.overflow_entries += size - bucket_cap_;
+            }
+        }
+    }
+    if (stats.num_entries > 0) stats.expected_scan = sum_squares / stats.num_entries;
+    return stats;
+}
+
+inline void LSHIndex::print_bucket_report(ostream& out) const {
+    LSHBucketStats stats = bucket_stats();
+    out << "Ocupacion de buckets (" << lsh_.num_tables() << " tablas, " << lsh_.hash_size() << " bits): "
+        << stats.num_buckets << " buckets, maximo " << stats.max_size << " items, recorrido esperado por tabla "
+        << stats.expected_scan << " items." << endl;
+    if (bucket_cap_ > 0) {
+        out << "  Tope " << bucket_cap_ << ": " << stats.oversized_buckets << " buckets lo superan, "
+            << stats.overflow_entries << " entradas fuera del recorrido." << endl;
+    }
+    for (size_t bin = 0; bin < stats.histogram_buckets.size(); ++bin) {
+        if (stats.histogram_buckets[bin] == 0) continue;
+        double item_share = 100.0 * stats.histogram_items[bin] / stats.num_entries;
+        out << "  [" << (size_t{1} << bin) << ", " << (size_t{1} << (bin + 1)) << "): "
+            << stats.histogram_buckets[bin] << " buckets, " << item_share << "% de los items" << endl;
+    }
+}
+
+inline void LSHIndex::set_sketch_rerank(int sketch_bits, size_t rerank_candidates) {
+    if (!data_.empty()) throw logic_error("LSHIndex: el re-ranking por Hamming requiere build() o load().");
+    sketcher_ = sketch_bits > 0 ? SRPSketcher(sketch_bits, lsh_.input_dim(), lsh_.seed()) : SRPSketcher();
+    rerank_candidates_ = rerank_candidates;
+    if (frozen_) compute_sketches();
+}
+
+inline void LSHIndex::frozen_candidates(ConstVecView query_vector, vector<int>& candidate_ids, LSHQueryStats* stats) {
+    auto t0 = chrono::steady_clock::now();
+    const int num_tables = lsh_.num_tables();
+    const int hash_size = lsh_.hash_size();
+    // probe_codes[t * num_probes_ + p]: bucket p de la tabla t.
+    vector<uint64_t> probe_codes(static_cast<size_t>(num_tables) * num_probes_);
+    size_t codes_per_table = 1;
+    if (num_probes_ == 1) {
+        for (int t = 0; t < num_tables; ++t) {
+            probe_codes[t] = lsh_.hash_code(query_vector.data(), t);
+        }
+    } else {
+        vector<double> margins(hash_size);
+        vector<uint64_t> table_codes;
+        for (int t = 0; t < num_tables; ++t) {
+            uint64_t code = lsh_.hash_code(query_vector.data(), t, margins.data());
+            multiprobe_codes(code, margins.data(), hash_size, num_probes_, table_codes);
+            table_codes.resize(num_probes_, table_codes.back()); // con pocos bits hay menos buckets que probes
+            copy(table_codes.begin(), table_codes.end(), probe_codes.begin() + static_cast<size_t>(t) * num_probes_);
+        }
+        codes_per_table = num_probes_;
+    }
+    auto t1 = chrono::steady_clock::now();
+
+    candidate_ids.clear();
+    VisitedSet& visited = VisitedSet::for_thread();
+    visited.begin(num_items_);
+    for (int t = 0; t < num_tables; ++t) {
+        const FrozenTable& table = frozen_tables_[t];
+        for (size_t p = 0; p < codes_per_table; ++p) {
+            uint64_t code = probe_codes[t * codes_per_table + p];
+            if (p > 0 && code == probe_codes[t * codes_per_table + p - 1]) break; // relleno repetido
+            auto it = lower_bound(table.bucket_codes.begin(), table.bucket_codes.end(), code);
+            size_t bucket_size = 0;
+            if (it != table.bucket_codes.end() && *it == code) {
+                size_t b = it - table.bucket_codes.begin();
+                uint32_t begin = table.bucket_offsets[b], end = table.bucket_offsets[b + 1];
+                bucket_size = end - begin;
+                if (bucket_cap_ == 0 || bucket_size <= bucket_cap_) {
+                    for (uint32_t i = begin; i < end; ++i) {
+                        int item_id = table.item_ids[i];
+                        if (visited.insert(item_id)) candidate_ids.push_back(item_id);
+                    }
+                } else {
+                    // Submuestra determinista: bucket_cap posiciones equiespaciadas,
+                    // desfasadas según la tabla.
+                    size_t phase = static_cast<size_t>(t) * bucket_size / num_tables;
+                    for (size_t i = 0; i < bucket_cap_; ++i) {
+                        size_t position = (phase + i * bucket_size / bucket_cap_) % bucket_size;
+                        int item_id = table.item_ids[begin + position];
+                        if (visited.insert(item_id)) candidate_ids.push_back(item_id);
+                    }
+                    bucket_size = bucket_cap_;
+                }
+            }
+            if (stats) stats->bucket_sizes.push_back(bucket_size);
+        }
+    }
+    if (stats) {
+        stats->hashing_ns = elapsed_ns(t0, t1);
+        stats->probe_ns = elapsed_ns(t1, chrono::steady_clock::now());
+    }
+}
+
+template <typename Accept>
+vector<pair<int, double>> LSHIndex::find_neighbors_if(ConstVecView query_vector, int max_results, Accept accept,
+                                                      LSHQueryStats* stats) {
+    if (!frozen_) throw logic_error("LSHIndex: find_neighbors_if() requiere build() o load().");
+    // Búferes por hilo reutilizados entre consultas.
+    thread_local vector<int> rescored;
+    thread_local vector<uint32_t> distances;
+    thread_local vector<uint64_t> keys;
+    frozen_candidates(query_vector, rescored, stats);
+    const size_t num_candidates = rescored.size();
+    erase_if(rescored, [&accept](int item_id) { return !accept(item_id); });
+
+    auto t0 = chrono::steady_clock::now();
+    const size_t keep = max(rerank_candidates_, static_cast<size_t>(max(0, max_results)));
+    if (!item_sketches_.empty() && rescored.size() > keep) {
+        // Filtro por Hamming: (distancia << 32 | id) ordena por distancia y
+        // desempata por id.
+        const int words = sketcher_.words();
+        uint64_t query_sketch[SRPSketcher::kMaxBits / 64];
+        sketcher_.sketch(query_vector.data(), query_sketch);
+        distances.resize(rescored.size());
+        hamming_distances(item_sketches_.data(), words, query_sketch, rescored.data(), rescored.size(), distances.data());
+        keys.resize(rescored.size());
+        for (size_t i = 0; i < rescored.size(); ++i) {
+            keys[i] = (static_cast<uint64_t>(distances[i]) << 32) | static_cast<uint32_t>(rescored[i]);
+        }
+        nth_element(keys.begin(), keys.begin() + keep, keys.end());
+        rescored.resize(keep);
+        for (size_t i = 0; i < keep; ++i) rescored[i] = static_cast<int>(keys[i] & 0xFFFFFFFFu);
+    }
+
+    const size_t pq_keep = max(pq_rescore_, static_cast<size_t>(max(0, max_results)));
+    if (!pq_codes_.empty() && rescored.size() > pq_keep) {
+        // ADC con fast-scan; (65535 - puntaje) << 32 | id ordena de mejor a peor y desempata por id.
+        thread_local vector<uint8_t> lut;
+        thread_local vector<uint16_t> pq_scores;
+        thread_local vector<double> normalized_query;
+        lut.resize(static_cast<size_t>(pq_.num_subspaces()) * ProductQuantizer::kCentroids);
+        normalized_query.resize(dimension_);
+        pq_normalized_row(query_vector.data(), dimension_, normalized_query.data());
+        pq_.compute_tables(normalized_query.data(), lut.data());
+        pq_scores.resize(rescored.size());
+        pq_.scan(lut.data(), pq_codes_.data(), rescored.data(), rescored.size(), pq_scores.data());
+        keys.resize(rescored.size());
+        for (size_t i = 0; i < rescored.size(); ++i) {
+            keys[i] = (static_cast<uint64_t>(65535 - pq_scores[i]) << 32) | static_cast<uint32_t>(rescored[i]);
+        }
+        nth_element(keys.begin(), keys.begin() + pq_keep, keys.end());
+        rescored.resize(pq_keep);
+        for (size_t i = 0; i < pq_keep; ++i) rescored[i] = static_cast<int>(keys[i] & 0xFFFFFFFFu);
+    }
+
+    const size_t exact_keep = max(int8_rescore_, static_cast<size_t>(max(0, max_results)));
+    if (int8_enabled_ && rescored.size() > exact_keep) {
+        thread_local vector<int8_t> query_codes;
+        thread_local vector<float> approx;
+        thread_local vector<pair<float, int>> ranked;
+        query_codes.resize(int8_items_.padded_dim());
+        quantize_int8(query_vector.data(), dimension_, query_codes.data());
+        approx.resize(rescored.size());
+        int8_items_.scores(query_codes.data(), rescored.data(), rescored.size(), approx.data());
+        ranked.resize(rescored.size());
+        for (size_t i = 0; i < rescored.size(); ++i) ranked[i] = {approx[i], rescored[i]};
+        // Mayor puntaje primero; a igual puntaje, menor id.
+        nth_element(ranked.begin(), ranked.begin() + exact_keep, ranked.end(),
+                    [](const pair<float, int>& a, const pair<float, int>& b) {
+                        return a.first != b.first ? a.first > b.first : a.second < b.second;
+                    });
+        rescored.resize(exact_keep);
+        for (size_t i = 0; i < exact_keep; ++i) rescored[i] = ranked[i].second;
+    }
+
+    const double query_norm = query_vector.magnitude();
+    vector<pair<int, double>> similarities;
+    similarities.reserve(rescored.size());
+    const auto dot_kernel = simd_kernels().dot;
+    for (int item_id : rescored) {
+        double dot_product = dot_kernel(item_row(item_id), query_vector.data(), dimension_);
+        similarities.push_back({item_id, dot_product / (query_norm * item_norms_[item_id])});
+    }
+    auto t1 = chrono::steady_clock::now();
+
+    sortBySimilarity(similarities);
+    limitResults(similarities, max_results);
+
+    if (stats) {
+        stats->scoring_ns = elapsed_ns(t0, t1);
+        stats->topk_ns = elapsed_ns(t1, chrono::steady_clock::now());
+        stats->num_candidates = num_candidates;
+        stats->num_rescored = rescored.size();
+    }
+    return similarities;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "vec.h"
+
+using namespace std;
+
+// Embeddings de un modelo como una sola matriz fila-mayor (rows x dimension)
+// en un bloque alineado a 64 bytes, en vez de un Vec (y una reserva) por
+// usuario o item. Las filas se entregan como VecView/ConstVecView, sin copiar;
+// data() es la matriz completa, lista para copiarse de una vez, para un mmap
+// o para kernels tipo GEMM (LSHIndex::build). Sin relleno entre filas: la
+// fila i empieza en data() + i * dimension.
+class EmbeddingMatrix {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    EmbeddingMatrix() = default;
+    EmbeddingMatrix(size_t rows, size_t dimension, double value = 0.0);
+    // Copia un vector<Vec> (todos de la misma dimensión).
+    explicit EmbeddingMatrix(const vector<Vec>& vectors);
+    EmbeddingMatrix(const EmbeddingMatrix& other);
+    EmbeddingMatrix(EmbeddingMatrix&& other) noexcept
+        : values_(move(other.values_)), rows_(exchange(other.rows_, 0)), dimension_(exchange(other.dimension_, 0)) {}
+    EmbeddingMatrix& operator=(const EmbeddingMatrix& other);
+    EmbeddingMatrix& operator=(EmbeddingMatrix&& other) noexcept {
+        values_ = move(other.values_);
+        rows_ = exchange(other.rows_, 0);
+        dimension_ = exchange(other.dimension_, 0);
+        return *this;
+    }
+
+    size_t size() const { return rows_; }
+    bool empty() const { return rows_ == 0; }
+    size_t dimension() const { return dimension_; }
+    double* data() { return values_.get(); }
+    const double* data() const { return values_.get(); }
+
+    double* row(size_t index) { return values_.get() + index * dimension_; }
+    const double* row(size_t index) const { return values_.get() + index * dimension_; }
+    VecView operator[](size_t index) { return {row(index), dimension_}; }
+    ConstVecView operator[](size_t index) const { return {row(index), dimension_}; }
+    // Como vector::at: out_of_range si index >= size().
+    VecView at(size_t index);
+    ConstVecView at(size_t index) const;
+
+    // Cambia la cantidad de filas conservando las existentes; las nuevas
+    // quedan en value.
+    void resize(size_t rows, double value = 0.0);
+    // Reordena las filas: la nueva fila i es la vieja order[i].
+    void permute_rows(const vector<int>& order);
+
+private:
+    struct AlignedDelete {
+        void operator()(double* values) const { ::operator delete[](values, align_val_t(ALIGNMENT)); }
+    };
+    using Storage = unique_ptr<double[], AlignedDelete>;
+
+    static Storage allocate(size_t count) {
+        return Storage(static_cast<double*>(::operator new[](max<size_t>(1, count) * sizeof(double),
+                                                              align_val_t(ALIGNMENT))));
+    }
+
+    Storage values_;
+    size_t rows_ = 0;
+    size_t dimension_ = 0;
+};
+
+inline EmbeddingMatrix::EmbeddingMatrix(size_t rows, size_t dimension, double value)
+    : values_(allocate(rows * dimension)), rows_(rows), dimension_(dimension) {
+    fill(values_.get(), values_.get() + rows * dimension, value);
+}
+
+inline EmbeddingMatrix::EmbeddingMatrix(const vector<Vec>& vectors)
+    : EmbeddingMatrix(vectors.size(), vectors.empty() ? 0 : vectors[0].getDimension()) {
+    for (size_t i = 0; i < rows_; ++i) {
+        if (vectors[i].getDimension() != dimension_) throw invalid_argument("EmbeddingMatrix: dimensiones distintas.");
+        copy(vectors[i].data(), vectors[i].data() + dimension_, row(i));
+    }
+}
+
+inline EmbeddingMatrix::EmbeddingMatrix(const EmbeddingMatrix& other)
+    : values_(allocate(other.rows_ * other.dimension_)), rows_(other.rows_), dimension_(other.dimension_) {
+    copy(other.data(), other.data() + rows_ * dimension_, data());
+}
+
+inline EmbeddingMatrix& EmbeddingMatrix::operator=(const EmbeddingMatrix& other) {
+    if (this == &other) return *this;
+    if (rows_ * dimension_ != other.rows_ * other.dimension_) values_ = allocate(other.rows_ * other.dimension_);
+    rows_ = other.rows_;
+    dimension_ = other.dimension_;
+    copy(other.data(), other.data() + rows_ * dimension_, data());
+    return *this;
+}
+
+inline VecView EmbeddingMatrix::at(size_t index) {
+    if (index >= rows_) throw out_of_range("EmbeddingMatrix: fila " + to_string(index) + " fuera de rango.");
+    return (*this)[index];
+}
+
+inline ConstVecView EmbeddingMatrix::at(size_t index) const {
+    if (index >= rows_) throw out_of_range("EmbeddingMatrix: fila " + to_string(index) + " fuera de rango.");
+    return (*this)[index];
+}
+
+inline void EmbeddingMatrix::resize(size_t rows, double value) {
+    if (rows == rows_) return;
+    Storage values = allocate(rows * dimension_);
+    const size_t kept = min(rows, rows_) * dimension_;
+    copy(data(), data() + kept, values.get());
+    fill(values.get() + kept, values.get() + rows * dimension_, value);
+    values_ = move(values);
+    rows_ = rows;
+}
+
+inline void EmbeddingMatrix::permute_rows(const vector<int>& order) {
+    if (order.size() != rows_) throw invalid_argument("EmbeddingMatrix: el orden no cubre todas las filas.");
+    Storage values = allocate(rows_ * dimension_);
+    for (size_t i = 0; i < rows_; ++i) copy(row(order[i]), row(order[i]) + dimension_, values.get() + i * dimension_);
+    values_ = move(values);
+}
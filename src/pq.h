@@ -0,0 +1,242 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "simd.h"  // SRPR_X86_DISPATCH e <immintrin.h>
+#include "vec.h"
+
+using namespace std;
+
+// Cuantización producto (Jégou et al., 2011) con 16 centroides por subespacio,
+// es decir, códigos de 4 bits: dos subespacios por byte. Se entrena sobre los
+// items normalizados, así el producto interno aproximado ordena por coseno.
+//
+// La puntuación es asimétrica (ADC): la consulta no se cuantiza; por cada
+// subespacio se calcula su producto con los 16 centroides y la puntuación de
+// un item es la suma de las entradas que indican sus códigos. Las tablas se
+// cuantizan a uint8 (desplazadas por el mínimo de cada subespacio, con una
+// escala común) para que 16 entradas quepan en un registro de 128 bits y la
+// búsqueda se haga con pshufb sobre 32 items a la vez ("fast-scan", André et
+// al., 2015). Las sumas uint16 son exactas, así que la versión SIMD y la
+// portable dan el mismo resultado.
+class ProductQuantizer {
+public:
+    static constexpr int kCentroids = 16;
+    static constexpr size_t kBlock = 32;     // items por bloque del fast-scan
+    static constexpr int kMaxSubspaces = 256; // la suma uint16 no desborda: 256 * 255 < 65536
+
+    ProductQuantizer() = default;
+    ProductQuantizer(size_t dimension, int num_subspaces) : dimension_(dimension), num_subspaces_(num_subspaces) {
+        if (num_subspaces <= 0 || num_subspaces > kMaxSubspaces || num_subspaces % 2 != 0 ||
+            dimension % num_subspaces != 0) {
+            throw invalid_argument("ProductQuantizer: num_subspaces debe ser par, <= 256 y dividir la dimension.");
+        }
+        sub_dim_ = dimension / num_subspaces;
+    }
+
+    size_t dimension() const { return dimension_; }
+    int num_subspaces() const { return num_subspaces_; }
+    size_t code_bytes() const { return num_subspaces_ / 2; }
+    bool trained() const { return !centroids_.empty(); }
+    size_t memory_bytes() const { return centroids_.size() * sizeof(double); }
+
+    // k-means (k = 16) independiente por subespacio sobre hasta max_train items
+    // elegidos con la semilla; determinista para la misma entrada.
+    void train(const double* items, size_t num_items, uint64_t seed = 42, int iterations = 20,
+               size_t max_train = 65536);
+    void train(const vector<Vec>& items, uint64_t seed = 42, int iterations = 20, size_t max_train = 65536) {
+        vector<double> matrix(items.size() * dimension_);
+        for (size_t i = 0; i < items.size(); ++i) copy(items[i].data(), items[i].data() + dimension_, matrix.data() + i * dimension_);
+        train(matrix.data(), items.size(), seed, iterations, max_train);
+    }
+
+    // codes[i * code_bytes() + j]: subespacio 2j en el nibble bajo, 2j+1 en el alto.
+    void encode(const double* items, size_t num_items, vector<uint8_t>& codes) const;
+
+    // Tablas uint8 de la consulta: lut[m * 16 + c] ~ <q_m, centroide c del subespacio m>.
+    void compute_tables(const double* query, uint8_t* lut) const;
+
+    // out[i] = suma de las tablas según los códigos del item ids[i]; mayor es mejor.
+    void scan(const uint8_t* lut, const uint8_t* codes, const int* ids, size_t n, uint16_t* out) const;
+
+private:
+    size_t dimension_ = 0;
+    size_t sub_dim_ = 0;
+    int num_subspaces_ = 0;
+    vector<double> centroids_; // num_subspaces x 16 x sub_dim
+
+    const double* centroid(int subspace, int c) const {
+        return centroids_.data() + (static_cast<size_t>(subspace) * kCentroids + c) * sub_dim_;
+    }
+    int nearest_centroid(int subspace, const double* sub_vector) const;
+};
+
+// Copia el item normalizado (ceros si es nulo).
+inline void pq_normalized_row(const double* row, size_t dimension, double* out) {
+    double norm = sqrt(dot(row, row, dimension));
+    double inverse = norm < 1e-12 ? 0.0 : 1.0 / norm;
+    for (size_t i = 0; i < dimension; ++i) out[i] = row[i] * inverse;
+}
+
+inline int ProductQuantizer::nearest_centroid(int subspace, const double* sub_vector) const {
+    int best = 0;
+    double best_distance = numeric_limits<double>::max();
+    for (int c = 0; c < kCentroids; ++c) {
+        const double* center = centroid(subspace, c);
+        double distance = 0.0;
+        for (size_t k = 0; k < sub_dim_; ++k) distance += (sub_vector[k] - center[k]) * (sub_vector[k] - center[k]);
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = c;
+        }
+    }
+    return best;
+}
+
+inline void ProductQuantizer::train(const double* items, size_t num_items, uint64_t seed, int iterations,
+                                    size_t max_train) {
+    if (num_items == 0) throw invalid_argument("ProductQuantizer: no hay items para entrenar.");
+    mt19937_64 gen(seed ^ 0x9E3779B97F4A7C15ULL);
+    vector<size_t> sample(num_items);
+    iota(sample.begin(), sample.end(), 0);
+    if (num_items > max_train) {
+        shuffle(sample.begin(), sample.end(), gen);
+        sample.resize(max_train);
+    }
+    const size_t n = sample.size();
+    vector<double> train_set(n * dimension_);
+    for (size_t i = 0; i < n; ++i) {
+        pq_normalized_row(items + sample[i] * dimension_, dimension_, train_set.data() + i * dimension_);
+    }
+
+    centroids_.assign(static_cast<size_t>(num_subspaces_) * kCentroids * sub_dim_, 0.0);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int m = 0; m < num_subspaces_; ++m) {
+        const size_t offset = m * sub_dim_;
+        double* centers = centroids_.data() + static_cast<size_t>(m) * kCentroids * sub_dim_;
+        // Inicialización: kCentroids puntos distintos de la muestra (fijos por subespacio).
+        mt19937_64 init_gen(seed + m);
+        for (int c = 0; c < kCentroids; ++c) {
+            size_t pick = init_gen() % n;
+            copy(train_set.data() + pick * dimension_ + offset, train_set.data() + pick * dimension_ + offset + sub_dim_,
+                 centers + c * sub_dim_);
+        }
+        vector<int> assignment(n, 0);
+        vector<double> sums(kCentroids * sub_dim_);
+        vector<size_t> counts(kCentroids);
+        for (int iter = 0; iter < iterations; ++iter) {
+            fill(sums.begin(), sums.end(), 0.0);
+            fill(counts.begin(), counts.end(), 0);
+            for (size_t i = 0; i < n; ++i) {
+                const double* sub_vector = train_set.data() + i * dimension_ + offset;
+                assignment[i] = nearest_centroid(m, sub_vector);
+                counts[assignment[i]]++;
+                for (size_t k = 0; k < sub_dim_; ++k) sums[assignment[i] * sub_dim_ + k] += sub_vector[k];
+            }
+            for (int c = 0; c < kCentroids; ++c) {
+                if (counts[c] == 0) {
+                    // Centroide vacío: se reinicia en un punto de la muestra.
+                    size_t pick = init_gen() % n;
+                    copy(train_set.data() + pick * dimension_ + offset,
+                         train_set.data() + pick * dimension_ + offset + sub_dim_, centers + c * sub_dim_);
+                    continue;
+                }
+                for (size_t k = 0; k < sub_dim_; ++k) centers[c * sub_dim_ + k] = sums[c * sub_dim_ + k] / counts[c];
+            }
+        }
+    }
+}
+
+inline void ProductQuantizer::encode(const double* items, size_t num_items, vector<uint8_t>& codes) const {
+    codes.assign(num_items * code_bytes(), 0);
+    #pragma omp parallel
+    {
+        vector<double> row(dimension_);
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < static_cast<long long>(num_items); ++i) {
+            pq_normalized_row(items + i * dimension_, dimension_, row.data());
+            uint8_t* item_codes = codes.data() + i * code_bytes();
+            for (int m = 0; m < num_subspaces_; ++m) {
+                int c = nearest_centroid(m, row.data() + m * sub_dim_);
+                item_codes[m / 2] |= static_cast<uint8_t>(m % 2 == 0 ? c : c << 4);
+            }
+        }
+    }
+}
+
+inline void ProductQuantizer::compute_tables(const double* query, uint8_t* lut) const {
+    vector<double> values(static_cast<size_t>(num_subspaces_) * kCentroids);
+    double max_range = 0.0;
+    for (int m = 0; m < num_subspaces_; ++m) {
+        double* row = values.data() + m * kCentroids;
+        for (int c = 0; c < kCentroids; ++c) row[c] = dot(query + m * sub_dim_, centroid(m, c), sub_dim_);
+        double low = *min_element(row, row + kCentroids);
+        for (int c = 0; c < kCentroids; ++c) row[c] -= low;
+        max_range = max(max_range, *max_element(row, row + kCentroids));
+    }
+    const double scale = max_range > 0.0 ? 255.0 / max_range : 0.0;
+    for (size_t i = 0; i < values.size(); ++i) lut[i] = static_cast<uint8_t>(lround(values[i] * scale));
+}
+
+inline void pq_scan_portable(const uint8_t* lut, const uint8_t* codes, size_t code_bytes, const int* ids, size_t n,
+                             uint16_t* out) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint8_t* item_codes = codes + static_cast<size_t>(ids[i]) * code_bytes;
+        uint32_t sum = 0;
+        for (size_t j = 0; j < code_bytes; ++j) {
+            sum += lut[(2 * j) * 16 + (item_codes[j] & 0x0F)] + lut[(2 * j + 1) * 16 + (item_codes[j] >> 4)];
+        }
+        out[i] = static_cast<uint16_t>(sum);
+    }
+}
+
+#ifdef SRPR_X86_DISPATCH
+// Fast-scan: los códigos de 32 candidatos se trasponen a un bloque (byte j de
+// los 32 items contiguo) y cada byte se resuelve con dos pshufb, uno por nibble.
+__attribute__((target("avx2"))) inline void pq_scan_avx2(const uint8_t* lut, const uint8_t* codes, size_t code_bytes,
+                                                       const int* ids, size_t n, uint16_t* out) {
+    constexpr size_t kBlock = ProductQuantizer::kBlock;
+    alignas(32) uint8_t block[ProductQuantizer::kMaxSubspaces / 2 * kBlock];
+    alignas(32) uint16_t sums[kBlock];
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    for (size_t start = 0; start < n; start += kBlock) {
+        const size_t count = min(kBlock, n - start);
+        for (size_t i = 0; i < kBlock; ++i) {
+            const uint8_t* item_codes = i < count ? codes + static_cast<size_t>(ids[start + i]) * code_bytes : nullptr;
+            for (size_t j = 0; j < code_bytes; ++j) block[j * kBlock + i] = item_codes ? item_codes[j] : 0;
+        }
+        __m256i acc_low = _mm256_setzero_si256(), acc_high = _mm256_setzero_si256();
+        for (size_t j = 0; j < code_bytes; ++j) {
+            __m256i packed = _mm256_load_si256(reinterpret_cast<const __m256i*>(block + j * kBlock));
+            __m256i low = _mm256_and_si256(packed, low_mask);
+            __m256i high = _mm256_and_si256(_mm256_srli_epi16(packed, 4), low_mask);
+            __m256i lut_low = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lut + (2 * j) * 16)));
+            __m256i lut_high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lut + (2 * j + 1) * 16)));
+            __m256i a = _mm256_shuffle_epi8(lut_low, low);
+            __m256i b = _mm256_shuffle_epi8(lut_high, high);
+            // Se ensancha a uint16 antes de sumar: items 0-15 en acc_low, 16-31 en acc_high.
+            acc_low = _mm256_add_epi16(acc_low, _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(a)),
+                                                                 _mm256_cvtepu8_epi16(_mm256_castsi256_si128(b))));
+            acc_high = _mm256_add_epi16(acc_high, _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(a, 1)),
+                                                                   _mm256_cvtepu8_epi16(_mm256_extracti128_si256(b, 1))));
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i*>(sums), acc_low);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(sums + 16), acc_high);
+        copy(sums, sums + count, out + start);
+    }
+}
+#endif
+
+inline void ProductQuantizer::scan(const uint8_t* lut, const uint8_t* codes, const int* ids, size_t n,
+                                   uint16_t* out) const {
+#ifdef SRPR_X86_DISPATCH
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) return pq_scan_avx2(lut, codes, code_bytes(), ids, n, out);
+#endif
+    pq_scan_portable(lut, codes, code_bytes(), ids, n, out);
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "simd.h"  // SRPR_X86_DISPATCH e <immintrin.h>
+#include "vec.h"
+
+using namespace std;
+
+// Cuantización escalar a int8 de vectores normalizados: cada fila guarda
+// round(x_i / |x| / scale) en [-127, 127] con scale = max|x_i| / |x| / 127, y
+// cada fila se rellena con ceros hasta un múltiplo de 32 para el kernel AVX2.
+// El coseno aproximado es dot_int8(q, x) * scale_q * scale_x; el error por
+// componente es <= scale / 2, así que sirve para descartar candidatos pero el
+// orden final se decide con el coseno exacto.
+inline size_t int8_padded_dim(size_t dimension) { return (dimension + 31) & ~size_t{31}; }
+
+// Escribe padded_dim componentes en out y devuelve la escala (0 si el vector es nulo).
+inline double quantize_int8(const double* vector, size_t dimension, int8_t* out) {
+    const size_t padded_dim = int8_padded_dim(dimension);
+    fill(out, out + padded_dim, int8_t{0});
+    double norm = sqrt(dot(vector, vector, dimension));
+    double max_abs = 0.0;
+    for (size_t i = 0; i < dimension; ++i) max_abs = max(max_abs, fabs(vector[i]));
+    if (norm < 1e-12 || max_abs == 0.0) return 0.0;
+    const double scale = max_abs / norm / 127.0;
+    const double inverse = 1.0 / (norm * scale);
+    for (size_t i = 0; i < dimension; ++i) {
+        out[i] = static_cast<int8_t>(clamp(lround(vector[i] * inverse), -127L, 127L));
+    }
+    return scale;
+}
+
+inline int32_t int8_dot_portable(const int8_t* a, const int8_t* b, size_t padded_dim) {
+    int32_t sum = 0;
+    for (size_t i = 0; i < padded_dim; ++i) sum += static_cast<int32_t>(a[i]) * b[i];
+    return sum;
+}
+
+#ifdef SRPR_X86_DISPATCH
+// Producto int8 x int8 con maddubs (que pide un operando sin signo): |a| por
+// b con el signo de a da los mismos productos. Con valores en [-127, 127] la
+// suma de cada par cabe en int16 sin saturar.
+__attribute__((target("avx2"))) inline int32_t int8_dot_avx2(const int8_t* a, const int8_t* b, size_t padded_dim) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    for (size_t i = 0; i < padded_dim; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i pairs = _mm256_maddubs_epi16(_mm256_sign_epi8(va, va), _mm256_sign_epi8(vb, va));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, ones));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+// Igual que la versión AVX2, pero VPDPBUSD hace maddubs + madd en una instrucción.
+__attribute__((target("avx2,avx512vl,avx512vnni"))) inline int32_t int8_dot_vnni(const int8_t* a, const int8_t* b,
+                                                                              size_t padded_dim) {
+    __m256i acc = _mm256_setzero_si256();
+    for (size_t i = 0; i < padded_dim; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        acc = _mm256_dpbusd_epi32(acc, _mm256_sign_epi8(va, va), _mm256_sign_epi8(vb, va));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+using Int8DotKernel = int32_t (*)(const int8_t*, const int8_t*, size_t);
+
+// El mejor kernel disponible en esta CPU (se elige una vez).
+inline Int8DotKernel int8_dot_kernel() {
+#ifdef SRPR_X86_DISPATCH
+    static const Int8DotKernel kernel =
+        __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl") ? int8_dot_vnni
+        : __builtin_cpu_supports("avx2")                                          ? int8_dot_avx2
+                                                                                  : int8_dot_portable;
+    return kernel;
+#else
+    return int8_dot_portable;
+#endif
+}
+
+// Items cuantizados, fila i en codes + i * padded_dim.
+class Int8ItemStore {
+public:
+    void build(const double* items, size_t num_items, size_t dimension) {
+        dimension_ = dimension;
+        padded_dim_ = int8_padded_dim(dimension);
+        codes_.assign(num_items * padded_dim_, 0);
+        scales_.assign(num_items, 0.0f);
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < static_cast<long long>(num_items); ++i) {
+            scales_[i] = static_cast<float>(quantize_int8(items + i * dimension, dimension, codes_.data() + i * padded_dim_));
+        }
+    }
+
+    void clear() {
+        codes_.clear();
+        scales_.clear();
+    }
+
+    bool empty() const { return scales_.empty(); }
+    size_t dimension() const { return dimension_; }
+    size_t padded_dim() const { return padded_dim_; }
+    size_t memory_bytes() const { return codes_.size() + scales_.size() * sizeof(float); }
+
+    // out[i] = coseno aproximado (salvo el factor de escala de la consulta, que
+    // no cambia el orden) entre la consulta cuantizada y el item ids[i].
+    void scores(const int8_t* query, const int* ids, size_t n, float* out) const {
+        const Int8DotKernel kernel = int8_dot_kernel();
+        for (size_t i = 0; i < n; ++i) {
+            const int8_t* row = codes_.data() + static_cast<size_t>(ids[i]) * padded_dim_;
+            out[i] = static_cast<float>(kernel(query, row, padded_dim_)) * scales_[ids[i]];
+        }
+    }
+
+private:
+    size_t dimension_ = 0;
+    size_t padded_dim_ = 0;
+    vector<int8_t> codes_;
+    vector<float> scales_;
+};
@@ -0,0 +1,253 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#ifndef SRPR_X86_DISPATCH
+#define SRPR_X86_DISPATCH 1
+#endif
+#endif
+
+using namespace std;
+
+// Kernels de doubles (dot, axpy, scale, norma y dot de una consulta contra
+// muchas filas) con versiones SSE2, AVX2 y AVX-512F. El binario se compila sin
+// -march; cada versión lleva su target y simd_kernels() elige la mejor que
+// soporta la CPU la primera vez que se llama (con cpuid, vía
+// __builtin_cpu_supports). Fuera de x86-64 queda la versión portable.
+//
+// Todas las versiones suman el producto punto en SIMD_DOT_LANES carriles, con
+// la cola y la suma final en el mismo orden que fixed_dot, y sin FMA: dan el
+// mismo resultado bit a bit entre sí y con fixed_dot, así que un índice o una
+// verdad de referencia calculada en una máquina coincide con la de otra.
+
+// Carriles del producto punto: un registro AVX-512, dos AVX o cuatro SSE2.
+constexpr size_t SIMD_DOT_LANES = 8;
+
+// Suma de los carriles, siempre en este orden.
+template <typename T>
+constexpr T simd_reduce_lanes(const T* partial) {
+    return ((partial[0] + partial[1]) + (partial[2] + partial[3])) +
+           ((partial[4] + partial[5]) + (partial[6] + partial[7]));
+}
+
+// Elementos body..n-1 (menos de SIMD_DOT_LANES), al carril i - body. El
+// producto va en su propia sentencia para que clang no lo funda en un FMA.
+inline void simd_dot_tail(const double* a, const double* b, size_t body, size_t n, double* partial) {
+    for (size_t i = body; i < n; ++i) {
+        const double product = a[i] * b[i];
+        partial[i - body] += product;
+    }
+}
+
+enum class SimdLevel { Portable, SSE2, AVX2, AVX512 };
+
+inline const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::SSE2: return "sse2";
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+        default: return "portable";
+    }
+}
+
+// --- Portable ---
+
+inline double simd_dot_portable(const double* a, const double* b, size_t n) {
+    double partial[SIMD_DOT_LANES] = {};
+    const size_t body = n - n % SIMD_DOT_LANES;
+    for (size_t i = 0; i < body; i += SIMD_DOT_LANES) {
+        for (size_t lane = 0; lane < SIMD_DOT_LANES; ++lane) partial[lane] += a[i + lane] * b[i + lane];
+    }
+    simd_dot_tail(a, b, body, n, partial);
+    return simd_reduce_lanes(partial);
+}
+
+inline void simd_axpy_portable(double alpha, const double* x, double* y, size_t n) {
+    for (size_t i = 0; i < n; ++i) y[i] += alpha * x[i];
+}
+
+inline void simd_scale_portable(double alpha, double* x, size_t n) {
+    for (size_t i = 0; i < n; ++i) x[i] *= alpha;
+}
+
+inline void simd_batch_dot_portable(const double* query, const double* rows, size_t num_rows, size_t dimension,
+                                    double* out) {
+    for (size_t r = 0; r < num_rows; ++r) out[r] = simd_dot_portable(query, rows + r * dimension, dimension);
+}
+
+#ifdef SRPR_X86_DISPATCH
+// AVX-512F incluye FMA, y con -std=gnu++20 (el de CMake) GCC fundiría cada
+// multiplicación y suma en un FMA: otro redondeo que el de las demás versiones.
+#if defined(__clang__)
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#endif
+
+// --- SSE2 (siempre presente en x86-64) ---
+
+inline double simd_dot_sse2(const double* a, const double* b, size_t n) {
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd(), acc2 = _mm_setzero_pd(), acc3 = _mm_setzero_pd();
+    const size_t body = n - n % SIMD_DOT_LANES;
+    for (size_t i = 0; i < body; i += SIMD_DOT_LANES) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+        acc2 = _mm_add_pd(acc2, _mm_mul_pd(_mm_loadu_pd(a + i + 4), _mm_loadu_pd(b + i + 4)));
+        acc3 = _mm_add_pd(acc3, _mm_mul_pd(_mm_loadu_pd(a + i + 6), _mm_loadu_pd(b + i + 6)));
+    }
+    double partial[SIMD_DOT_LANES];
+    _mm_storeu_pd(partial, acc0);
+    _mm_storeu_pd(partial + 2, acc1);
+    _mm_storeu_pd(partial + 4, acc2);
+    _mm_storeu_pd(partial + 6, acc3);
+    simd_dot_tail(a, b, body, n, partial);
+    return simd_reduce_lanes(partial);
+}
+
+inline void simd_axpy_sse2(double alpha, const double* x, double* y, size_t n) {
+    const __m128d va = _mm_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+    for (; i < n; ++i) y[i] += alpha * x[i];
+}
+
+inline void simd_scale_sse2(double alpha, double* x, size_t n) {
+    const __m128d va = _mm_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(x + i, _mm_mul_pd(_mm_loadu_pd(x + i), va));
+    for (; i < n; ++i) x[i] *= alpha;
+}
+
+inline void simd_batch_dot_sse2(const double* query, const double* rows, size_t num_rows, size_t dimension,
+                                double* out) {
+    for (size_t r = 0; r < num_rows; ++r) out[r] = simd_dot_sse2(query, rows + r * dimension, dimension);
+}
+
+// --- AVX2 (sin FMA: ver arriba) ---
+
+__attribute__((target("avx2"))) inline double simd_dot_avx2(const double* a, const double* b, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    const size_t body = n - n % SIMD_DOT_LANES;
+    for (size_t i = 0; i < body; i += SIMD_DOT_LANES) {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double partial[SIMD_DOT_LANES];
+    _mm256_storeu_pd(partial, acc0);
+    _mm256_storeu_pd(partial + 4, acc1);
+    simd_dot_tail(a, b, body, n, partial);
+    return simd_reduce_lanes(partial);
+}
+
+__attribute__((target("avx2"))) inline void simd_axpy_avx2(double alpha, const double* x, double* y, size_t n) {
+    const __m256d va = _mm256_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(va, _mm256_loadu_pd(x + i))));
+    }
+    for (; i < n; ++i) y[i] += alpha * x[i];
+}
+
+__attribute__((target("avx2"))) inline void simd_scale_avx2(double alpha, double* x, size_t n) {
+    const __m256d va = _mm256_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(x + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), va));
+    for (; i < n; ++i) x[i] *= alpha;
+}
+
+__attribute__((target("avx2"))) inline void simd_batch_dot_avx2(const double* query, const double* rows,
+                                                                size_t num_rows, size_t dimension, double* out) {
+    for (size_t r = 0; r < num_rows; ++r) out[r] = simd_dot_avx2(query, rows + r * dimension, dimension);
+}
+
+// --- AVX-512F ---
+
+SIMD_TARGET_AVX512 inline double simd_dot_avx512(const double* a, const double* b, size_t n) {
+    __m512d acc = _mm512_setzero_pd();
+    const size_t body = n - n % SIMD_DOT_LANES;
+    for (size_t i = 0; i < body; i += SIMD_DOT_LANES) {
+        acc = _mm512_add_pd(acc, _mm512_mul_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+    }
+    double partial[SIMD_DOT_LANES];
+    _mm512_storeu_pd(partial, acc);
+    simd_dot_tail(a, b, body, n, partial);
+    return simd_reduce_lanes(partial);
+}
+
+SIMD_TARGET_AVX512 inline void simd_axpy_avx512(double alpha, const double* x, double* y, size_t n) {
+    const __m512d va = _mm512_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(y + i, _mm512_add_pd(_mm512_loadu_pd(y + i), _mm512_mul_pd(va, _mm512_loadu_pd(x + i))));
+    }
+    for (; i < n; ++i) y[i] += alpha * x[i];
+}
+
+SIMD_TARGET_AVX512 inline void simd_scale_avx512(double alpha, double* x, size_t n) {
+    const __m512d va = _mm512_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm512_storeu_pd(x + i, _mm512_mul_pd(_mm512_loadu_pd(x + i), va));
+    for (; i < n; ++i) x[i] *= alpha;
+}
+
+SIMD_TARGET_AVX512 inline void simd_batch_dot_avx512(const double* query, const double* rows,
+                                                                     size_t num_rows, size_t dimension, double* out) {
+    for (size_t r = 0; r < num_rows; ++r) out[r] = simd_dot_avx512(query, rows + r * dimension, dimension);
+}
+#endif
+
+// Tabla de kernels de un nivel.
+struct SimdKernels {
+    SimdLevel level;
+    double (*dot)(const double* a, const double* b, size_t n);
+    // y += alpha * x
+    void (*axpy)(double alpha, const double* x, double* y, size_t n);
+    // x *= alpha
+    void (*scale)(double alpha, double* x, size_t n);
+    // out[r] = dot(query, rows + r * dimension) para r < num_rows (filas contiguas, como EmbeddingMatrix).
+    void (*batch_dot)(const double* query, const double* rows, size_t num_rows, size_t dimension, double* out);
+};
+
+// El mejor nivel que soporta esta CPU.
+inline SimdLevel simd_detect_level() {
+#ifdef SRPR_X86_DISPATCH
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::Portable;
+#endif
+}
+
+// Los kernels de un nivel dado (para compararlos en Microbench); un nivel que
+// el binario no tiene cae en el portable. No verifica que la CPU lo soporte.
+inline SimdKernels simd_kernels_for(SimdLevel level) {
+    switch (level) {
+#ifdef SRPR_X86_DISPATCH
+        case SimdLevel::AVX512:
+            return {level, simd_dot_avx512, simd_axpy_avx512, simd_scale_avx512, simd_batch_dot_avx512};
+        case SimdLevel::AVX2:
+            return {level, simd_dot_avx2, simd_axpy_avx2, simd_scale_avx2, simd_batch_dot_avx2};
+        case SimdLevel::SSE2:
+            return {level, simd_dot_sse2, simd_axpy_sse2, simd_scale_sse2, simd_batch_dot_sse2};
+#endif
+        default:
+            return {SimdLevel::Portable, simd_dot_portable, simd_axpy_portable, simd_scale_portable,
+                    simd_batch_dot_portable};
+    }
+}
+
+// Los kernels de esta CPU (se eligen una vez).
+inline const SimdKernels& simd_kernels() {
+    static const SimdKernels kernels = simd_kernels_for(simd_detect_level());
+    return kernels;
+}
+
+inline double simd_dot(const double* a, const double* b, size_t n) { return simd_kernels().dot(a, b, n); }
+inline void simd_axpy(double alpha, const double* x, double* y, size_t n) { simd_kernels().axpy(alpha, x, y, n); }
+inline void simd_scale(double alpha, double* x, size_t n) { simd_kernels().scale(alpha, x, n); }
+inline double simd_norm(const double* x, size_t n) { return sqrt(simd_dot(x, x, n)); }
+inline void simd_batch_dot(const double* query, const double* rows, size_t num_rows, size_t dimension, double* out) {
+    simd_kernels().batch_dot(query, rows, num_rows, dimension, out);
+}
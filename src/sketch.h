@@ -0,0 +1,141 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "simd.h"  // SRPR_X86_DISPATCH e <immintrin.h>
+#include "vec.h"
+
+using namespace std;
+
+// Sketch SRP compacto: bits de signo contra sketch_bits hiperplanos propios
+// (independientes de las tablas), empaquetados en palabras de 64 bits. La
+// distancia de Hamming entre dos sketches estima el ángulo entre los vectores
+// (P[bit distinto] = ángulo / pi), que es lo que optimiza SRPR.
+class SRPSketcher {
+public:
+    static constexpr int kMaxBits = 256;
+
+    SRPSketcher() = default;
+    SRPSketcher(int sketch_bits, int input_dim, uint64_t seed) : bits_(sketch_bits), input_dim_(input_dim) {
+        if (sketch_bits <= 0 || sketch_bits > kMaxBits || sketch_bits % 64 != 0) {
+            throw invalid_argument("SRPSketcher: sketch_bits debe ser 64, 128, 192 o 256.");
+        }
+        mt19937_64 gen(seed ^ 0x5DEECE66DULL);
+        normal_distribution<double> dist(0.0, 1.0);
+        planes_.resize(static_cast<size_t>(bits_) * input_dim_);
+        for (auto& value : planes_) value = dist(gen);
+    }
+
+    int bits() const { return bits_; }
+    int words() const { return bits_ / 64; }
+
+    void sketch(const double* vector, uint64_t* out) const {
+        const double* plane = planes_.data();
+        for (int w = 0; w < words(); ++w) {
+            uint64_t word = 0;
+            for (int k = 0; k < 64; ++k, plane += input_dim_) {
+                if (dot(plane, vector, input_dim_) >= 0.0) word |= uint64_t{1} << k;
+            }
+            out[w] = word;
+        }
+    }
+
+    // Sketches de n items contiguos (fila i en items + i * input_dim): out[i * words + w].
+    void sketch_all(const double* items, size_t n, vector<uint64_t>& out) const {
+        out.assign(n * words(), 0);
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < static_cast<long long>(n); ++i) {
+            sketch(items + i * input_dim_, out.data() + i * words());
+        }
+    }
+
+private:
+    int bits_ = 0;
+    int input_dim_ = 0;
+    vector<double> planes_; // bits x input_dim, fila-mayor
+};
+
+inline void hamming_distances_portable(const uint64_t* sketches, int words, const uint64_t* query, const int* ids,
+                                       size_t n, uint32_t* out) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t* sketch = sketches + static_cast<size_t>(ids[i]) * words;
+        uint32_t distance = 0;
+        for (int w = 0; w < words; ++w) distance += popcount(sketch[w] ^ query[w]);
+        out[i] = distance;
+    }
+}
+
+#ifdef SRPR_X86_DISPATCH
+// Mismo código que la versión portable; con target("popcnt") popcount se
+// compila a la instrucción POPCNT en vez de la secuencia de bits genérica.
+__attribute__((target("popcnt"))) inline void hamming_distances_popcnt(const uint64_t* sketches, int words,
+                                                                     const uint64_t* query, const int* ids,
+                                                                     size_t n, uint32_t* out) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t* sketch = sketches + static_cast<size_t>(ids[i]) * words;
+        uint32_t distance = 0;
+        for (int w = 0; w < words; ++w) distance += popcount(sketch[w] ^ query[w]);
+        out[i] = distance;
+    }
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq"))) inline void hamming_distances_avx512(
+    const uint64_t* sketches, int words, const uint64_t* query, const int* ids, size_t n, uint32_t* out) {
+    size_t i = 0;
+    // Los registros se arman con las variantes enmascaradas (mask/maskz) de
+    // broadcast y shuffle: las no enmascaradas parten de _mm512_undefined, que
+    // GCC 12 reporta con -Wmaybe-uninitialized en cada objetivo que incluye esto.
+    if (words == 4) {
+        // Dos sketches de 256 bits por registro; cada mitad se reduce por separado.
+        const __m512i q = _mm512_maskz_broadcast_i64x4(0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query)));
+        for (; i + 2 <= n; i += 2) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sketches + static_cast<size_t>(ids[i]) * 4));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sketches + static_cast<size_t>(ids[i + 1]) * 4));
+            __m512i x = _mm512_mask_broadcast_i64x4(_mm512_maskz_broadcast_i64x4(0x0F, a), 0xF0, b);
+            __m512i counts = _mm512_popcnt_epi64(_mm512_xor_si512(x, q));
+            alignas(64) uint64_t lanes[8];
+            _mm512_store_si512(lanes, counts);
+            out[i] = static_cast<uint32_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+            out[i + 1] = static_cast<uint32_t>(lanes[4] + lanes[5] + lanes[6] + lanes[7]);
+        }
+    } else if (words == 2) {
+        // Cuatro sketches de 128 bits por registro.
+        const __m512i q = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128(reinterpret_cast<const __m128i*>(query)));
+        auto load = [&](size_t k) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(sketches + static_cast<size_t>(ids[k]) * 2));
+        };
+        for (; i + 4 <= n; i += 4) {
+            __m512i x = _mm512_maskz_broadcast_i32x4(0x000F, load(i));
+            x = _mm512_mask_broadcast_i32x4(x, 0x00F0, load(i + 1));
+            x = _mm512_mask_broadcast_i32x4(x, 0x0F00, load(i + 2));
+            x = _mm512_mask_broadcast_i32x4(x, 0xF000, load(i + 3));
+            __m512i counts = _mm512_popcnt_epi64(_mm512_xor_si512(x, q));
+            // Suma de pares de carriles: (c0+c1, c2+c3, ...) en los carriles pares.
+            __m512i pairs = _mm512_add_epi64(counts, _mm512_maskz_shuffle_epi32(0xFFFF, counts, _MM_PERM_BADC));
+            alignas(64) uint64_t lanes[8];
+            _mm512_store_si512(lanes, pairs);
+            out[i] = static_cast<uint32_t>(lanes[0]);
+            out[i + 1] = static_cast<uint32_t>(lanes[2]);
+            out[i + 2] = static_cast<uint32_t>(lanes[4]);
+            out[i + 3] = static_cast<uint32_t>(lanes[6]);
+        }
+    }
+    hamming_distances_popcnt(sketches, words, query, ids + i, n - i, out + i);
+}
+#endif
+
+// out[i] = Hamming(query, sketches[ids[i]]). Elige en tiempo de ejecución entre
+// AVX-512 VPOPCNTDQ (2 o 4 sketches por registro para 256 y 128 bits), POPCNT
+// escalar y la versión portable.
+inline void hamming_distances(const uint64_t* sketches, int words, const uint64_t* query, const int* ids, size_t n,
+                              uint32_t* out) {
+#ifdef SRPR_X86_DISPATCH
+    static const int level = __builtin_cpu_supports("avx512vpopcntdq") ? 2 : (__builtin_cpu_supports("popcnt") ? 1 : 0);
+    if (level == 2 && (words == 2 || words == 4)) return hamming_distances_avx512(sketches, words, query, ids, n, out);
+    if (level >= 1) return hamming_distances_popcnt(sketches, words, query, ids, n, out);
+#endif
+    hamming_distances_portable(sketches, words, query, ids, n, out);
+}
@@ -7,9 +7,25 @@
 #include <cmath>
 #include <algorithm>
 #include <ostream>
+#include <concepts>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include "fixedvec.h"
 
 using namespace std;
 
+template <typename T>
+class BasicVecView;
+using VecView = BasicVecView<double>;
+using ConstVecView = BasicVecView<const double>;
+
+// Nodos de expresión de los operadores de Vec (ver más abajo).
+template <typename T>
+struct is_vec_expression : false_type {};
+template <typename T>
+concept VecExpression = is_vec_expression<remove_cvref_t<T>>::value;
+
 class Vec {
 private:
     double* elements;
@@ -19,21 +35,34 @@ public:
     explicit Vec(size_t size, double initialValue = 0.0);
     Vec(initializer_list<double> initializers);
     Vec(const vector<double>& initialValues);
+    // Copia los valores de una vista (p. ej. una fila de EmbeddingMatrix).
+    explicit Vec(ConstVecView view);
     Vec(const Vec& other);
     Vec(Vec&& other) noexcept;
+    // Evalúa una expresión (a + b, x * s, ...) en un solo bucle.
+    template <VecExpression E>
+    Vec(const E& expression);
     ~Vec();
 
     Vec& operator=(const Vec& other);
     Vec& operator=(Vec&& other) noexcept;
+    template <VecExpression E>
+    Vec& operator=(const E& expression);
 
     double& operator[](size_t index);
     const double& operator[](size_t index) const;
     size_t getDimension() const;
+    double* data() { return elements; }
+    const double* data() const { return elements; }
 
     Vec& operator+=(const Vec& rhs);
     Vec& operator-=(const Vec& rhs);
     Vec& operator*=(double scalar);
     Vec& operator/=(double scalar);
+    template <VecExpression E>
+    Vec& operator+=(const E& expression);
+    template <VecExpression E>
+    Vec& operator-=(const E& expression);
 
     double magnitude() const;
     double magnitudeSquared() const;
@@ -41,6 +70,33 @@ public:
     Vec normalized() const;
 };
 
+// Vista no propietaria sobre dimension valores contiguos: una fila de
+// EmbeddingMatrix (matrix.h) o los de un Vec. No reserva memoria, así que los
+// modelos la devuelven por valor; ConstVecView es la de solo lectura y es lo
+// que reciben las funciones que solo leen un vector (un Vec se convierte solo).
+template <typename T>
+class BasicVecView {
+public:
+    BasicVecView(T* elements, size_t dimension) : elements(elements), dimension(dimension) {}
+    BasicVecView(conditional_t<is_const_v<T>, const Vec&, Vec&> vector)
+        : elements(vector.data()), dimension(vector.getDimension()) {}
+    // VecView -> ConstVecView.
+    template <typename U>
+        requires(is_const_v<T> && !is_const_v<U>)
+    BasicVecView(BasicVecView<U> other) : elements(other.data()), dimension(other.getDimension()) {}
+
+    T& operator[](size_t index) const { return elements[index]; }
+    size_t getDimension() const { return dimension; }
+    T* data() const { return elements; }
+
+    double magnitudeSquared() const;
+    double magnitude() const { return sqrt(magnitudeSquared()); }
+
+private:
+    T* elements;
+    size_t dimension;
+};
+
 Vec::Vec() : elements(nullptr), dimension(0) {}
 
 Vec::Vec(size_t size, double initialValue) : elements(new double[size]), dimension(size) {
@@ -55,6 +111,10 @@ Vec::Vec(const vector<double>& initialValues) : elements(new double[initialValue
     copy(initialValues.begin(), initialValues.end(), elements);
 }
 
+Vec::Vec(ConstVecView view) : elements(new double[view.getDimension()]), dimension(view.getDimension()) {
+    copy(view.data(), view.data() + dimension, elements);
+}
+
 Vec::Vec(const Vec& other) : elements(new double[other.dimension]), dimension(other.dimension) {
     copy(other.elements, other.elements + dimension, elements);
 }
@@ -99,26 +159,21 @@ size_t Vec::getDimension() const {
     return dimension;
 }
 
+// +=, -= y *= van a los kernels de simd.h (y + 1 * x y y + -1 * x son exactos).
 Vec& Vec::operator+=(const Vec& rhs) {
     if (dimension != rhs.dimension) throw invalid_argument("Vector dimensions must match for addition.");
-    for (size_t i = 0; i < dimension; ++i) {
-        elements[i] += rhs.elements[i];
-    }
+    simd_axpy(1.0, rhs.elements, elements, dimension);
     return *this;
 }
 
 Vec& Vec::operator-=(const Vec& rhs) {
     if (dimension != rhs.dimension) throw invalid_argument("Vector dimensions must match for subtraction.");
-    for (size_t i = 0; i < dimension; ++i) {
-        elements[i] -= rhs.elements[i];
-    }
+    simd_axpy(-1.0, rhs.elements, elements, dimension);
     return *this;
 }
 
 Vec& Vec::operator*=(double scalar) {
-    for (size_t i = 0; i < dimension; ++i) {
-        elements[i] *= scalar;
-    }
+    simd_scale(scalar, elements, dimension);
     return *this;
 }
 
@@ -130,11 +185,7 @@ Vec& Vec::operator/=(double scalar) {
 }
 
 double Vec::magnitudeSquared() const {
-    double squaredMag = 0.0;
-    for (size_t i = 0; i < dimension; ++i) {
-        squaredMag += elements[i] * elements[i];
-    }
-    return squaredMag;
+    return simd_dot(elements, elements, dimension);
 }
 
 double Vec::magnitude() const {
@@ -158,41 +209,168 @@ Vec Vec::normalized() const {
     return *this;
 }
 
-Vec operator+(const Vec& lhs, const Vec& rhs) {
-    Vec result = lhs;
-    result += rhs;
-    return result;
+// Expresiones perezosas: +, -, * y / no calculan nada, devuelven un nodo con
+// sus operandos, y la cuenta se hace elemento a elemento en un solo bucle al
+// asignar la expresión a un Vec (construcción, =, += o -=). Así
+//     xu += (grad_xu - (xu * lambda)) * learning_rate;
+// no reserva temporales y queda en un solo bucle, con las mismas operaciones
+// por elemento y en el mismo orden que antes (mismo resultado bit a bit).
+// Como todo es elemento a elemento, el destino puede aparecer en la expresión
+// y los bucles pueden llevar omp simd: sin él, GCC a -O2 no vectoriza un bucle
+// que necesita comprobar solapamiento entre destino y operandos.
+//
+// Los Vec con nombre se guardan por referencia y los temporales por valor.
+// Cuidado con auto: `auto g = x * 2.0;` es una expresión, no un Vec; se
+// evalúa recién al asignarla, con los valores que x tenga entonces, y no debe
+// sobrevivir a los Vec que nombra. Para guardar un resultado, Vec explícito.
+
+// Hoja: un Vec con nombre.
+class VecReference {
+public:
+    explicit VecReference(const Vec& vector) : elements(vector.data()), dimension(vector.getDimension()) {}
+    size_t getDimension() const { return dimension; }
+    double operator[](size_t index) const { return elements[index]; }
+
+private:
+    const double* elements;
+    size_t dimension;
+};
+
+// Hoja: un Vec temporal (p. ej. x.normalized() * 2.0), que la expresión se queda.
+class VecTemporary {
+public:
+    explicit VecTemporary(Vec&& vector) : vector(move(vector)) {}
+    size_t getDimension() const { return vector.getDimension(); }
+    double operator[](size_t index) const { return vector.data()[index]; }
+
+private:
+    Vec vector;
+};
+
+template <typename L, typename R, typename Op>
+class VecBinaryExpression {
+public:
+    VecBinaryExpression(L lhs, R rhs, const char* dimension_error) : lhs(move(lhs)), rhs(move(rhs)) {
+        if (this->lhs.getDimension() != this->rhs.getDimension()) throw invalid_argument(dimension_error);
+    }
+    size_t getDimension() const { return lhs.getDimension(); }
+    double operator[](size_t index) const { return Op{}(lhs[index], rhs[index]); }
+
+private:
+    L lhs;
+    R rhs;
+};
+
+// vector[i] op scalar.
+template <typename E, typename Op>
+class VecScalarExpression {
+public:
+    VecScalarExpression(E vector, double scalar) : vector(move(vector)), scalar(scalar) {}
+    size_t getDimension() const { return vector.getDimension(); }
+    double operator[](size_t index) const { return Op{}(vector[index], scalar); }
+
+private:
+    E vector;
+    double scalar;
+};
+
+template <typename L, typename R, typename Op>
+struct is_vec_expression<VecBinaryExpression<L, R, Op>> : true_type {};
+template <typename E, typename Op>
+struct is_vec_expression<VecScalarExpression<E, Op>> : true_type {};
+
+template <typename T>
+concept VecOperand = same_as<remove_cvref_t<T>, Vec> || VecExpression<T>;
+
+inline VecReference vec_operand(const Vec& vector) { return VecReference(vector); }
+inline VecTemporary vec_operand(Vec&& vector) { return VecTemporary(move(vector)); }
+template <VecExpression E>
+remove_cvref_t<E> vec_operand(E&& expression) { return forward<E>(expression); }
+
+template <typename T>
+using vec_operand_t = decltype(vec_operand(declval<T>()));
+
+template <VecExpression E>
+Vec::Vec(const E& expression) : elements(new double[expression.getDimension()]), dimension(expression.getDimension()) {
+    #pragma omp simd
+    for (size_t i = 0; i < dimension; ++i) {
+        elements[i] = expression[i];
+    }
+}
+
+template <VecExpression E>
+Vec& Vec::operator=(const E& expression) {
+    // Con otra dimensión hace falta memoria nueva; la expresión puede leer de
+    // este Vec, así que se evalúa aparte antes de soltar la vieja.
+    if (dimension != expression.getDimension()) return *this = Vec(expression);
+    #pragma omp simd
+    for (size_t i = 0; i < dimension; ++i) {
+        elements[i] = expression[i];
+    }
+    return *this;
+}
+
+template <VecExpression E>
+Vec& Vec::operator+=(const E& expression) {
+    if (dimension != expression.getDimension()) throw invalid_argument("Vector dimensions must match for addition.");
+    #pragma omp simd
+    for (size_t i = 0; i < dimension; ++i) {
+        elements[i] += expression[i];
+    }
+    return *this;
 }
 
-Vec operator-(const Vec& lhs, const Vec& rhs) {
-    Vec result = lhs;
-    result -= rhs;
-    return result;
+template <VecExpression E>
+Vec& Vec::operator-=(const E& expression) {
+    if (dimension != expression.getDimension()) throw invalid_argument("Vector dimensions must match for subtraction.");
+    #pragma omp simd
+    for (size_t i = 0; i < dimension; ++i) {
+        elements[i] -= expression[i];
+    }
+    return *this;
 }
 
-Vec operator*(const Vec& vector, double scalar) {
-    Vec result = vector;
-    result *= scalar;
-    return result;
+template <VecOperand L, VecOperand R>
+auto operator+(L&& lhs, R&& rhs) {
+    return VecBinaryExpression<vec_operand_t<L>, vec_operand_t<R>, plus<>>(
+        vec_operand(forward<L>(lhs)), vec_operand(forward<R>(rhs)), "Vector dimensions must match for addition.");
 }
 
-Vec operator*(double scalar, const Vec& vector) {
-    return vector * scalar;
+template <VecOperand L, VecOperand R>
+auto operator-(L&& lhs, R&& rhs) {
+    return VecBinaryExpression<vec_operand_t<L>, vec_operand_t<R>, minus<>>(
+        vec_operand(forward<L>(lhs)), vec_operand(forward<R>(rhs)), "Vector dimensions must match for subtraction.");
 }
 
-Vec operator/(const Vec& vector, double scalar) {
-    Vec result = vector;
-    result /= scalar;
-    return result;
+template <VecOperand E>
+auto operator*(E&& vector, double scalar) {
+    return VecScalarExpression<vec_operand_t<E>, multiplies<>>(vec_operand(forward<E>(vector)), scalar);
 }
 
-double dot(const Vec& vectorA, const Vec& vectorB) {
+template <VecOperand E>
+auto operator*(double scalar, E&& vector) {
+    return forward<E>(vector) * scalar;
+}
+
+template <VecOperand E>
+auto operator/(E&& vector, double scalar) {
+    return VecScalarExpression<vec_operand_t<E>, divides<>>(vec_operand(forward<E>(vector)), scalar);
+}
+
+// Producto punto sobre memoria contigua (filas de una matriz de items), con
+// el kernel de simd.h para esta CPU. Mismo resultado que fixed_dot.
+double dot(const double* a, const double* b, size_t dimension) {
+    return simd_dot(a, b, dimension);
+}
+
+template <typename T>
+double BasicVecView<T>::magnitudeSquared() const {
+    return dot(elements, elements, dimension);
+}
+
+double dot(ConstVecView vectorA, ConstVecView vectorB) {
     if (vectorA.getDimension() != vectorB.getDimension()) throw invalid_argument("Vector dimensions must match for dot product.");
-    double result = 0.0;
-    for (size_t i = 0; i < vectorA.getDimension(); ++i) {
-        result += vectorA[i] * vectorB[i];
-    }
-    return result;
+    return dot(vectorA.data(), vectorB.data(), vectorA.getDimension());
 }
 
 Vec cross(const Vec& vectorA, const Vec& vectorB) {